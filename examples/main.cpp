@@ -2,14 +2,10 @@
 
 #include <cassert> // assert
 
-// Some "extensions" examples to see what kind of allocators be made with the library
-#include "DebugAllocator.hpp"
-#include "DoubleBufferedAllocator.hpp"
-
 using namespace dyma;
 
 void DebugAllocator_Example();
-void DoubleBufferedAllocator_Example();
+void FrameAllocator_Example();
 
 int main()
 {
@@ -99,7 +95,7 @@ int main()
 
 	DebugAllocator_Example();
 
-	DoubleBufferedAllocator_Example();
+	FrameAllocator_Example();
 
 
 
@@ -115,7 +111,11 @@ void DebugAllocator_Example()
 	bool debug = true;
 	dyma::StackMemory<1024> stackMemory;
 	dyma::StackAllocator stackAllocator(stackMemory);
-	DebugAllocator debugAllocator(stackAllocator);
+	dyma::DebugAllocator::Settings debugSettings;
+	debugSettings.trackBlocks = true; // To list the blocks currently used
+	debugSettings.peakGranularity = 0; // Exact peak, only worth it with a few threads
+	debugSettings.callSiteDepth = 8; // To group the leaking blocks by call site in WriteLeakReport()
+	dyma::DebugAllocator debugAllocator(stackAllocator, debugSettings);
 
 	// Use the allocator without knowing the magic behind
 	dyma::Allocator* allocator = (debug) ? (dyma::Allocator*)&debugAllocator : (dyma::Allocator*)&stackAllocator;
@@ -127,29 +127,39 @@ void DebugAllocator_Example()
 	// Check the stats and find currently used blocks (and leaking blocks)
 	assert(debugAllocator.GetUsedSize() == 24);
 	assert(debugAllocator.GetPeakSize() == 56);
-	for (const DebugAllocator::DebugMemoryBlock& block : debugAllocator.GetBlocks())
+	for (const dyma::DebugAllocator::Block& block : debugAllocator.GetBlocks())
 	{
 		assert((block.ptr == ptr8 && block.size == 8) || (block.ptr == ptr16 && block.size == 16));
 	}
 }
 
 
-void DoubleBufferedAllocator_Example()
+void FrameAllocator_Example()
 {
-	// Init
-	DoubleBufferedAllocator allocator(512);
+	// Init : 3 frames of 512 bytes in flight
+	dyma::HeapMemory memory(3 * 512);
+	dyma::FrameAllocator<3> allocator(memory);
 
-	for (std::size_t i = 0; i < 123; ++i)
+	for (std::uint64_t i = 0; i < 123; ++i)
 	{
-		// Allocate memory from the current buffer
+		// Start recording a new frame, it fails if the consumer still uses the memory of that frame
+		if (!allocator.BeginFrame())
+		{
+			allocator.ReleaseFrame(i - 3);
+			allocator.BeginFrame();
+		}
+
+		// Allocate memory from the current frame
 		void* ptr8 = allocator.Allocate(8);
 		void* ptr16 = allocator.Allocate(16);
 
 		// ..
-		// Simulation using current and/or previous buffer
+		// Simulation using current and/or previous frames
 		// ..
 
-		// Swap the buffer and clear the new one
-		allocator.SwapBuffers();
+		// Hand the frame to the consumer, which calls ReleaseFrame() once it is done with it
+		const std::uint64_t frame = allocator.EndFrame();
+		assert(allocator.IsFrameInFlight(frame));
 	}
+	assert(allocator.GetHighWater() == 32);
 }
\ No newline at end of file
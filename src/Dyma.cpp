@@ -2,6 +2,50 @@
 
 #include <cstdlib> // malloc/calloc/realloc/free
 #include <cassert> // assert
+#include <algorithm> // std::sort
+#include <atomic> // std::atomic
+#include <chrono> // std::chrono::steady_clock
+#include <memory> // std::shared_ptr
+#include <mutex> // std::mutex
+#include <new> // placement new
+
+#include <cmath> // std::log
+#include <cstdio> // std::FILE
+#include <cstring> // memset
+#include <thread> // std::thread::hardware_concurrency
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h> // VirtualAlloc/VirtualFree/GetCurrentProcessorNumber
+#include <intrin.h> // _BitScanReverse64
+#else
+#include <sys/mman.h> // mmap/munmap/shm_open
+#include <sys/stat.h> // fstat
+#include <fcntl.h> // O_CREAT
+#include <unistd.h> // ftruncate/getpid
+#include <signal.h> // kill
+#include <cerrno> // errno
+#endif
+
+#if defined(__has_include)
+#if __has_include(<execinfo.h>)
+#include <execinfo.h> // backtrace
+#define DYMA_BACKTRACE
+#endif
+#endif
+
+#if defined(__linux__)
+#include <sched.h> // sched_getcpu
+#include <sys/sysinfo.h> // get_nprocs_conf
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define DYMA_RSEQ
+// Registration of the rseq area done by glibc (2.35+), weak to still link with older versions
+extern "C" const std::ptrdiff_t __rseq_offset __attribute__((weak));
+extern "C" const unsigned int __rseq_size __attribute__((weak));
+#endif
+#endif
 
 namespace dyma
 {
@@ -67,6 +111,65 @@ std::size_t RoundToAlignment(std::size_t size, std::size_t alignment)
 	return (size + (alignment - 1)) & -alignment;
 }
 
+std::size_t GetCpuCount()
+{
+#if defined(__linux__)
+	// CPU ids can be sparse or come online later, the possible mask bounds them (e.g. "0-7,16-23")
+	int cpuCount = get_nprocs_conf();
+	std::FILE* file = std::fopen("/sys/devices/system/cpu/possible", "r");
+	if (file != nullptr)
+	{
+		int first = 0;
+		int last = 0;
+		while (std::fscanf(file, "%d", &first) == 1)
+		{
+			last = first;
+			if (std::fscanf(file, "-%d", &last) != 1)
+			{
+				last = first;
+			}
+			cpuCount = (last + 1 > cpuCount) ? last + 1 : cpuCount;
+			if (std::fgetc(file) != ',')
+			{
+				break;
+			}
+		}
+		std::fclose(file);
+	}
+	return (cpuCount > 0) ? static_cast<std::size_t>(cpuCount) : 1;
+#else
+	const unsigned int cpuCount = std::thread::hardware_concurrency();
+	return (cpuCount > 0) ? cpuCount : 1;
+#endif
+}
+
+std::size_t GetCurrentCpu()
+{
+#if defined(DYMA_RSEQ)
+	if (CpuCachingAllocator::IsRseqAvailable())
+	{
+		// cpu_id of the rseq area, updated by the kernel
+		const char* rseqArea = static_cast<const char*>(__builtin_thread_pointer()) + __rseq_offset;
+		return *reinterpret_cast<const volatile std::uint32_t*>(rseqArea + 4);
+	}
+#endif
+#if defined(__linux__)
+	const int cpu = sched_getcpu();
+	return (cpu >= 0) ? static_cast<std::size_t>(cpu) : 0;
+#elif defined(_WIN32)
+	return GetCurrentProcessorNumber();
+#else
+	return 0;
+#endif
+}
+
+std::size_t GetCurrentThreadIndex()
+{
+	static std::atomic<std::size_t> nextThreadIndex(0);
+	thread_local const std::size_t threadIndex = nextThreadIndex.fetch_add(1, std::memory_order_relaxed);
+	return threadIndex;
+}
+
 const void* MemorySource::GetEndPointer() const
 {
 	return reinterpret_cast<const void*>(reinterpret_cast<std::uintptr_t>(GetPointer()) + GetSize());
@@ -164,6 +267,92 @@ bool MemoryView::OwnsMemory() const
 	return false;
 }
 
+VirtualMemory::VirtualMemory(std::size_t bytes, std::size_t alignment /*= alignof(std::max_align_t)*/)
+	: mMemory(nullptr)
+	, mSize(0)
+	, mAlignment(alignment)
+{
+	// Pages are page-aligned, which covers any smaller alignment
+	if (bytes > 0)
+	{
+#if defined(_WIN32)
+		mMemory = VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+		mMemory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		if (mMemory == MAP_FAILED)
+		{
+			mMemory = nullptr;
+		}
+#endif
+		mSize = (mMemory != nullptr) ? bytes : 0;
+	}
+}
+
+VirtualMemory::~VirtualMemory()
+{
+	if (mMemory != nullptr)
+	{
+#if defined(_WIN32)
+		VirtualFree(mMemory, 0, MEM_RELEASE);
+#else
+		munmap(mMemory, mSize);
+#endif
+	}
+}
+
+const void* VirtualMemory::GetPointer() const
+{
+	return mMemory;
+}
+
+std::size_t VirtualMemory::GetSize() const
+{
+	return mSize;
+}
+
+std::size_t VirtualMemory::GetAlignment() const
+{
+	return mAlignment;
+}
+
+void MemoryUsage::Add(const MemoryUsage& other)
+{
+	usedSize += other.usedSize;
+	freeSize += other.freeSize;
+	largestFreeBlock = (other.largestFreeBlock > largestFreeBlock) ? other.largestFreeBlock : largestFreeBlock;
+	wastedSize += other.wastedSize;
+	freeBlockCount += other.freeBlockCount;
+}
+
+const MemorySource* Allocator::GetSource() const
+{
+	return nullptr;
+}
+
+bool Allocator::IsThreadSafe() const
+{
+	return false;
+}
+
+MemoryUsage Allocator::GetMemoryUsage() const
+{
+	return MemoryUsage();
+}
+
+#if defined(DYMA_HOOKS)
+
+void SetAllocationHooks(const AllocationHooks* hooks)
+{
+	gAllocationHooks.store(hooks, std::memory_order_release);
+}
+
+const AllocationHooks* GetAllocationHooks()
+{
+	return gAllocationHooks.load(std::memory_order_acquire);
+}
+
+#endif // DYMA_HOOKS
+
 void* NullAllocator::Allocate(std::size_t size)
 {
 	return nullptr;
@@ -179,6 +368,11 @@ bool NullAllocator::Owns(const void* ptr) const
 	return false;
 }
 
+bool NullAllocator::IsThreadSafe() const
+{
+	return true;
+}
+
 void* ForbiddenAllocator::Allocate(std::size_t size)
 {
 	assert(false);
@@ -196,6 +390,11 @@ bool ForbiddenAllocator::Owns(const void* ptr) const
 	return false;
 }
 
+bool ForbiddenAllocator::IsThreadSafe() const
+{
+	return true;
+}
+
 void* Mallocator::Allocate(std::size_t size)
 {
 	void* ptr = nullptr;
@@ -203,6 +402,7 @@ void* Mallocator::Allocate(std::size_t size)
 	{
 		ptr = Malloc(size);
 	}
+	DYMA_HOOK_ALLOCATE(*this, ptr, size);
 	return ptr;
 }
 
@@ -210,6 +410,7 @@ bool Mallocator::Deallocate(void*& ptr)
 {
 	if (ptr != nullptr)
 	{
+		DYMA_HOOK_DEALLOCATE(*this, ptr);
 		Free(ptr);
 		ptr = nullptr;
 		return true;
@@ -222,10 +423,68 @@ bool Mallocator::Owns(const void* ptr) const
 	return false;
 }
 
+bool Mallocator::IsThreadSafe() const
+{
+	return true;
+}
+
+namespace
+{
+
+// Usage of a linear allocator whose free memory is a single range
+MemoryUsage GetLinearUsage(std::size_t usedSize, std::size_t freeSize, std::size_t wastedSize)
+{
+	MemoryUsage usage;
+	usage.usedSize = usedSize;
+	usage.freeSize = freeSize;
+	usage.largestFreeBlock = freeSize;
+	usage.wastedSize = (wastedSize < usedSize) ? wastedSize : usedSize;
+	usage.freeBlockCount = (freeSize > 0) ? 1 : 0;
+	return usage;
+}
+
+std::atomic<std::FILE*> gLeakReportFile(nullptr);
+
+// Leak report of an allocator only knowing what it still hands out, blockCount is 0 when it doesn't know its blocks
+void ReportLeaks(const char* allocatorName, const void* allocator, std::size_t blockCount, std::size_t size)
+{
+	std::FILE* file = gLeakReportFile.load(std::memory_order_relaxed);
+	if (file == nullptr || size == 0)
+	{
+		return;
+	}
+	if (blockCount > 0)
+	{
+		std::fprintf(file, "%s %p : %zu blocks (%zu bytes) still allocated\n", allocatorName, allocator, blockCount, size);
+	}
+	else
+	{
+		std::fprintf(file, "%s %p : %zu bytes still allocated\n", allocatorName, allocator, size);
+	}
+}
+
+} // namespace
+
+void SetLeakReportFile(std::FILE* file)
+{
+	gLeakReportFile.store(file, std::memory_order_relaxed);
+}
+
+std::FILE* GetLeakReportFile()
+{
+	return gLeakReportFile.load(std::memory_order_relaxed);
+}
+
 StackAllocator::StackAllocator(MemorySource& source)
 	: mSource(source)
 	, mPointer(reinterpret_cast<std::uintptr_t>(mSource.GetPointer()))
+	, mWastedSize(0)
+{
+}
+
+StackAllocator::~StackAllocator()
 {
+	ReportLeaks("StackAllocator", this, 0, GetUsedSize());
 }
 
 void* StackAllocator::Allocate(std::size_t size)
@@ -234,9 +493,15 @@ void* StackAllocator::Allocate(std::size_t size)
 	const std::size_t alignedSize = RoundToAlignment(size, GetAlignment());
 	if (size > 0 && alignedSize <= GetRemainingSize())
 	{
+		if (GetUsedSize() == 0)
+		{
+			mWastedSize = 0;
+		}
 		ptr = reinterpret_cast<void*>(mPointer);
 		mPointer += alignedSize;
+		mWastedSize += alignedSize - size;
 	}
+	DYMA_HOOK_ALLOCATE(*this, ptr, size);
 	return ptr;
 }
 
@@ -245,6 +510,7 @@ bool StackAllocator::Deallocate(void*& ptr)
 	// You should only deallocate the last allocated block
 	if (ptr != nullptr)
 	{
+		DYMA_HOOK_DEALLOCATE(*this, ptr);
 		mPointer = reinterpret_cast<std::uintptr_t>(ptr);
 		ptr = nullptr;
 		return true;
@@ -257,6 +523,28 @@ bool StackAllocator::Owns(const void* ptr) const
 	return mSource.Owns(ptr);
 }
 
+const MemorySource* StackAllocator::GetSource() const
+{
+	return &mSource;
+}
+
+MemoryUsage StackAllocator::GetMemoryUsage() const
+{
+	return GetLinearUsage(GetUsedSize(), GetRemainingSize(), mWastedSize);
+}
+
+StackAllocator::Marker StackAllocator::GetMarker() const
+{
+	return mPointer;
+}
+
+void StackAllocator::FreeToMarker(Marker marker)
+{
+	// The marker should have been taken before the blocks to free were allocated
+	assert(reinterpret_cast<std::uintptr_t>(mSource.GetPointer()) <= marker && marker <= mPointer);
+	mPointer = marker;
+}
+
 void StackAllocator::DeallocateAll()
 {
 	mPointer = reinterpret_cast<std::uintptr_t>(mSource.GetPointer());
@@ -282,141 +570,4477 @@ std::size_t StackAllocator::GetAlignment() const
 	return mSource.GetAlignment();
 }
 
-PoolAllocator::PoolAllocator(MemorySource& source, std::size_t blockSize)
-	: mSource(source)
-	, mRootNode((Node*)mSource.GetPointer())
-	, mBlockSize(blockSize)
+ScopedArena::ScopedArena(StackAllocator& allocator)
+	: mAllocator(allocator)
+	, mMarker(allocator.GetMarker())
 {
-	assert(mBlockSize > 0);
-	assert(mBlockSize >= sizeof(void*));
-	assert(mSource.GetSize() % mBlockSize == 0);
+}
 
-	Node* nodePtr = mRootNode;
-	for (std::size_t i = 1; i < GetBlockCount() - 1; ++i)
+ScopedArena::~ScopedArena()
+{
+	mAllocator.FreeToMarker(mMarker);
+}
+
+void* ScopedArena::Allocate(std::size_t size)
+{
+	return mAllocator.Allocate(size);
+}
+
+bool ScopedArena::Deallocate(void*& ptr)
+{
+	return mAllocator.Deallocate(ptr);
+}
+
+bool ScopedArena::Owns(const void* ptr) const
+{
+	return mAllocator.Owns(ptr);
+}
+
+const MemorySource* ScopedArena::GetSource() const
+{
+	return mAllocator.GetSource();
+}
+
+MemoryUsage ScopedArena::GetMemoryUsage() const
+{
+	return mAllocator.GetMemoryUsage();
+}
+
+StackAllocator& ScopedArena::GetAllocator() const
+{
+	return mAllocator;
+}
+
+StackAllocator::Marker ScopedArena::GetMarker() const
+{
+	return mMarker;
+}
+
+namespace
+{
+
+std::atomic<std::size_t> gScratchArenaSize(16 * 1024 * 1024);
+std::atomic<bool> gScratchArenaUsesVirtualMemory(true);
+
+struct ScratchArena
+{
+	ScratchArena()
+		: memory(CreateMemory())
+		, allocator(*memory)
 	{
-		Node* node = nodePtr;
-		node->next = (Node*)(reinterpret_cast<std::uintptr_t>(mSource.GetPointer()) + i * mBlockSize);
-		nodePtr = node->next;
 	}
-	nodePtr->next = nullptr;
+
+	// MemorySource has no virtual destructor, a shared_ptr deletes the memory through its own type
+	static std::shared_ptr<MemorySource> CreateMemory()
+	{
+		const std::size_t size = gScratchArenaSize.load(std::memory_order_relaxed);
+		if (gScratchArenaUsesVirtualMemory.load(std::memory_order_relaxed))
+		{
+			return std::make_shared<VirtualMemory>(size);
+		}
+		return std::make_shared<HeapMemory>(size);
+	}
+
+	std::shared_ptr<MemorySource> memory;
+	StackAllocator allocator;
+};
+
+struct ScratchArenas
+{
+	ScratchArena first;
+	ScratchArena second;
+};
+
+} // namespace
+
+ScopedArena GetScratchArena(const Allocator* conflict /*= nullptr*/)
+{
+	thread_local ScratchArenas arenas;
+	if (conflict != nullptr && conflict->Owns(arenas.first.memory->GetPointer()))
+	{
+		return ScopedArena(arenas.second.allocator);
+	}
+	return ScopedArena(arenas.first.allocator);
 }
 
-void* PoolAllocator::Allocate(std::size_t size)
+void SetScratchArenaSize(std::size_t bytes, bool useVirtualMemory /*= true*/)
 {
-	void* ptr = nullptr;
-	if (size == mBlockSize && mRootNode != nullptr)
+	gScratchArenaSize.store(bytes, std::memory_order_relaxed);
+	gScratchArenaUsesVirtualMemory.store(useVirtualMemory, std::memory_order_relaxed);
+}
+
+std::size_t GetScratchArenaSize()
+{
+	return gScratchArenaSize.load(std::memory_order_relaxed);
+}
+
+ConcurrentLinearAllocator::ConcurrentLinearAllocator(MemorySource& source)
+	: mSource(source)
+	, mOffset(0)
+	, mWastedSize(0)
+{
+}
+
+void* ConcurrentLinearAllocator::Allocate(std::size_t size)
+{
+	const std::size_t alignedSize = RoundToAlignment(size, GetAlignment());
+	if (size == 0 || alignedSize > GetSize())
 	{
-		ptr = (void*)mRootNode;
-		mRootNode = mRootNode->next;
+		DYMA_HOOK_ALLOCATE(*this, nullptr, size);
+		return nullptr;
+	}
+
+	// A failed allocation leaves the offset past the end, every following allocation fails until DeallocateAll()
+	const std::size_t offset = mOffset.fetch_add(alignedSize, std::memory_order_relaxed);
+	if (offset + alignedSize > GetSize())
+	{
+		DYMA_HOOK_ALLOCATE(*this, nullptr, size);
+		return nullptr;
+	}
+	if (alignedSize != size)
+	{
+		mWastedSize.fetch_add(alignedSize - size, std::memory_order_relaxed);
 	}
+	void* ptr = reinterpret_cast<void*>(reinterpret_cast<std::uintptr_t>(mSource.GetPointer()) + offset);
+	DYMA_HOOK_ALLOCATE(*this, ptr, size);
 	return ptr;
 }
 
-bool PoolAllocator::Deallocate(void*& ptr)
+bool ConcurrentLinearAllocator::Deallocate(void*& ptr)
 {
-	if (mSource.Owns(ptr))
+	// The memory is only released by DeallocateAll()
+	if (ptr != nullptr && Owns(ptr))
 	{
-		Node* node = (Node*)ptr;
-		node->next = mRootNode;
-		mRootNode = node;
+		DYMA_HOOK_DEALLOCATE(*this, ptr);
 		ptr = nullptr;
 		return true;
 	}
 	return false;
 }
 
-bool PoolAllocator::Owns(const void* ptr) const
+bool ConcurrentLinearAllocator::Owns(const void* ptr) const
 {
 	return mSource.Owns(ptr);
 }
 
-std::size_t PoolAllocator::GetBlockSize() const
+const MemorySource* ConcurrentLinearAllocator::GetSource() const
 {
-	return mBlockSize;
+	return &mSource;
 }
 
-std::size_t PoolAllocator::GetBlockCount() const
+bool ConcurrentLinearAllocator::IsThreadSafe() const
 {
-	return mSource.GetSize() / mBlockSize;
+	return true;
 }
 
-std::size_t PoolAllocator::GetSize() const
+MemoryUsage ConcurrentLinearAllocator::GetMemoryUsage() const
 {
-	return mSource.GetSize();
+	return GetLinearUsage(GetUsedSize(), GetRemainingSize(), mWastedSize.load(std::memory_order_relaxed));
 }
 
-FallbackAllocator::FallbackAllocator(Allocator& primaryAllocator, Allocator& secondaryAllocator)
-	: mPrimary(primaryAllocator)
-	, mSecondary(secondaryAllocator)
+void ConcurrentLinearAllocator::DeallocateAll()
 {
+	mOffset.store(0, std::memory_order_relaxed);
+	mWastedSize.store(0, std::memory_order_relaxed);
 }
 
-void* FallbackAllocator::Allocate(std::size_t size)
+std::size_t ConcurrentLinearAllocator::GetUsedSize() const
 {
-	void* ptr = mPrimary.Allocate(size);
-	if (ptr == nullptr)
-	{
-		ptr = mSecondary.Allocate(size);
-	}
-	return ptr;
+	const std::size_t offset = mOffset.load(std::memory_order_relaxed);
+	return (offset < GetSize()) ? offset : GetSize();
 }
 
-bool FallbackAllocator::Deallocate(void*& ptr)
+std::size_t ConcurrentLinearAllocator::GetRemainingSize() const
 {
-	if (mPrimary.Owns(ptr))
-	{
-		return mPrimary.Deallocate(ptr);
-	}
-	else
-	{
-		return mSecondary.Deallocate(ptr);
-	}
+	return GetSize() - GetUsedSize();
 }
 
-bool FallbackAllocator::Owns(const void* ptr) const
+std::size_t ConcurrentLinearAllocator::GetSize() const
 {
-	return mPrimary.Owns(ptr) || mSecondary.Owns(ptr);
+	return mSource.GetSize();
 }
 
-SegregatorAllocator::SegregatorAllocator(std::size_t threshold, Allocator& smaller, Allocator& larger)
-	: mSmallerAllocator(smaller)
-	, mLargerAllocator(larger)
-	, mThreshold(threshold)
+std::size_t ConcurrentLinearAllocator::GetAlignment() const
 {
+	return mSource.GetAlignment();
 }
 
-void* SegregatorAllocator::Allocate(std::size_t size)
+namespace
 {
-	if (size <= mThreshold)
+
+thread_local std::size_t tCurrentWorker = TaskArenaAllocator::NoWorker;
+
+} // namespace
+
+TaskArenaAllocator::TaskArenaAllocator(MemorySource& source, std::size_t workerCount)
+	: mSource(source)
+	, mArenas(new Arena[workerCount])
+	, mWorkerCount(workerCount)
+	, mArenaSize(0)
+{
+	assert(mWorkerCount > 0);
+	const std::size_t alignment = mSource.GetAlignment();
+	mArenaSize = mSource.GetSize() / mWorkerCount;
+	if (alignment > 0)
 	{
-		return mSmallerAllocator.Allocate(size);
+		mArenaSize -= mArenaSize % alignment;
 	}
-	else
+	for (std::size_t i = 0; i < mWorkerCount; ++i)
 	{
-		return mLargerAllocator.Allocate(size);
+		mArenas[i].begin = reinterpret_cast<std::uintptr_t>(mSource.GetPointer()) + i * mArenaSize;
+		mArenas[i].pointer = mArenas[i].begin;
+		mArenas[i].wastedSize = 0;
 	}
 }
 
-bool SegregatorAllocator::Deallocate(void*& ptr)
+TaskArenaAllocator::~TaskArenaAllocator()
 {
-	if (mSmallerAllocator.Owns(ptr))
+	delete[] mArenas;
+}
+
+void* TaskArenaAllocator::Allocate(std::size_t size)
+{
+	void* ptr = nullptr;
+	const std::size_t workerIndex = tCurrentWorker;
+	if (workerIndex < mWorkerCount)
 	{
-		return mSmallerAllocator.Deallocate(ptr);
+		Arena& arena = mArenas[workerIndex];
+		const std::size_t alignedSize = RoundToAlignment(size, mSource.GetAlignment());
+		if (size > 0 && alignedSize <= arena.begin + mArenaSize - arena.pointer)
+		{
+			ptr = reinterpret_cast<void*>(arena.pointer);
+			arena.pointer += alignedSize;
+			arena.wastedSize += alignedSize - size;
+		}
 	}
-	else
+	DYMA_HOOK_ALLOCATE(*this, ptr, size);
+	return ptr;
+}
+
+bool TaskArenaAllocator::Deallocate(void*& ptr)
+{
+	// The memory is only released by DeallocateAll()
+	if (ptr != nullptr && Owns(ptr))
 	{
-		return mLargerAllocator.Deallocate(ptr);
+		DYMA_HOOK_DEALLOCATE(*this, ptr);
+		ptr = nullptr;
+		return true;
 	}
+	return false;
 }
 
-bool SegregatorAllocator::Owns(const void* ptr) const
+bool TaskArenaAllocator::Owns(const void* ptr) const
 {
-	return mSmallerAllocator.Owns(ptr) || mLargerAllocator.Owns(ptr);
+	return mSource.Owns(ptr);
+}
+
+const MemorySource* TaskArenaAllocator::GetSource() const
+{
+	return &mSource;
+}
+
+bool TaskArenaAllocator::IsThreadSafe() const
+{
+	return true;
+}
+
+MemoryUsage TaskArenaAllocator::GetMemoryUsage() const
+{
+	// Each arena is a free range, only meaningful between DeallocateAll() calls as the workers write their arena without synchronization
+	MemoryUsage usage;
+	usage.wastedSize = mSource.GetSize() - mWorkerCount * mArenaSize;
+	for (std::size_t i = 0; i < mWorkerCount; ++i)
+	{
+		const std::size_t usedSize = GetUsedSize(i);
+		usage.Add(GetLinearUsage(usedSize, mArenaSize - usedSize, mArenas[i].wastedSize));
+	}
+	return usage;
+}
+
+void TaskArenaAllocator::DeallocateAll()
+{
+	for (std::size_t i = 0; i < mWorkerCount; ++i)
+	{
+		mArenas[i].pointer = mArenas[i].begin;
+		mArenas[i].wastedSize = 0;
+	}
+}
+
+void TaskArenaAllocator::SetCurrentWorker(std::size_t workerIndex)
+{
+	tCurrentWorker = workerIndex;
+}
+
+std::size_t TaskArenaAllocator::GetCurrentWorker()
+{
+	return tCurrentWorker;
+}
+
+std::size_t TaskArenaAllocator::GetWorkerCount() const
+{
+	return mWorkerCount;
+}
+
+std::size_t TaskArenaAllocator::GetArenaSize() const
+{
+	return mArenaSize;
+}
+
+std::size_t TaskArenaAllocator::GetUsedSize(std::size_t workerIndex) const
+{
+	assert(workerIndex < mWorkerCount);
+	return mArenas[workerIndex].pointer - mArenas[workerIndex].begin;
+}
+
+std::size_t TaskArenaAllocator::GetUsedSize() const
+{
+	std::size_t usedSize = 0;
+	for (std::size_t i = 0; i < mWorkerCount; ++i)
+	{
+		usedSize += GetUsedSize(i);
+	}
+	return usedSize;
+}
+
+DoubleEndedStackAllocator::DoubleEndedStackAllocator(MemorySource& source)
+	: mSource(source)
+	, mBottom(reinterpret_cast<std::uintptr_t>(mSource.GetPointer()))
+	, mTop(reinterpret_cast<std::uintptr_t>(mSource.GetEndPointer()))
+	, mWastedSize(0)
+{
+	// The top stack grows down from the end, which must stay aligned
+	assert(mSource.GetAlignment() == 0 || mSource.GetSize() % mSource.GetAlignment() == 0);
+}
+
+DoubleEndedStackAllocator::~DoubleEndedStackAllocator()
+{
+	ReportLeaks("DoubleEndedStackAllocator", this, 0, GetUsedSize());
+}
+
+void* DoubleEndedStackAllocator::Allocate(std::size_t size)
+{
+	return AllocateBottom(size);
+}
+
+bool DoubleEndedStackAllocator::Deallocate(void*& ptr)
+{
+	// You should only deallocate the last allocated block of each side
+	if (ptr != nullptr && Owns(ptr))
+	{
+		const std::uintptr_t address = reinterpret_cast<std::uintptr_t>(ptr);
+		if (address < mBottom)
+		{
+			mBottom = address;
+		}
+		DYMA_HOOK_DEALLOCATE(*this, ptr);
+		ptr = nullptr;
+		return true;
+	}
+	return false;
+}
+
+bool DoubleEndedStackAllocator::Owns(const void* ptr) const
+{
+	return mSource.Owns(ptr);
+}
+
+const MemorySource* DoubleEndedStackAllocator::GetSource() const
+{
+	return &mSource;
+}
+
+MemoryUsage DoubleEndedStackAllocator::GetMemoryUsage() const
+{
+	return GetLinearUsage(GetUsedSize(), GetRemainingSize(), mWastedSize);
+}
+
+void* DoubleEndedStackAllocator::AllocateBottom(std::size_t size)
+{
+	void* ptr = nullptr;
+	const std::size_t alignedSize = RoundToAlignment(size, GetAlignment());
+	if (size > 0 && alignedSize <= GetRemainingSize())
+	{
+		if (GetUsedSize() == 0)
+		{
+			mWastedSize = 0;
+		}
+		ptr = reinterpret_cast<void*>(mBottom);
+		mBottom += alignedSize;
+		mWastedSize += alignedSize - size;
+	}
+	DYMA_HOOK_ALLOCATE(*this, ptr, size);
+	return ptr;
+}
+
+void* DoubleEndedStackAllocator::AllocateTop(std::size_t size)
+{
+	void* ptr = nullptr;
+	const std::size_t alignedSize = RoundToAlignment(size, GetAlignment());
+	if (size > 0 && alignedSize <= GetRemainingSize())
+	{
+		if (GetUsedSize() == 0)
+		{
+			mWastedSize = 0;
+		}
+		mTop -= alignedSize;
+		ptr = reinterpret_cast<void*>(mTop);
+		mWastedSize += alignedSize - size;
+	}
+	DYMA_HOOK_ALLOCATE(*this, ptr, size);
+	return ptr;
+}
+
+DoubleEndedStackAllocator::Marker DoubleEndedStackAllocator::GetBottomMarker() const
+{
+	return mBottom;
+}
+
+DoubleEndedStackAllocator::Marker DoubleEndedStackAllocator::GetTopMarker() const
+{
+	return mTop;
+}
+
+void DoubleEndedStackAllocator::FreeToBottomMarker(Marker marker)
+{
+	assert(reinterpret_cast<std::uintptr_t>(mSource.GetPointer()) <= marker && marker <= mBottom);
+	mBottom = marker;
+}
+
+void DoubleEndedStackAllocator::FreeToTopMarker(Marker marker)
+{
+	assert(mTop <= marker && marker <= reinterpret_cast<std::uintptr_t>(mSource.GetEndPointer()));
+	mTop = marker;
+}
+
+void DoubleEndedStackAllocator::DeallocateBottom()
+{
+	mBottom = reinterpret_cast<std::uintptr_t>(mSource.GetPointer());
+}
+
+void DoubleEndedStackAllocator::DeallocateTop()
+{
+	mTop = reinterpret_cast<std::uintptr_t>(mSource.GetEndPointer());
+}
+
+void DoubleEndedStackAllocator::DeallocateAll()
+{
+	DeallocateBottom();
+	DeallocateTop();
+}
+
+std::size_t DoubleEndedStackAllocator::GetBottomUsedSize() const
+{
+	return mBottom - reinterpret_cast<std::uintptr_t>(mSource.GetPointer());
+}
+
+std::size_t DoubleEndedStackAllocator::GetTopUsedSize() const
+{
+	return reinterpret_cast<std::uintptr_t>(mSource.GetEndPointer()) - mTop;
+}
+
+std::size_t DoubleEndedStackAllocator::GetUsedSize() const
+{
+	return GetBottomUsedSize() + GetTopUsedSize();
+}
+
+std::size_t DoubleEndedStackAllocator::GetRemainingSize() const
+{
+	return mTop - mBottom;
+}
+
+std::size_t DoubleEndedStackAllocator::GetSize() const
+{
+	return mSource.GetSize();
+}
+
+std::size_t DoubleEndedStackAllocator::GetAlignment() const
+{
+	return mSource.GetAlignment();
+}
+
+RingAllocator::RingAllocator(MemorySource& source)
+	: mSource(source)
+	, mHeaderSize(RoundToAlignment(sizeof(BlockHeader), mSource.GetAlignment()))
+	, mHead(0)
+	, mTail(0)
+	, mUsedSize(0)
+	, mWastedSize(0)
+{
+	assert(mSource.GetAlignment() > 0);
+	assert(mSource.GetSize() % mSource.GetAlignment() == 0);
+}
+
+RingAllocator::~RingAllocator()
+{
+	ReportLeaks("RingAllocator", this, 0, GetUsedSize());
+}
+
+void* RingAllocator::Allocate(std::size_t size)
+{
+	const std::size_t capacity = GetSize();
+	const std::size_t blockSize = mHeaderSize + RoundToAlignment(size, GetAlignment());
+	if (size == 0 || blockSize > capacity)
+	{
+		DYMA_HOOK_ALLOCATE(*this, nullptr, size);
+		return nullptr;
+	}
+
+	if (mUsedSize == 0)
+	{
+		// Restart from the beginning to get the largest contiguous space
+		mHead = 0;
+		mTail = 0;
+		mWastedSize = 0;
+	}
+
+	const bool wrapped = (mHead < mTail) || (mHead == mTail && mUsedSize > 0);
+	if (wrapped)
+	{
+		if (mTail - mHead < blockSize)
+		{
+			DYMA_HOOK_ALLOCATE(*this, nullptr, size);
+			return nullptr;
+		}
+	}
+	else if (capacity - mHead < blockSize)
+	{
+		if (mTail < blockSize)
+		{
+			DYMA_HOOK_ALLOCATE(*this, nullptr, size);
+			return nullptr;
+		}
+
+		// Skip the end of the buffer, the padding is reclaimed with the block before it
+		const std::size_t padding = capacity - mHead;
+		if (padding >= mHeaderSize)
+		{
+			BlockHeader* paddingHeader = GetHeader(mHead);
+			paddingHeader->size = padding;
+			paddingHeader->freed = 1;
+		}
+		mUsedSize += padding;
+		mWastedSize += padding;
+		mHead = 0;
+	}
+
+	BlockHeader* header = GetHeader(mHead);
+	header->size = blockSize;
+	header->freed = 0;
+	mUsedSize += blockSize;
+	mWastedSize += blockSize - size;
+	mHead += blockSize;
+	if (mHead == capacity)
+	{
+		mHead = 0;
+	}
+	void* ptr = reinterpret_cast<void*>(reinterpret_cast<std::uintptr_t>(header) + mHeaderSize);
+	DYMA_HOOK_ALLOCATE(*this, ptr, size);
+	return ptr;
+}
+
+bool RingAllocator::Deallocate(void*& ptr)
+{
+	if (ptr != nullptr && Owns(ptr))
+	{
+		BlockHeader* header = reinterpret_cast<BlockHeader*>(reinterpret_cast<std::uintptr_t>(ptr) - mHeaderSize);
+		assert(header->freed == 0);
+		header->freed = 1;
+		ReclaimFreedBlocks();
+		DYMA_HOOK_DEALLOCATE(*this, ptr);
+		ptr = nullptr;
+		return true;
+	}
+	return false;
+}
+
+bool RingAllocator::Owns(const void* ptr) const
+{
+	return mSource.Owns(ptr);
+}
+
+const MemorySource* RingAllocator::GetSource() const
+{
+	return &mSource;
+}
+
+MemoryUsage RingAllocator::GetMemoryUsage() const
+{
+	// The free memory is split in two ranges when the used blocks don't wrap, but a block can't straddle the end of the buffer
+	MemoryUsage usage;
+	usage.usedSize = mUsedSize;
+	usage.freeSize = GetRemainingSize();
+	usage.wastedSize = (mWastedSize < mUsedSize) ? mWastedSize : mUsedSize;
+	const std::size_t capacity = GetSize();
+	const bool wrapped = (mHead < mTail) || (mHead == mTail && mUsedSize > 0);
+	const std::size_t firstRange = wrapped ? mTail - mHead : ((mUsedSize > 0) ? capacity - mHead : capacity);
+	const std::size_t secondRange = usage.freeSize - firstRange;
+	usage.largestFreeBlock = (firstRange > secondRange) ? firstRange : secondRange;
+	usage.freeBlockCount = ((firstRange > 0) ? 1 : 0) + ((secondRange > 0) ? 1 : 0);
+	return usage;
+}
+
+void RingAllocator::DeallocateAll()
+{
+	mHead = 0;
+	mTail = 0;
+	mUsedSize = 0;
+	mWastedSize = 0;
+}
+
+std::size_t RingAllocator::GetUsedSize() const
+{
+	return mUsedSize;
+}
+
+std::size_t RingAllocator::GetRemainingSize() const
+{
+	return GetSize() - mUsedSize;
+}
+
+std::size_t RingAllocator::GetSize() const
+{
+	return mSource.GetSize();
+}
+
+std::size_t RingAllocator::GetAlignment() const
+{
+	return mSource.GetAlignment();
+}
+
+RingAllocator::BlockHeader* RingAllocator::GetHeader(std::size_t offset) const
+{
+	return reinterpret_cast<BlockHeader*>(reinterpret_cast<std::uintptr_t>(mSource.GetPointer()) + offset);
+}
+
+void RingAllocator::ReclaimFreedBlocks()
+{
+	// Move the tail forward over every freed block, stopping at the oldest block still in use
+	const std::size_t capacity = GetSize();
+	while (mUsedSize > 0)
+	{
+		std::size_t blockSize = capacity - mTail;
+		if (blockSize >= mHeaderSize)
+		{
+			const BlockHeader* header = GetHeader(mTail);
+			if (header->freed == 0)
+			{
+				break;
+			}
+			blockSize = header->size;
+		}
+		mUsedSize -= blockSize;
+		mTail += blockSize;
+		if (mTail == capacity)
+		{
+			mTail = 0;
+		}
+	}
+	if (mUsedSize == 0)
+	{
+		mHead = 0;
+		mTail = 0;
+	}
+}
+
+PoolAllocator::PoolAllocator(MemorySource& source, std::size_t blockSize)
+	: mSource(source)
+	, mRootNode((Node*)mSource.GetPointer())
+	, mBlockSize(blockSize)
+{
+	assert(mBlockSize > 0);
+	assert(mBlockSize >= sizeof(void*));
+	assert(mSource.GetSize() % mBlockSize == 0);
+
+	Node* nodePtr = mRootNode;
+	for (std::size_t i = 1; i < GetBlockCount(); ++i)
+	{
+		Node* node = nodePtr;
+		node->next = (Node*)(reinterpret_cast<std::uintptr_t>(mSource.GetPointer()) + i * mBlockSize);
+		nodePtr = node->next;
+	}
+	nodePtr->next = nullptr;
+}
+
+PoolAllocator::~PoolAllocator()
+{
+	// Walking the free list is only worth it when reporting
+	if (GetLeakReportFile() != nullptr)
+	{
+		const std::size_t usedSize = GetMemoryUsage().usedSize;
+		ReportLeaks("PoolAllocator", this, usedSize / mBlockSize, usedSize);
+	}
+}
+
+void* PoolAllocator::Allocate(std::size_t size)
+{
+	void* ptr = nullptr;
+	if (size == mBlockSize && mRootNode != nullptr)
+	{
+		ptr = (void*)mRootNode;
+		mRootNode = mRootNode->next;
+	}
+	DYMA_HOOK_ALLOCATE(*this, ptr, size);
+	return ptr;
+}
+
+bool PoolAllocator::Deallocate(void*& ptr)
+{
+	if (mSource.Owns(ptr))
+	{
+		DYMA_HOOK_DEALLOCATE(*this, ptr);
+		Node* node = (Node*)ptr;
+		node->next = mRootNode;
+		mRootNode = node;
+		ptr = nullptr;
+		return true;
+	}
+	return false;
+}
+
+bool PoolAllocator::Owns(const void* ptr) const
+{
+	return mSource.Owns(ptr);
+}
+
+const MemorySource* PoolAllocator::GetSource() const
+{
+	return &mSource;
+}
+
+MemoryUsage PoolAllocator::GetMemoryUsage() const
+{
+	std::size_t freeCount = 0;
+	for (const Node* node = mRootNode; node != nullptr; node = node->next)
+	{
+		freeCount++;
+	}
+	MemoryUsage usage;
+	usage.freeSize = freeCount * mBlockSize;
+	usage.usedSize = GetSize() - usage.freeSize;
+	usage.largestFreeBlock = (freeCount > 0) ? mBlockSize : 0;
+	usage.freeBlockCount = freeCount;
+	return usage;
+}
+
+std::size_t PoolAllocator::GetBlockSize() const
+{
+	return mBlockSize;
+}
+
+std::size_t PoolAllocator::GetBlockCount() const
+{
+	return mSource.GetSize() / mBlockSize;
+}
+
+std::size_t PoolAllocator::GetSize() const
+{
+	return mSource.GetSize();
+}
+
+ConcurrentPoolAllocator::ConcurrentPoolAllocator(MemorySource& source, std::size_t blockSize)
+	: mSource(source)
+	, mHead(0)
+	, mFreeCount(0)
+	, mBlockSize(blockSize)
+{
+	assert(mBlockSize > 0);
+	assert(mBlockSize >= sizeof(void*));
+	assert(mSource.GetSize() % mBlockSize == 0);
+	assert(GetBlockCount() < 0xFFFFFFFF);
+
+	const std::size_t blockCount = GetBlockCount();
+	const std::uintptr_t firstBlock = reinterpret_cast<std::uintptr_t>(mSource.GetPointer());
+	for (std::size_t i = 0; i < blockCount; ++i)
+	{
+		Node* node = new ((void*)(firstBlock + i * mBlockSize)) Node;
+		Node* next = (i + 1 < blockCount) ? (Node*)(firstBlock + (i + 1) * mBlockSize) : nullptr;
+		node->next.store(next, std::memory_order_relaxed);
+	}
+	mFreeCount.store(blockCount, std::memory_order_relaxed);
+	if (blockCount > 0)
+	{
+		mHead.store(MakeHead((Node*)firstBlock, 0), std::memory_order_release);
+	}
+}
+
+ConcurrentPoolAllocator::~ConcurrentPoolAllocator()
+{
+	const std::size_t usedSize = GetMemoryUsage().usedSize;
+	ReportLeaks("ConcurrentPoolAllocator", this, usedSize / mBlockSize, usedSize);
+}
+
+void* ConcurrentPoolAllocator::Allocate(std::size_t size)
+{
+	if (size != mBlockSize)
+	{
+		DYMA_HOOK_ALLOCATE(*this, nullptr, size);
+		return nullptr;
+	}
+
+	std::uint64_t head = mHead.load(std::memory_order_acquire);
+	Node* node = GetNode(head);
+	while (node != nullptr)
+	{
+		// The node might be popped by another thread meanwhile, it stays readable as it lives in the source, and the tag makes the exchange fail
+		Node* next = node->next.load(std::memory_order_relaxed);
+		if (mHead.compare_exchange_weak(head, MakeHead(next, head), std::memory_order_acquire, std::memory_order_acquire))
+		{
+			mFreeCount.fetch_sub(1, std::memory_order_relaxed);
+			break;
+		}
+		node = GetNode(head);
+	}
+	DYMA_HOOK_ALLOCATE(*this, (void*)node, size);
+	return (void*)node;
+}
+
+bool ConcurrentPoolAllocator::Deallocate(void*& ptr)
+{
+	if (mSource.Owns(ptr))
+	{
+		// Before the push, once pushed the block can be allocated again by another thread
+		DYMA_HOOK_DEALLOCATE(*this, ptr);
+		Node* node = (Node*)ptr;
+		std::uint64_t head = mHead.load(std::memory_order_relaxed);
+		do
+		{
+			node->next.store(GetNode(head), std::memory_order_relaxed);
+		} while (!mHead.compare_exchange_weak(head, MakeHead(node, head), std::memory_order_release, std::memory_order_relaxed));
+		mFreeCount.fetch_add(1, std::memory_order_relaxed);
+		ptr = nullptr;
+		return true;
+	}
+	return false;
+}
+
+bool ConcurrentPoolAllocator::Owns(const void* ptr) const
+{
+	return mSource.Owns(ptr);
+}
+
+const MemorySource* ConcurrentPoolAllocator::GetSource() const
+{
+	return &mSource;
+}
+
+bool ConcurrentPoolAllocator::IsThreadSafe() const
+{
+	return true;
+}
+
+MemoryUsage ConcurrentPoolAllocator::GetMemoryUsage() const
+{
+	// The count is updated after the stack, it can be off by the allocations in progress
+	std::size_t freeCount = mFreeCount.load(std::memory_order_relaxed);
+	freeCount = (freeCount < GetBlockCount()) ? freeCount : GetBlockCount();
+	MemoryUsage usage;
+	usage.freeSize = freeCount * mBlockSize;
+	usage.usedSize = GetSize() - usage.freeSize;
+	usage.largestFreeBlock = (freeCount > 0) ? mBlockSize : 0;
+	usage.freeBlockCount = freeCount;
+	return usage;
+}
+
+std::size_t ConcurrentPoolAllocator::GetBlockSize() const
+{
+	return mBlockSize;
+}
+
+std::size_t ConcurrentPoolAllocator::GetBlockCount() const
+{
+	return mSource.GetSize() / mBlockSize;
+}
+
+std::size_t ConcurrentPoolAllocator::GetSize() const
+{
+	return mSource.GetSize();
+}
+
+ConcurrentPoolAllocator::Node* ConcurrentPoolAllocator::GetNode(std::uint64_t head) const
+{
+	// The low 32 bits hold the block index plus one, zero being the empty stack
+	const std::uint64_t index = head & 0xFFFFFFFF;
+	if (index == 0)
+	{
+		return nullptr;
+	}
+	return (Node*)(reinterpret_cast<std::uintptr_t>(mSource.GetPointer()) + (index - 1) * mBlockSize);
+}
+
+std::uint64_t ConcurrentPoolAllocator::MakeHead(const Node* node, std::uint64_t previousHead) const
+{
+	// The high 32 bits hold the tag
+	const std::uint64_t tag = ((previousHead >> 32) + 1) & 0xFFFFFFFF;
+	std::uint64_t index = 0;
+	if (node != nullptr)
+	{
+		index = (reinterpret_cast<std::uintptr_t>(node) - reinterpret_cast<std::uintptr_t>(mSource.GetPointer())) / mBlockSize + 1;
+	}
+	return (tag << 32) | index;
+}
+
+GrowablePoolAllocator::GrowablePoolAllocator(Allocator& upstream, std::size_t blockSize, std::size_t blocksPerChunk)
+	: mUpstream(upstream)
+	, mFirstChunk(nullptr)
+	, mLastChunk(nullptr)
+	, mBlockSize(blockSize)
+	, mBlocksPerChunk(blocksPerChunk)
+	, mChunkHeaderSize(RoundToAlignment(sizeof(Chunk), alignof(std::max_align_t)))
+	, mChunkCount(0)
+{
+	assert(mBlockSize > 0);
+	assert(mBlockSize >= sizeof(void*));
+	assert(mBlocksPerChunk > 0);
+}
+
+GrowablePoolAllocator::~GrowablePoolAllocator()
+{
+	if (GetLeakReportFile() != nullptr)
+	{
+		const MemoryUsage usage = GetMemoryUsage();
+		const std::size_t blockCount = (usage.usedSize - usage.wastedSize) / mBlockSize;
+		ReportLeaks("GrowablePoolAllocator", this, blockCount, blockCount * mBlockSize);
+	}
+	while (mFirstChunk != nullptr)
+	{
+		Chunk* chunk = mFirstChunk;
+		Unlink(chunk);
+		void* chunkPtr = (void*)chunk;
+		mUpstream.Deallocate(chunkPtr);
+	}
+}
+
+void* GrowablePoolAllocator::Allocate(std::size_t size)
+{
+	if (size != mBlockSize)
+	{
+		DYMA_HOOK_ALLOCATE(*this, nullptr, size);
+		return nullptr;
+	}
+
+	Chunk* chunk = mFirstChunk;
+	if (chunk == nullptr || chunk->freeCount == 0)
+	{
+		chunk = CreateChunk();
+		if (chunk == nullptr)
+		{
+			DYMA_HOOK_ALLOCATE(*this, nullptr, size);
+			return nullptr;
+		}
+		LinkFront(chunk);
+	}
+
+	void* ptr = (void*)chunk->rootNode;
+	chunk->rootNode = chunk->rootNode->next;
+	chunk->freeCount--;
+	if (chunk->freeCount == 0 && chunk != mLastChunk)
+	{
+		Unlink(chunk);
+		LinkBack(chunk);
+	}
+	DYMA_HOOK_ALLOCATE(*this, ptr, size);
+	return ptr;
+}
+
+bool GrowablePoolAllocator::Deallocate(void*& ptr)
+{
+	Chunk* chunk = FindChunk(ptr);
+	if (chunk == nullptr)
+	{
+		return false;
+	}
+
+	DYMA_HOOK_DEALLOCATE(*this, ptr);
+	Node* node = (Node*)ptr;
+	node->next = chunk->rootNode;
+	chunk->rootNode = node;
+	chunk->freeCount++;
+	ptr = nullptr;
+
+	if (chunk->freeCount == mBlocksPerChunk)
+	{
+		Unlink(chunk);
+		void* chunkPtr = (void*)chunk;
+		mUpstream.Deallocate(chunkPtr);
+	}
+	else if (chunk->freeCount == 1 && chunk != mFirstChunk)
+	{
+		// The chunk was full, move it with the chunks having free blocks
+		Unlink(chunk);
+		LinkFront(chunk);
+	}
+	return true;
+}
+
+bool GrowablePoolAllocator::Owns(const void* ptr) const
+{
+	return FindChunk(ptr) != nullptr;
+}
+
+MemoryUsage GrowablePoolAllocator::GetMemoryUsage() const
+{
+	// The chunk headers are wasted
+	MemoryUsage usage;
+	for (const Chunk* chunk = mFirstChunk; chunk != nullptr; chunk = chunk->next)
+	{
+		usage.usedSize += GetChunkSize() - chunk->freeCount * mBlockSize;
+		usage.freeSize += chunk->freeCount * mBlockSize;
+		usage.freeBlockCount += chunk->freeCount;
+	}
+	usage.wastedSize = mChunkCount * mChunkHeaderSize;
+	usage.largestFreeBlock = (usage.freeBlockCount > 0) ? mBlockSize : 0;
+	return usage;
+}
+
+std::size_t GrowablePoolAllocator::GetBlockSize() const
+{
+	return mBlockSize;
+}
+
+std::size_t GrowablePoolAllocator::GetBlocksPerChunk() const
+{
+	return mBlocksPerChunk;
+}
+
+std::size_t GrowablePoolAllocator::GetChunkSize() const
+{
+	return mChunkHeaderSize + mBlocksPerChunk * mBlockSize;
+}
+
+std::size_t GrowablePoolAllocator::GetChunkCount() const
+{
+	return mChunkCount;
+}
+
+GrowablePoolAllocator::Chunk* GrowablePoolAllocator::CreateChunk()
+{
+	Chunk* chunk = (Chunk*)mUpstream.Allocate(GetChunkSize());
+	if (chunk != nullptr)
+	{
+		const std::uintptr_t firstBlock = reinterpret_cast<std::uintptr_t>(chunk) + mChunkHeaderSize;
+		chunk->previous = nullptr;
+		chunk->next = nullptr;
+		chunk->rootNode = (Node*)firstBlock;
+		chunk->freeCount = mBlocksPerChunk;
+
+		Node* nodePtr = chunk->rootNode;
+		for (std::size_t i = 1; i < mBlocksPerChunk; ++i)
+		{
+			nodePtr->next = (Node*)(firstBlock + i * mBlockSize);
+			nodePtr = nodePtr->next;
+		}
+		nodePtr->next = nullptr;
+	}
+	return chunk;
+}
+
+GrowablePoolAllocator::Chunk* GrowablePoolAllocator::FindChunk(const void* ptr) const
+{
+	const std::uintptr_t address = reinterpret_cast<std::uintptr_t>(ptr);
+	for (Chunk* chunk = mFirstChunk; chunk != nullptr; chunk = chunk->next)
+	{
+		const std::uintptr_t firstBlock = reinterpret_cast<std::uintptr_t>(chunk) + mChunkHeaderSize;
+		if (firstBlock <= address && address < firstBlock + mBlocksPerChunk * mBlockSize)
+		{
+			return chunk;
+		}
+	}
+	return nullptr;
+}
+
+void GrowablePoolAllocator::LinkFront(Chunk* chunk)
+{
+	chunk->previous = nullptr;
+	chunk->next = mFirstChunk;
+	if (mFirstChunk != nullptr)
+	{
+		mFirstChunk->previous = chunk;
+	}
+	else
+	{
+		mLastChunk = chunk;
+	}
+	mFirstChunk = chunk;
+	mChunkCount++;
+}
+
+void GrowablePoolAllocator::LinkBack(Chunk* chunk)
+{
+	chunk->previous = mLastChunk;
+	chunk->next = nullptr;
+	if (mLastChunk != nullptr)
+	{
+		mLastChunk->next = chunk;
+	}
+	else
+	{
+		mFirstChunk = chunk;
+	}
+	mLastChunk = chunk;
+	mChunkCount++;
+}
+
+void GrowablePoolAllocator::Unlink(Chunk* chunk)
+{
+	if (chunk->previous != nullptr)
+	{
+		chunk->previous->next = chunk->next;
+	}
+	else
+	{
+		mFirstChunk = chunk->next;
+	}
+	if (chunk->next != nullptr)
+	{
+		chunk->next->previous = chunk->previous;
+	}
+	else
+	{
+		mLastChunk = chunk->previous;
+	}
+	chunk->previous = nullptr;
+	chunk->next = nullptr;
+	mChunkCount--;
+}
+
+FallbackAllocator::FallbackAllocator(Allocator& primaryAllocator, Allocator& secondaryAllocator)
+	: mPrimary(primaryAllocator)
+	, mSecondary(secondaryAllocator)
+{
+}
+
+void* FallbackAllocator::Allocate(std::size_t size)
+{
+	void* ptr = mPrimary.Allocate(size);
+	if (ptr == nullptr)
+	{
+		ptr = mSecondary.Allocate(size);
+	}
+	return ptr;
+}
+
+bool FallbackAllocator::Deallocate(void*& ptr)
+{
+	if (mPrimary.Owns(ptr))
+	{
+		return mPrimary.Deallocate(ptr);
+	}
+	else
+	{
+		return mSecondary.Deallocate(ptr);
+	}
+}
+
+bool FallbackAllocator::Owns(const void* ptr) const
+{
+	return mPrimary.Owns(ptr) || mSecondary.Owns(ptr);
+}
+
+bool FallbackAllocator::IsThreadSafe() const
+{
+	return mPrimary.IsThreadSafe() && mSecondary.IsThreadSafe();
+}
+
+MemoryUsage FallbackAllocator::GetMemoryUsage() const
+{
+	MemoryUsage usage = mPrimary.GetMemoryUsage();
+	usage.Add(mSecondary.GetMemoryUsage());
+	return usage;
+}
+
+SegregatorAllocator::SegregatorAllocator(std::size_t threshold, Allocator& smaller, Allocator& larger)
+	: mSmallerAllocator(smaller)
+	, mLargerAllocator(larger)
+	, mThreshold(threshold)
+{
+}
+
+void* SegregatorAllocator::Allocate(std::size_t size)
+{
+	if (size <= mThreshold)
+	{
+		return mSmallerAllocator.Allocate(size);
+	}
+	else
+	{
+		return mLargerAllocator.Allocate(size);
+	}
+}
+
+bool SegregatorAllocator::Deallocate(void*& ptr)
+{
+	if (mSmallerAllocator.Owns(ptr))
+	{
+		return mSmallerAllocator.Deallocate(ptr);
+	}
+	else
+	{
+		return mLargerAllocator.Deallocate(ptr);
+	}
+}
+
+bool SegregatorAllocator::Owns(const void* ptr) const
+{
+	return mSmallerAllocator.Owns(ptr) || mLargerAllocator.Owns(ptr);
+}
+
+bool SegregatorAllocator::IsThreadSafe() const
+{
+	return mSmallerAllocator.IsThreadSafe() && mLargerAllocator.IsThreadSafe();
+}
+
+MemoryUsage SegregatorAllocator::GetMemoryUsage() const
+{
+	MemoryUsage usage = mSmallerAllocator.GetMemoryUsage();
+	usage.Add(mLargerAllocator.GetMemoryUsage());
+	return usage;
+}
+
+std::size_t SegregatorAllocator::GetThreshold() const
+{
+	return mThreshold;
+}
+
+LockedAllocator::LockedAllocator(Allocator& allocator)
+	: mAllocator(allocator)
+	, mThreadSafe(allocator.IsThreadSafe())
+	, mMutex()
+{
+}
+
+void* LockedAllocator::Allocate(std::size_t size)
+{
+	if (mThreadSafe)
+	{
+		return mAllocator.Allocate(size);
+	}
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mAllocator.Allocate(size);
+}
+
+bool LockedAllocator::Deallocate(void*& ptr)
+{
+	if (mThreadSafe)
+	{
+		return mAllocator.Deallocate(ptr);
+	}
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mAllocator.Deallocate(ptr);
+}
+
+bool LockedAllocator::Owns(const void* ptr) const
+{
+	const MemorySource* source = mAllocator.GetSource();
+	if (source != nullptr)
+	{
+		return source->Owns(ptr);
+	}
+	if (mThreadSafe)
+	{
+		return mAllocator.Owns(ptr);
+	}
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mAllocator.Owns(ptr);
+}
+
+const MemorySource* LockedAllocator::GetSource() const
+{
+	return mAllocator.GetSource();
+}
+
+bool LockedAllocator::IsThreadSafe() const
+{
+	return true;
+}
+
+MemoryUsage LockedAllocator::GetMemoryUsage() const
+{
+	if (mThreadSafe)
+	{
+		return mAllocator.GetMemoryUsage();
+	}
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mAllocator.GetMemoryUsage();
+}
+
+Allocator& LockedAllocator::GetAllocator() const
+{
+	return mAllocator;
+}
+
+ConcurrentFallbackAllocator::ConcurrentFallbackAllocator(Allocator& primaryAllocator, Allocator& secondaryAllocator)
+	: mPrimary(primaryAllocator)
+	, mSecondary(secondaryAllocator)
+{
+}
+
+void* ConcurrentFallbackAllocator::Allocate(std::size_t size)
+{
+	void* ptr = mPrimary.Allocate(size);
+	if (ptr == nullptr)
+	{
+		ptr = mSecondary.Allocate(size);
+	}
+	return ptr;
+}
+
+bool ConcurrentFallbackAllocator::Deallocate(void*& ptr)
+{
+	if (mPrimary.Owns(ptr))
+	{
+		return mPrimary.Deallocate(ptr);
+	}
+	else
+	{
+		return mSecondary.Deallocate(ptr);
+	}
+}
+
+bool ConcurrentFallbackAllocator::Owns(const void* ptr) const
+{
+	return mPrimary.Owns(ptr) || mSecondary.Owns(ptr);
+}
+
+bool ConcurrentFallbackAllocator::IsThreadSafe() const
+{
+	return true;
+}
+
+MemoryUsage ConcurrentFallbackAllocator::GetMemoryUsage() const
+{
+	MemoryUsage usage = mPrimary.GetMemoryUsage();
+	usage.Add(mSecondary.GetMemoryUsage());
+	return usage;
+}
+
+ConcurrentSegregatorAllocator::ConcurrentSegregatorAllocator(std::size_t threshold, Allocator& smaller, Allocator& larger)
+	: mSmallerAllocator(smaller)
+	, mLargerAllocator(larger)
+	, mThreshold(threshold)
+{
+}
+
+void* ConcurrentSegregatorAllocator::Allocate(std::size_t size)
+{
+	if (size <= mThreshold)
+	{
+		return mSmallerAllocator.Allocate(size);
+	}
+	else
+	{
+		return mLargerAllocator.Allocate(size);
+	}
+}
+
+bool ConcurrentSegregatorAllocator::Deallocate(void*& ptr)
+{
+	if (mSmallerAllocator.Owns(ptr))
+	{
+		return mSmallerAllocator.Deallocate(ptr);
+	}
+	else
+	{
+		return mLargerAllocator.Deallocate(ptr);
+	}
+}
+
+bool ConcurrentSegregatorAllocator::Owns(const void* ptr) const
+{
+	return mSmallerAllocator.Owns(ptr) || mLargerAllocator.Owns(ptr);
+}
+
+bool ConcurrentSegregatorAllocator::IsThreadSafe() const
+{
+	return true;
+}
+
+MemoryUsage ConcurrentSegregatorAllocator::GetMemoryUsage() const
+{
+	MemoryUsage usage = mSmallerAllocator.GetMemoryUsage();
+	usage.Add(mLargerAllocator.GetMemoryUsage());
+	return usage;
+}
+
+std::size_t ConcurrentSegregatorAllocator::GetThreshold() const
+{
+	return mThreshold;
+}
+
+struct ThreadLocalSlots::Entry
+{
+	ThreadLocalSlots* owner;
+	std::uint64_t ownerId;
+	void* slot;
+	Entry* nextInThread;
+	Entry* previousInOwner;
+	Entry* nextInOwner;
+};
+
+// Entries of the current thread, the owners are only changed under the mutex
+struct ThreadLocalSlotsRegistry
+{
+	~ThreadLocalSlotsRegistry()
+	{
+		std::lock_guard<std::mutex> lock(GetMutex());
+		while (entries != nullptr)
+		{
+			ThreadLocalSlots::Entry* entry = entries;
+			entries = entry->nextInThread;
+			if (entry->owner != nullptr)
+			{
+				entry->owner->mRelease(entry->owner->mUserData, entry->slot);
+				Unlink(entry);
+			}
+			delete entry;
+		}
+		lastEntry = nullptr;
+	}
+
+	static std::mutex& GetMutex()
+	{
+		static std::mutex mutex;
+		return mutex;
+	}
+
+	static void Unlink(ThreadLocalSlots::Entry* entry)
+	{
+		if (entry->previousInOwner != nullptr)
+		{
+			entry->previousInOwner->nextInOwner = entry->nextInOwner;
+		}
+		else
+		{
+			entry->owner->mEntries = entry->nextInOwner;
+		}
+		if (entry->nextInOwner != nullptr)
+		{
+			entry->nextInOwner->previousInOwner = entry->previousInOwner;
+		}
+		entry->owner = nullptr;
+	}
+
+	ThreadLocalSlots::Entry* entries = nullptr;
+	ThreadLocalSlots::Entry* lastEntry = nullptr;
+};
+
+namespace
+{
+
+std::atomic<std::uint64_t> gNextThreadLocalSlotsId(1);
+thread_local ThreadLocalSlotsRegistry tThreadLocalSlots;
+
+} // namespace
+
+ThreadLocalSlots::ThreadLocalSlots(CreateFunction create, ReleaseFunction release, void* userData)
+	: mCreate(create)
+	, mRelease(release)
+	, mUserData(userData)
+	, mId(gNextThreadLocalSlotsId.fetch_add(1, std::memory_order_relaxed))
+	, mEntries(nullptr)
+{
+}
+
+ThreadLocalSlots::~ThreadLocalSlots()
+{
+	// The entries stay in the list of their thread until it exits, without owner
+	std::lock_guard<std::mutex> lock(ThreadLocalSlotsRegistry::GetMutex());
+	while (mEntries != nullptr)
+	{
+		Entry* entry = mEntries;
+		mRelease(mUserData, entry->slot);
+		ThreadLocalSlotsRegistry::Unlink(entry);
+	}
+}
+
+void* ThreadLocalSlots::Get()
+{
+	// Ids are never reused, so the entries of a destroyed instance can't match
+	ThreadLocalSlotsRegistry& registry = tThreadLocalSlots;
+	if (registry.lastEntry != nullptr && registry.lastEntry->ownerId == mId)
+	{
+		return registry.lastEntry->slot;
+	}
+	for (Entry* entry = registry.entries; entry != nullptr; entry = entry->nextInThread)
+	{
+		if (entry->ownerId == mId)
+		{
+			registry.lastEntry = entry;
+			return entry->slot;
+		}
+	}
+
+	void* slot = mCreate(mUserData);
+	if (slot == nullptr)
+	{
+		return nullptr;
+	}
+
+	std::lock_guard<std::mutex> lock(ThreadLocalSlotsRegistry::GetMutex());
+
+	// Drop the entries of destroyed instances
+	Entry** link = &registry.entries;
+	while (*link != nullptr)
+	{
+		Entry* entry = *link;
+		if (entry->owner == nullptr)
+		{
+			*link = entry->nextInThread;
+			delete entry;
+		}
+		else
+		{
+			link = &entry->nextInThread;
+		}
+	}
+
+	Entry* entry = new Entry;
+	entry->owner = this;
+	entry->ownerId = mId;
+	entry->slot = slot;
+	entry->nextInThread = registry.entries;
+	entry->previousInOwner = nullptr;
+	entry->nextInOwner = mEntries;
+	if (mEntries != nullptr)
+	{
+		mEntries->previousInOwner = entry;
+	}
+	mEntries = entry;
+	registry.entries = entry;
+	registry.lastEntry = entry;
+	return slot;
+}
+
+void ThreadLocalSlots::ForEach(VisitFunction visit, void* context) const
+{
+	std::lock_guard<std::mutex> lock(ThreadLocalSlotsRegistry::GetMutex());
+	for (const Entry* entry = mEntries; entry != nullptr; entry = entry->nextInOwner)
+	{
+		visit(context, entry->slot);
+	}
+}
+
+ThreadCachingAllocator::ThreadCachingAllocator(Allocator& upstream)
+	: ThreadCachingAllocator(upstream, Settings())
+{
+}
+
+ThreadCachingAllocator::ThreadCachingAllocator(Allocator& upstream, const Settings& settings)
+	: mUpstream(upstream)
+	, mSettings(settings)
+	, mHeaderSize(RoundToAlignment(sizeof(std::size_t), alignof(std::max_align_t)))
+	, mSizeClassCount(0)
+	, mUpstreamMutex()
+	, mCaches(&ThreadCachingAllocator::CreateCache, &ThreadCachingAllocator::ReleaseCache, this) // Destroyed first, flushing the caches of the threads still alive
+{
+	assert(mSettings.batchSize > 0);
+	assert(mSettings.maxCachedBlocks >= mSettings.batchSize);
+
+	// Size classes are powers of two, starting from the header size so a free block can hold a Node
+	while (mSizeClassCount < MaxSizeClassCount && (mSizeClassCount == 0 || GetSizeClass(mSizeClassCount - 1) < mSettings.maxCachedSize))
+	{
+		mSizeClassCount++;
+	}
+}
+
+void* ThreadCachingAllocator::Allocate(std::size_t size)
+{
+	if (size == 0)
+	{
+		return nullptr;
+	}
+
+	const std::size_t classIndex = GetSizeClassIndex(size);
+	if (classIndex >= mSizeClassCount)
+	{
+		std::lock_guard<std::mutex> lock(mUpstreamMutex);
+		return AllocateFromUpstream(size, classIndex);
+	}
+
+	ThreadCache* cache = static_cast<ThreadCache*>(mCaches.Get());
+	if (cache == nullptr)
+	{
+		return nullptr;
+	}
+	Bin& bin = cache->bins[classIndex];
+	if (bin.count == 0 && !Refill(bin, classIndex))
+	{
+		return nullptr;
+	}
+	Node* node = bin.rootNode;
+	bin.rootNode = node->next;
+	bin.count--;
+	return (void*)node;
+}
+
+bool ThreadCachingAllocator::Deallocate(void*& ptr)
+{
+	std::size_t classIndex = 0;
+	if (ptr == nullptr || !ReadSizeClassIndex(ptr, classIndex))
+	{
+		return false;
+	}
+
+	ThreadCache* cache = (classIndex < mSizeClassCount) ? static_cast<ThreadCache*>(mCaches.Get()) : nullptr;
+	if (cache == nullptr)
+	{
+		std::lock_guard<std::mutex> lock(mUpstreamMutex);
+		if (!DeallocateToUpstream(ptr))
+		{
+			return false;
+		}
+	}
+	else
+	{
+		Bin& bin = cache->bins[classIndex];
+		Node* node = (Node*)ptr;
+		node->next = bin.rootNode;
+		bin.rootNode = node;
+		bin.count++;
+		if (bin.count > mSettings.maxCachedBlocks)
+		{
+			FlushBin(bin, mSettings.batchSize);
+		}
+	}
+	ptr = nullptr;
+	return true;
+}
+
+bool ThreadCachingAllocator::Owns(const void* ptr) const
+{
+	if (ptr == nullptr)
+	{
+		return false;
+	}
+	const void* rawPtr = reinterpret_cast<const void*>(reinterpret_cast<std::uintptr_t>(ptr) - mHeaderSize);
+	const MemorySource* source = mUpstream.GetSource();
+	if (source != nullptr)
+	{
+		return source->Owns(rawPtr);
+	}
+	std::lock_guard<std::mutex> lock(mUpstreamMutex);
+	return mUpstream.Owns(rawPtr);
+}
+
+const MemorySource* ThreadCachingAllocator::GetSource() const
+{
+	return mUpstream.GetSource();
+}
+
+bool ThreadCachingAllocator::IsThreadSafe() const
+{
+	return true;
+}
+
+MemoryUsage ThreadCachingAllocator::GetMemoryUsage() const
+{
+	// The blocks in the caches are used for the upstream allocator
+	std::lock_guard<std::mutex> lock(mUpstreamMutex);
+	return mUpstream.GetMemoryUsage();
+}
+
+void ThreadCachingAllocator::Flush()
+{
+	ThreadCache* cache = static_cast<ThreadCache*>(mCaches.Get());
+	if (cache != nullptr)
+	{
+		for (std::size_t i = 0; i < mSizeClassCount; ++i)
+		{
+			FlushBin(cache->bins[i], cache->bins[i].count);
+		}
+	}
+}
+
+const ThreadCachingAllocator::Settings& ThreadCachingAllocator::GetSettings() const
+{
+	return mSettings;
+}
+
+std::size_t ThreadCachingAllocator::GetSizeClassCount() const
+{
+	return mSizeClassCount;
+}
+
+std::size_t ThreadCachingAllocator::GetSizeClass(std::size_t index) const
+{
+	return mHeaderSize << index;
+}
+
+std::size_t ThreadCachingAllocator::GetHeaderSize() const
+{
+	return mHeaderSize;
+}
+
+void* ThreadCachingAllocator::CreateCache(void*)
+{
+	return new ThreadCache();
+}
+
+void ThreadCachingAllocator::ReleaseCache(void* allocator, void* cache)
+{
+	ThreadCachingAllocator* self = static_cast<ThreadCachingAllocator*>(allocator);
+	ThreadCache* threadCache = static_cast<ThreadCache*>(cache);
+	for (std::size_t i = 0; i < self->mSizeClassCount; ++i)
+	{
+		self->FlushBin(threadCache->bins[i], threadCache->bins[i].count);
+	}
+	delete threadCache;
+}
+
+std::size_t ThreadCachingAllocator::GetSizeClassIndex(std::size_t size) const
+{
+	std::size_t index = 0;
+	while (index < mSizeClassCount && GetSizeClass(index) < size)
+	{
+		index++;
+	}
+	return index;
+}
+
+bool ThreadCachingAllocator::ReadSizeClassIndex(const void* ptr, std::size_t& classIndex) const
+{
+	const void* rawPtr = reinterpret_cast<const void*>(reinterpret_cast<std::uintptr_t>(ptr) - mHeaderSize);
+	const MemorySource* source = mUpstream.GetSource();
+	if (source != nullptr && !source->Owns(rawPtr))
+	{
+		return false;
+	}
+	classIndex = *static_cast<const std::size_t*>(rawPtr);
+	return classIndex <= mSizeClassCount;
+}
+
+void* ThreadCachingAllocator::AllocateFromUpstream(std::size_t size, std::size_t classIndex)
+{
+	void* rawPtr = mUpstream.Allocate(mHeaderSize + size);
+	if (rawPtr == nullptr)
+	{
+		return nullptr;
+	}
+	*static_cast<std::size_t*>(rawPtr) = classIndex;
+	return reinterpret_cast<void*>(reinterpret_cast<std::uintptr_t>(rawPtr) + mHeaderSize);
+}
+
+bool ThreadCachingAllocator::DeallocateToUpstream(void* ptr)
+{
+	void* rawPtr = reinterpret_cast<void*>(reinterpret_cast<std::uintptr_t>(ptr) - mHeaderSize);
+	return mUpstream.Deallocate(rawPtr);
+}
+
+bool ThreadCachingAllocator::Refill(Bin& bin, std::size_t classIndex)
+{
+	const std::size_t size = GetSizeClass(classIndex);
+	std::lock_guard<std::mutex> lock(mUpstreamMutex);
+	for (std::size_t i = 0; i < mSettings.batchSize; ++i)
+	{
+		Node* node = (Node*)AllocateFromUpstream(size, classIndex);
+		if (node == nullptr)
+		{
+			break;
+		}
+		node->next = bin.rootNode;
+		bin.rootNode = node;
+		bin.count++;
+	}
+	return bin.count > 0;
+}
+
+void ThreadCachingAllocator::FlushBin(Bin& bin, std::size_t count)
+{
+	std::lock_guard<std::mutex> lock(mUpstreamMutex);
+	for (std::size_t i = 0; i < count && bin.rootNode != nullptr; ++i)
+	{
+		Node* node = bin.rootNode;
+		bin.rootNode = node->next;
+		bin.count--;
+		DeallocateToUpstream((void*)node);
+	}
+}
+
+#if defined(DYMA_RSEQ)
+
+namespace
+{
+
+// Critical sections of the restartable sequences, see linux/rseq.h
+// The rseq area of the thread is at fs:__rseq_offset, cpu_id is at +4 and rseq_cs at +8
+// If the thread is preempted, migrated or signaled in between 3 and 4, the kernel restarts it from 5, which starts over
+// A CPU without a cache is handled like an empty or full cache, at 7
+#define DYMA_RSEQ_CRITICAL_SECTION \
+	".pushsection __rseq_cs, \"aw\"\n\t" \
+	".balign 32\n\t" \
+	"6:\n\t" \
+	".long 0x0, 0x0\n\t" \
+	".quad 3f, (4f - 3f), 5f\n\t" \
+	".popsection\n\t" \
+	".pushsection __rseq_failure, \"ax\"\n\t" \
+	".byte 0x0f, 0xb9, 0x3d\n\t" \
+	".long 0x53053053\n\t" \
+	"5:\n\t" \
+	"jmp 2f\n\t" \
+	".popsection\n\t" \
+	"2:\n\t" \
+	"leaq 6b(%%rip), %%rax\n\t" \
+	"movq %%rax, %%fs:8(%[rseqOffset])\n\t" \
+	"3:\n\t" \
+	"movl %%fs:4(%[rseqOffset]), %%eax\n\t" \
+	"cmpq %[cpuCount], %%rax\n\t" \
+	"jae 7f\n\t" \
+	"imulq %[cpuStride], %%rax\n\t" \
+	"addq %[bins], %%rax\n\t" \
+	"movq (%%rax), %%rcx\n\t"
+
+void* RseqPop(std::uintptr_t* bins, std::size_t cpuStride, std::size_t cpuCount)
+{
+	void* ptr;
+	__asm__ __volatile__(
+		DYMA_RSEQ_CRITICAL_SECTION
+		"testq %%rcx, %%rcx\n\t"
+		"jz 7f\n\t"
+		"movq (%%rax, %%rcx, 8), %[ptr]\n\t"
+		"decq %%rcx\n\t"
+		"movq %%rcx, (%%rax)\n\t"
+		"4:\n\t"
+		"jmp 8f\n\t"
+		"7:\n\t"
+		"xorq %[ptr], %[ptr]\n\t"
+		"8:\n\t"
+		: [ptr] "=&r"(ptr)
+		: [rseqOffset] "r"(__rseq_offset), [cpuStride] "r"(cpuStride), [cpuCount] "r"(cpuCount), [bins] "r"(bins)
+		: "rax", "rcx", "memory", "cc");
+	return ptr;
+}
+
+bool RseqPush(std::uintptr_t* bins, std::size_t cpuStride, std::size_t cpuCount, std::size_t capacity, void* ptr)
+{
+	std::uintptr_t pushed;
+	__asm__ __volatile__(
+		DYMA_RSEQ_CRITICAL_SECTION
+		"cmpq %[capacity], %%rcx\n\t"
+		"jae 7f\n\t"
+		"movq %[ptr], 8(%%rax, %%rcx, 8)\n\t"
+		"incq %%rcx\n\t"
+		"movq %%rcx, (%%rax)\n\t"
+		"4:\n\t"
+		"movq $1, %[pushed]\n\t"
+		"jmp 8f\n\t"
+		"7:\n\t"
+		"xorq %[pushed], %[pushed]\n\t"
+		"8:\n\t"
+		: [pushed] "=&r"(pushed)
+		: [rseqOffset] "r"(__rseq_offset), [cpuStride] "r"(cpuStride), [cpuCount] "r"(cpuCount), [bins] "r"(bins), [capacity] "r"(capacity), [ptr] "r"(ptr)
+		: "rax", "rcx", "memory", "cc");
+	return pushed != 0;
+}
+
+#undef DYMA_RSEQ_CRITICAL_SECTION
+
+} // namespace
+
+#endif // DYMA_RSEQ
+
+CpuCachingAllocator::CpuCachingAllocator(Allocator& upstream)
+	: CpuCachingAllocator(upstream, Settings())
+{
+}
+
+CpuCachingAllocator::CpuCachingAllocator(Allocator& upstream, const Settings& settings)
+	: ThreadCachingAllocator(upstream, settings)
+	, mCpuBins(nullptr)
+	, mCpuCount(0)
+	, mBinStride((1 + settings.maxCachedBlocks) * sizeof(std::uintptr_t))
+	, mCpuStride(0)
+{
+	if (IsRseqAvailable())
+	{
+		// CPUs don't share cache lines
+		mCpuCount = GetCpuCount();
+		mCpuStride = RoundToAlignment(mSizeClassCount * mBinStride, 64);
+		mCpuBins = static_cast<std::uintptr_t*>(AlignedMalloc(mCpuCount * mCpuStride, 64));
+		if (mCpuBins != nullptr)
+		{
+			std::memset(mCpuBins, 0, mCpuCount * mCpuStride);
+		}
+	}
+}
+
+CpuCachingAllocator::~CpuCachingAllocator()
+{
+	if (mCpuBins != nullptr)
+	{
+		std::lock_guard<std::mutex> lock(mUpstreamMutex);
+		for (std::size_t cpu = 0; cpu < mCpuCount; ++cpu)
+		{
+			for (std::size_t classIndex = 0; classIndex < mSizeClassCount; ++classIndex)
+			{
+				std::uintptr_t* bin = reinterpret_cast<std::uintptr_t*>(reinterpret_cast<std::uintptr_t>(mCpuBins) + cpu * mCpuStride + classIndex * mBinStride);
+				for (std::uintptr_t i = 1; i <= bin[0]; ++i)
+				{
+					DeallocateToUpstream(reinterpret_cast<void*>(bin[i]));
+				}
+			}
+		}
+		AlignedFree(mCpuBins);
+	}
+}
+
+void* CpuCachingAllocator::Allocate(std::size_t size)
+{
+	const std::size_t classIndex = GetSizeClassIndex(size);
+	if (!UsesCpuCaches() || size == 0 || classIndex >= mSizeClassCount)
+	{
+		return ThreadCachingAllocator::Allocate(size);
+	}
+
+	void* ptr = PopFromCpu(classIndex);
+	if (ptr == nullptr && GetCurrentCpu() >= mCpuCount)
+	{
+		return ThreadCachingAllocator::Allocate(size);
+	}
+	if (ptr == nullptr)
+	{
+		// Refill the cache of the CPU with a batch, and keep the first block
+		std::lock_guard<std::mutex> lock(mUpstreamMutex);
+		const std::size_t classSize = GetSizeClass(classIndex);
+		ptr = AllocateFromUpstream(classSize, classIndex);
+		for (std::size_t i = 1; ptr != nullptr && i < mSettings.batchSize; ++i)
+		{
+			void* block = AllocateFromUpstream(classSize, classIndex);
+			if (block == nullptr)
+			{
+				break;
+			}
+			if (!PushToCpu(classIndex, block))
+			{
+				DeallocateToUpstream(block);
+				break;
+			}
+		}
+	}
+	return ptr;
+}
+
+bool CpuCachingAllocator::Deallocate(void*& ptr)
+{
+	if (!UsesCpuCaches() || ptr == nullptr)
+	{
+		return ThreadCachingAllocator::Deallocate(ptr);
+	}
+
+	std::size_t classIndex = 0;
+	if (!ReadSizeClassIndex(ptr, classIndex))
+	{
+		return false;
+	}
+	if (classIndex >= mSizeClassCount)
+	{
+		return ThreadCachingAllocator::Deallocate(ptr);
+	}
+
+	if (!PushToCpu(classIndex, ptr))
+	{
+		if (GetCurrentCpu() >= mCpuCount)
+		{
+			return ThreadCachingAllocator::Deallocate(ptr);
+		}
+
+		// The cache of the CPU is full, flush a batch
+		std::lock_guard<std::mutex> lock(mUpstreamMutex);
+		for (std::size_t i = 0; i < mSettings.batchSize; ++i)
+		{
+			void* block = PopFromCpu(classIndex);
+			if (block == nullptr)
+			{
+				break;
+			}
+			DeallocateToUpstream(block);
+		}
+		DeallocateToUpstream(ptr);
+	}
+	ptr = nullptr;
+	return true;
+}
+
+bool CpuCachingAllocator::UsesCpuCaches() const
+{
+	return mCpuBins != nullptr;
+}
+
+bool CpuCachingAllocator::IsRseqAvailable()
+{
+#if defined(DYMA_RSEQ)
+	// glibc sets the size to 0 when the registration failed or has been disabled
+	return &__rseq_size != nullptr && __rseq_size > 0;
+#else
+	return false;
+#endif
+}
+
+void* CpuCachingAllocator::PopFromCpu(std::size_t classIndex)
+{
+#if defined(DYMA_RSEQ)
+	std::uintptr_t* bins = reinterpret_cast<std::uintptr_t*>(reinterpret_cast<std::uintptr_t>(mCpuBins) + classIndex * mBinStride);
+	return RseqPop(bins, mCpuStride, mCpuCount);
+#else
+	return nullptr;
+#endif
+}
+
+bool CpuCachingAllocator::PushToCpu(std::size_t classIndex, void* ptr)
+{
+#if defined(DYMA_RSEQ)
+	std::uintptr_t* bins = reinterpret_cast<std::uintptr_t*>(reinterpret_cast<std::uintptr_t>(mCpuBins) + classIndex * mBinStride);
+	return RseqPush(bins, mCpuStride, mCpuCount, mSettings.maxCachedBlocks, ptr);
+#else
+	return false;
+#endif
+}
+
+RemoteFreeAllocator::RemoteFreeAllocator(Allocator& allocator)
+	: mAllocator(allocator)
+	, mOwnerThread(std::this_thread::get_id())
+	, mRemoteFrees(nullptr)
+{
+}
+
+RemoteFreeAllocator::~RemoteFreeAllocator()
+{
+	DrainRemoteFrees();
+}
+
+void* RemoteFreeAllocator::Allocate(std::size_t size)
+{
+	assert(IsOwnerThread());
+	if (mRemoteFrees.load(std::memory_order_relaxed) != nullptr)
+	{
+		DrainRemoteFrees();
+	}
+	return mAllocator.Allocate(size);
+}
+
+bool RemoteFreeAllocator::Deallocate(void*& ptr)
+{
+	if (ptr == nullptr || !mAllocator.Owns(ptr))
+	{
+		return false;
+	}
+	if (IsOwnerThread())
+	{
+		return mAllocator.Deallocate(ptr);
+	}
+
+	// Only the owner pops, all at once, so pushes can't suffer from the ABA problem
+	Node* node = (Node*)ptr;
+	Node* head = mRemoteFrees.load(std::memory_order_relaxed);
+	do
+	{
+		node->next = head;
+	} while (!mRemoteFrees.compare_exchange_weak(head, node, std::memory_order_release, std::memory_order_relaxed));
+	ptr = nullptr;
+	return true;
+}
+
+bool RemoteFreeAllocator::Owns(const void* ptr) const
+{
+	return mAllocator.Owns(ptr);
+}
+
+const MemorySource* RemoteFreeAllocator::GetSource() const
+{
+	return mAllocator.GetSource();
+}
+
+MemoryUsage RemoteFreeAllocator::GetMemoryUsage() const
+{
+	// The blocks freed by other threads are used until they are drained
+	return mAllocator.GetMemoryUsage();
+}
+
+std::size_t RemoteFreeAllocator::DrainRemoteFrees()
+{
+	std::size_t count = 0;
+	Node* node = mRemoteFrees.exchange(nullptr, std::memory_order_acquire);
+	while (node != nullptr)
+	{
+		Node* next = node->next;
+		void* ptr = (void*)node;
+		mAllocator.Deallocate(ptr);
+		node = next;
+		count++;
+	}
+	return count;
+}
+
+void RemoteFreeAllocator::SetOwnerThread()
+{
+	mOwnerThread.store(std::this_thread::get_id(), std::memory_order_relaxed);
+}
+
+bool RemoteFreeAllocator::IsOwnerThread() const
+{
+	return mOwnerThread.load(std::memory_order_relaxed) == std::this_thread::get_id();
+}
+
+EpochAllocator::EpochAllocator(Allocator& allocator, std::size_t batchSize /*= 64*/)
+	: mAllocator(allocator)
+	, mBatchSize(batchSize)
+	, mEpoch(0)
+	, mAllocatorMutex()
+	, mOrphans()
+	, mRecords(&EpochAllocator::CreateRecord, &EpochAllocator::ReleaseRecord, this)
+{
+	assert(mBatchSize > 0);
+	mOrphans.rootNode = nullptr;
+	mOrphans.epoch = 0;
+}
+
+EpochAllocator::~EpochAllocator()
+{
+	// Nobody can read the blocks anymore
+	mRecords.ForEach([](void* allocator, void* record)
+	{
+		EpochAllocator* self = static_cast<EpochAllocator*>(allocator);
+		ThreadRecord* threadRecord = static_cast<ThreadRecord*>(record);
+		for (std::size_t i = 0; i < BucketCount; ++i)
+		{
+			self->FreeBucket(threadRecord->buckets[i]);
+		}
+	}, this);
+	FreeBucket(mOrphans);
+}
+
+void* EpochAllocator::Allocate(std::size_t size)
+{
+	std::lock_guard<std::mutex> lock(mAllocatorMutex);
+	return mAllocator.Allocate(size);
+}
+
+bool EpochAllocator::Deallocate(void*& ptr)
+{
+	if (ptr == nullptr || !mAllocator.Owns(ptr))
+	{
+		return false;
+	}
+
+	ThreadRecord* record = static_cast<ThreadRecord*>(mRecords.Get());
+	const std::uint64_t epoch = mEpoch.load(std::memory_order_acquire);
+	FreeReclaimableBuckets(*record, epoch);
+
+	Bucket& bucket = record->buckets[epoch % BucketCount];
+	bucket.epoch = epoch;
+	Node* node = (Node*)ptr;
+	node->next = bucket.rootNode;
+	bucket.rootNode = node;
+	ptr = nullptr;
+
+	record->retiredCount++;
+	if (record->retiredCount >= mBatchSize)
+	{
+		record->retiredCount = 0;
+		TryAdvanceEpoch();
+	}
+	return true;
+}
+
+bool EpochAllocator::Owns(const void* ptr) const
+{
+	return mAllocator.Owns(ptr);
+}
+
+const MemorySource* EpochAllocator::GetSource() const
+{
+	return mAllocator.GetSource();
+}
+
+bool EpochAllocator::IsThreadSafe() const
+{
+	return true;
+}
+
+MemoryUsage EpochAllocator::GetMemoryUsage() const
+{
+	// The retired blocks are used until they are reclaimed
+	std::lock_guard<std::mutex> lock(mAllocatorMutex);
+	return mAllocator.GetMemoryUsage();
+}
+
+void EpochAllocator::Enter()
+{
+	ThreadRecord* record = static_cast<ThreadRecord*>(mRecords.Get());
+	if (record->nesting++ == 0)
+	{
+		// The announced epoch has to be visible before reading any shared block
+		record->state.store((mEpoch.load(std::memory_order_relaxed) << 1) | 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+	}
+}
+
+void EpochAllocator::Exit()
+{
+	ThreadRecord* record = static_cast<ThreadRecord*>(mRecords.Get());
+	assert(record->nesting > 0);
+	if (--record->nesting == 0)
+	{
+		record->state.store(record->state.load(std::memory_order_relaxed) & ~std::uint64_t(1), std::memory_order_release);
+	}
+}
+
+bool EpochAllocator::TryAdvanceEpoch()
+{
+	// Every thread in a critical section should have seen the current epoch
+	std::uint64_t epoch = mEpoch.load(std::memory_order_acquire);
+	struct Context
+	{
+		std::uint64_t epoch;
+		bool canAdvance;
+	} context = { epoch, true };
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	mRecords.ForEach([](void* contextPtr, void* record)
+	{
+		Context* context = static_cast<Context*>(contextPtr);
+		const std::uint64_t state = static_cast<ThreadRecord*>(record)->state.load(std::memory_order_acquire);
+		if ((state & 1) != 0 && (state >> 1) != context->epoch)
+		{
+			context->canAdvance = false;
+		}
+	}, &context);
+
+	const bool advanced = context.canAdvance && mEpoch.compare_exchange_strong(epoch, epoch + 1, std::memory_order_acq_rel);
+	if (advanced)
+	{
+		epoch++;
+	}
+
+	ThreadRecord* record = static_cast<ThreadRecord*>(mRecords.Get());
+	FreeReclaimableBuckets(*record, epoch);
+	std::lock_guard<std::mutex> lock(mAllocatorMutex);
+	if (mOrphans.rootNode != nullptr && mOrphans.epoch + 2 <= epoch)
+	{
+		Node* node = mOrphans.rootNode;
+		mOrphans.rootNode = nullptr;
+		while (node != nullptr)
+		{
+			void* ptr = (void*)node;
+			node = node->next;
+			mAllocator.Deallocate(ptr);
+		}
+	}
+	return advanced;
+}
+
+std::uint64_t EpochAllocator::GetEpoch() const
+{
+	return mEpoch.load(std::memory_order_relaxed);
+}
+
+std::size_t EpochAllocator::GetBatchSize() const
+{
+	return mBatchSize;
+}
+
+void* EpochAllocator::CreateRecord(void*)
+{
+	ThreadRecord* record = new ThreadRecord();
+	record->state.store(0, std::memory_order_relaxed);
+	record->nesting = 0;
+	record->retiredCount = 0;
+	for (std::size_t i = 0; i < BucketCount; ++i)
+	{
+		record->buckets[i].rootNode = nullptr;
+		record->buckets[i].epoch = 0;
+	}
+	return record;
+}
+
+void EpochAllocator::ReleaseRecord(void* allocator, void* record)
+{
+	// The blocks of an exiting thread might still be read by other threads, they are kept until safe
+	EpochAllocator* self = static_cast<EpochAllocator*>(allocator);
+	ThreadRecord* threadRecord = static_cast<ThreadRecord*>(record);
+	std::lock_guard<std::mutex> lock(self->mAllocatorMutex);
+	for (std::size_t i = 0; i < BucketCount; ++i)
+	{
+		Bucket& bucket = threadRecord->buckets[i];
+		while (bucket.rootNode != nullptr)
+		{
+			Node* node = bucket.rootNode;
+			bucket.rootNode = node->next;
+			node->next = self->mOrphans.rootNode;
+			self->mOrphans.rootNode = node;
+		}
+		if (bucket.epoch > self->mOrphans.epoch)
+		{
+			self->mOrphans.epoch = bucket.epoch;
+		}
+	}
+	delete threadRecord;
+}
+
+void EpochAllocator::FreeBucket(Bucket& bucket)
+{
+	std::lock_guard<std::mutex> lock(mAllocatorMutex);
+	while (bucket.rootNode != nullptr)
+	{
+		Node* node = bucket.rootNode;
+		bucket.rootNode = node->next;
+		void* ptr = (void*)node;
+		mAllocator.Deallocate(ptr);
+	}
+}
+
+void EpochAllocator::FreeReclaimableBuckets(ThreadRecord& record, std::uint64_t epoch)
+{
+	for (std::size_t i = 0; i < BucketCount; ++i)
+	{
+		Bucket& bucket = record.buckets[i];
+		if (bucket.rootNode != nullptr && bucket.epoch + 2 <= epoch)
+		{
+			FreeBucket(bucket);
+		}
+	}
+}
+
+EpochGuard::EpochGuard(EpochAllocator& allocator)
+	: mAllocator(allocator)
+{
+	mAllocator.Enter();
+}
+
+EpochGuard::~EpochGuard()
+{
+	mAllocator.Exit();
+}
+
+namespace
+{
+
+constexpr std::size_t MaxCapturedFrameCount = 64;
+
+// Return addresses of the calling function and its callers, without the skipped frames
+#if defined(_MSC_VER)
+__declspec(noinline)
+#elif defined(__GNUC__) || defined(__clang__)
+__attribute__((noinline))
+#endif
+std::size_t CaptureStack(void** frames, std::size_t maxFrameCount, std::size_t skippedFrameCount)
+{
+#if defined(_WIN32)
+	return static_cast<std::size_t>(CaptureStackBackTrace(static_cast<DWORD>(skippedFrameCount + 1), static_cast<DWORD>(maxFrameCount), frames, nullptr));
+#elif defined(DYMA_BACKTRACE)
+	void* allFrames[MaxCapturedFrameCount + 8];
+	const std::size_t totalSkippedCount = skippedFrameCount + 1;
+	assert(maxFrameCount <= MaxCapturedFrameCount && totalSkippedCount <= 8);
+	std::size_t count = static_cast<std::size_t>(backtrace(allFrames, static_cast<int>(maxFrameCount + totalSkippedCount)));
+	count = (count > totalSkippedCount) ? count - totalSkippedCount : 0;
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		frames[i] = allFrames[totalSkippedCount + i];
+	}
+	return count;
+#else
+	return 0;
+#endif
+}
+
+// FNV-1a of the frames, never 0 so it can be a PointerMap key
+std::uint64_t HashFrames(void* const* frames, std::size_t frameCount)
+{
+	std::uint64_t hash = 0xCBF29CE484222325ull;
+	for (std::size_t i = 0; i < frameCount; ++i)
+	{
+		hash = (hash ^ static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(frames[i]))) * 0x100000001B3ull;
+	}
+	return (hash != 0) ? hash : 1;
+}
+
+} // namespace
+
+DebugAllocator::DebugAllocator(Allocator& allocator)
+	: DebugAllocator(allocator, Settings())
+{
+}
+
+DebugAllocator::DebugAllocator(Allocator& allocator, const Settings& settings)
+	: mAllocator(allocator)
+	, mSettings(settings)
+	, mHeaderSize(settings.blockHeaders ? RoundToAlignment(sizeof(BlockHeader), alignof(std::max_align_t)) : 0)
+	, mAccountedSize(0)
+	, mPeakSize(0)
+	, mCountersMutex()
+	, mCounters(nullptr)
+	, mExitedCounters()
+	, mBlocksMutex()
+	, mBlocksMallocator()
+	, mBlocksAllocator((settings.blocksAllocator != nullptr) ? *settings.blocksAllocator : mBlocksMallocator)
+	, mBlocks(mBlocksAllocator)
+	, mCallSites(mBlocksAllocator)
+	, mThreadCounters(&DebugAllocator::CreateCounters, &DebugAllocator::ReleaseCounters, this) // Destroyed first, summing the counters of the threads still alive
+{
+	assert(mSettings.callSiteDepth <= MaxCallSiteDepth);
+}
+
+DebugAllocator::~DebugAllocator()
+{
+	if (mSettings.reportLeaks)
+	{
+		std::FILE* file = GetLeakReportFile();
+		WriteLeakReport((file != nullptr) ? file : stderr);
+	}
+	Allocator& blocksAllocator = mBlocksAllocator;
+	mCallSites.ForEach([&blocksAllocator](const void*, CallSite* callSite)
+	{
+		void* ptr = callSite;
+		blocksAllocator.Deallocate(ptr);
+	});
+}
+
+void* DebugAllocator::Allocate(std::size_t size)
+{
+	if (size == 0)
+	{
+		return nullptr;
+	}
+
+	ThreadCounters* counters = static_cast<ThreadCounters*>(mThreadCounters.Get());
+	void* rawPtr = mAllocator.Allocate(mHeaderSize + size);
+	if (rawPtr == nullptr)
+	{
+		CountFailure(counters);
+		return nullptr;
+	}
+	if (mSettings.blockHeaders)
+	{
+		BlockHeader* header = static_cast<BlockHeader*>(rawPtr);
+		header->magic = AllocatedMagic;
+		header->size = size;
+	}
+	void* ptr = reinterpret_cast<void*>(reinterpret_cast<std::uintptr_t>(rawPtr) + mHeaderSize);
+
+	if (mSettings.trackBlocks)
+	{
+		TrackedBlock block = { size, nullptr };
+		bool tracked = false;
+		if (mSettings.callSiteDepth > 0)
+		{
+			void* frames[MaxCallSiteDepth];
+			const std::size_t frameCount = CaptureStack(frames, mSettings.callSiteDepth, 1);
+			std::lock_guard<std::mutex> lock(mBlocksMutex);
+			block.callSite = FindCallSite(frames, frameCount);
+			tracked = TrackBlock(ptr, block);
+		}
+		else
+		{
+			std::lock_guard<std::mutex> lock(mBlocksMutex);
+			tracked = TrackBlock(ptr, block);
+		}
+
+		// Without a header, a block missing from the table couldn't be deallocated
+		if (!tracked && !mSettings.blockHeaders)
+		{
+			mAllocator.Deallocate(rawPtr);
+			CountFailure(counters);
+			return nullptr;
+		}
+	}
+
+	if (counters != nullptr)
+	{
+		counters->allocationCount.store(counters->allocationCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		if (KnowsSizes())
+		{
+			counters->allocatedSize.store(counters->allocatedSize.load(std::memory_order_relaxed) + size, std::memory_order_relaxed);
+			AccountUsedSize(*counters, static_cast<std::int64_t>(size));
+		}
+	}
+	return ptr;
+}
+
+bool DebugAllocator::Deallocate(void*& ptr)
+{
+	if (ptr == nullptr)
+	{
+		return false;
+	}
+
+	ThreadCounters* counters = static_cast<ThreadCounters*>(mThreadCounters.Get());
+	void* rawPtr = reinterpret_cast<void*>(reinterpret_cast<std::uintptr_t>(ptr) - mHeaderSize);
+	BlockHeader* header = nullptr;
+	TrackedBlock block = { 0, nullptr };
+	if (mSettings.blockHeaders)
+	{
+		// Foreign blocks are rejected before reading out of their memory
+		header = (!mSettings.checkOwnership || mAllocator.Owns(rawPtr)) ? static_cast<BlockHeader*>(rawPtr) : nullptr;
+		if (header == nullptr || header->magic != AllocatedMagic)
+		{
+			// Not allocated by this DebugAllocator, or already deallocated
+			CountFailure(counters);
+			return false;
+		}
+		block.size = header->size;
+		header->magic = 0;
+	}
+
+	// Removed before the wrapped allocator can give the same address to another thread
+	bool tracked = false;
+	if (mSettings.trackBlocks)
+	{
+		std::lock_guard<std::mutex> lock(mBlocksMutex);
+		tracked = UntrackBlock(ptr, &block);
+	}
+	if (mSettings.trackBlocks && header == nullptr && !tracked)
+	{
+		// Not allocated by this DebugAllocator, or already deallocated
+		CountFailure(counters);
+		return false;
+	}
+	const std::size_t size = block.size;
+
+	if (!mAllocator.Deallocate(rawPtr))
+	{
+		if (header != nullptr)
+		{
+			header->magic = AllocatedMagic;
+		}
+		if (tracked)
+		{
+			std::lock_guard<std::mutex> lock(mBlocksMutex);
+			TrackBlock(ptr, block);
+		}
+		CountFailure(counters);
+		return false;
+	}
+	ptr = nullptr;
+
+	if (counters != nullptr)
+	{
+		counters->deallocationCount.store(counters->deallocationCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		if (KnowsSizes())
+		{
+			counters->deallocatedSize.store(counters->deallocatedSize.load(std::memory_order_relaxed) + size, std::memory_order_relaxed);
+			AccountUsedSize(*counters, -static_cast<std::int64_t>(size));
+		}
+	}
+	return true;
+}
+
+bool DebugAllocator::Owns(const void* ptr) const
+{
+	return ptr != nullptr && mAllocator.Owns(reinterpret_cast<const void*>(reinterpret_cast<std::uintptr_t>(ptr) - mHeaderSize));
+}
+
+const MemorySource* DebugAllocator::GetSource() const
+{
+	return mAllocator.GetSource();
+}
+
+bool DebugAllocator::IsThreadSafe() const
+{
+	return mAllocator.IsThreadSafe();
+}
+
+MemoryUsage DebugAllocator::GetMemoryUsage() const
+{
+	// The headers of the live blocks are wasted
+	MemoryUsage usage = mAllocator.GetMemoryUsage();
+	const std::size_t allocationCount = GetAllocationCount();
+	const std::size_t deallocationCount = GetDeallocationCount();
+	const std::size_t headersSize = (allocationCount > deallocationCount) ? (allocationCount - deallocationCount) * mHeaderSize : 0;
+	usage.wastedSize += headersSize;
+	usage.wastedSize = (usage.wastedSize < usage.usedSize) ? usage.wastedSize : usage.usedSize;
+	return usage;
+}
+
+std::size_t DebugAllocator::GetAllocationCount() const
+{
+	std::lock_guard<std::mutex> lock(mCountersMutex);
+	std::uint64_t count = mExitedCounters.allocationCount.load(std::memory_order_relaxed);
+	for (const ThreadCounters* counters = mCounters; counters != nullptr; counters = counters->next)
+	{
+		count += counters->allocationCount.load(std::memory_order_relaxed);
+	}
+	return static_cast<std::size_t>(count);
+}
+
+std::size_t DebugAllocator::GetDeallocationCount() const
+{
+	std::lock_guard<std::mutex> lock(mCountersMutex);
+	std::uint64_t count = mExitedCounters.deallocationCount.load(std::memory_order_relaxed);
+	for (const ThreadCounters* counters = mCounters; counters != nullptr; counters = counters->next)
+	{
+		count += counters->deallocationCount.load(std::memory_order_relaxed);
+	}
+	return static_cast<std::size_t>(count);
+}
+
+std::size_t DebugAllocator::GetFailureCount() const
+{
+	std::lock_guard<std::mutex> lock(mCountersMutex);
+	std::uint64_t count = mExitedCounters.failureCount.load(std::memory_order_relaxed);
+	for (const ThreadCounters* counters = mCounters; counters != nullptr; counters = counters->next)
+	{
+		count += counters->failureCount.load(std::memory_order_relaxed);
+	}
+	return static_cast<std::size_t>(count);
+}
+
+std::size_t DebugAllocator::GetUsedSize() const
+{
+	// A block can be deallocated by another thread than the one that allocated it, only the sum makes sense
+	std::lock_guard<std::mutex> lock(mCountersMutex);
+	std::uint64_t allocatedSize = mExitedCounters.allocatedSize.load(std::memory_order_relaxed);
+	std::uint64_t deallocatedSize = mExitedCounters.deallocatedSize.load(std::memory_order_relaxed);
+	for (const ThreadCounters* counters = mCounters; counters != nullptr; counters = counters->next)
+	{
+		allocatedSize += counters->allocatedSize.load(std::memory_order_relaxed);
+		deallocatedSize += counters->deallocatedSize.load(std::memory_order_relaxed);
+	}
+	return (allocatedSize > deallocatedSize) ? static_cast<std::size_t>(allocatedSize - deallocatedSize) : 0;
+}
+
+std::size_t DebugAllocator::GetPeakSize() const
+{
+	// The peak misses at most peakGranularity bytes per thread, but is never below the current size
+	const std::size_t usedSize = GetUsedSize();
+	const std::size_t peakSize = static_cast<std::size_t>(mPeakSize.load(std::memory_order_relaxed));
+	return (usedSize > peakSize) ? usedSize : peakSize;
+}
+
+bool DebugAllocator::KnowsSizes() const
+{
+	return mSettings.blockHeaders || mSettings.trackBlocks;
+}
+
+std::vector<DebugAllocator::Block> DebugAllocator::GetBlocks() const
+{
+	std::vector<Block> blocks;
+	std::lock_guard<std::mutex> lock(mBlocksMutex);
+	blocks.reserve(mBlocks.GetSize());
+	mBlocks.ForEach([&blocks](const void* ptr, const TrackedBlock& block)
+	{
+		blocks.push_back({ const_cast<void*>(ptr), block.size });
+	});
+	return blocks;
+}
+
+std::size_t DebugAllocator::WriteLeakReport(std::FILE* file) const
+{
+	if (!mSettings.trackBlocks)
+	{
+		// Only the counters are known
+		const std::size_t allocationCount = GetAllocationCount();
+		const std::size_t deallocationCount = GetDeallocationCount();
+		const std::size_t blockCount = (allocationCount > deallocationCount) ? allocationCount - deallocationCount : 0;
+		if (blockCount > 0 && KnowsSizes())
+		{
+			std::fprintf(file, "DebugAllocator %p : %zu blocks (%zu bytes) still allocated\n", static_cast<const void*>(this), blockCount, GetUsedSize());
+		}
+		else if (blockCount > 0)
+		{
+			std::fprintf(file, "DebugAllocator %p : %zu blocks still allocated\n", static_cast<const void*>(this), blockCount);
+		}
+		return blockCount;
+	}
+
+	struct Group
+	{
+		const CallSite* callSite; // nullptr for the blocks without call site
+		std::size_t count;
+		std::size_t size;
+	};
+	std::vector<Group> groups;
+	Group unknownGroup = { nullptr, 0, 0 };
+	{
+		// Call sites are only freed by the destructor, their frames can be read after unlocking
+		std::lock_guard<std::mutex> lock(mBlocksMutex);
+		mCallSites.ForEach([&groups](const void*, const CallSite* callSite)
+		{
+			if (callSite->liveCount > 0)
+			{
+				groups.push_back({ callSite, callSite->liveCount, callSite->liveSize });
+			}
+		});
+		mBlocks.ForEach([&unknownGroup](const void*, const TrackedBlock& block)
+		{
+			if (block.callSite == nullptr)
+			{
+				unknownGroup.count++;
+				unknownGroup.size += block.size;
+			}
+		});
+	}
+	if (unknownGroup.count > 0)
+	{
+		groups.push_back(unknownGroup);
+	}
+	if (groups.empty())
+	{
+		return 0;
+	}
+
+	// Largest leaks first
+	std::sort(groups.begin(), groups.end(), [](const Group& a, const Group& b)
+	{
+		return a.size > b.size;
+	});
+	std::size_t blockCount = 0;
+	std::size_t size = 0;
+	for (const Group& group : groups)
+	{
+		blockCount += group.count;
+		size += group.size;
+	}
+	std::fprintf(file, "DebugAllocator %p : %zu blocks (%zu bytes) still allocated\n", static_cast<const void*>(this), blockCount, size);
+	for (const Group& group : groups)
+	{
+		if (group.callSite == nullptr || group.callSite->frameCount == 0)
+		{
+			std::fprintf(file, "  %zu blocks (%zu bytes) from an unknown call site\n", group.count, group.size);
+			continue;
+		}
+		std::fprintf(file, "  %zu blocks (%zu bytes) allocated from :\n", group.count, group.size);
+#if defined(DYMA_BACKTRACE)
+		char** symbols = backtrace_symbols(group.callSite->frames, static_cast<int>(group.callSite->frameCount));
+#endif
+		for (std::size_t i = 0; i < group.callSite->frameCount; ++i)
+		{
+#if defined(DYMA_BACKTRACE)
+			if (symbols != nullptr)
+			{
+				std::fprintf(file, "    #%zu %s\n", i, symbols[i]);
+				continue;
+			}
+#endif
+			std::fprintf(file, "    #%zu %p\n", i, group.callSite->frames[i]);
+		}
+#if defined(DYMA_BACKTRACE)
+		std::free(symbols);
+#endif
+	}
+	return blockCount;
+}
+
+const DebugAllocator::Settings& DebugAllocator::GetSettings() const
+{
+	return mSettings;
+}
+
+std::size_t DebugAllocator::GetHeaderSize() const
+{
+	return mHeaderSize;
+}
+
+void* DebugAllocator::CreateCounters(void* allocator)
+{
+	DebugAllocator* self = static_cast<DebugAllocator*>(allocator);
+	ThreadCounters* counters = new ThreadCounters();
+	std::lock_guard<std::mutex> lock(self->mCountersMutex);
+	counters->previous = nullptr;
+	counters->next = self->mCounters;
+	if (self->mCounters != nullptr)
+	{
+		self->mCounters->previous = counters;
+	}
+	self->mCounters = counters;
+	return counters;
+}
+
+void DebugAllocator::ReleaseCounters(void* allocator, void* counters)
+{
+	DebugAllocator* self = static_cast<DebugAllocator*>(allocator);
+	ThreadCounters* threadCounters = static_cast<ThreadCounters*>(counters);
+	self->AccountUsedSize(*threadCounters, 0);
+	{
+		std::lock_guard<std::mutex> lock(self->mCountersMutex);
+		ThreadCounters& exited = self->mExitedCounters;
+		exited.allocationCount.store(exited.allocationCount.load(std::memory_order_relaxed) + threadCounters->allocationCount.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		exited.deallocationCount.store(exited.deallocationCount.load(std::memory_order_relaxed) + threadCounters->deallocationCount.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		exited.failureCount.store(exited.failureCount.load(std::memory_order_relaxed) + threadCounters->failureCount.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		exited.allocatedSize.store(exited.allocatedSize.load(std::memory_order_relaxed) + threadCounters->allocatedSize.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		exited.deallocatedSize.store(exited.deallocatedSize.load(std::memory_order_relaxed) + threadCounters->deallocatedSize.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		if (threadCounters->previous != nullptr)
+		{
+			threadCounters->previous->next = threadCounters->next;
+		}
+		else
+		{
+			self->mCounters = threadCounters->next;
+		}
+		if (threadCounters->next != nullptr)
+		{
+			threadCounters->next->previous = threadCounters->previous;
+		}
+	}
+	delete threadCounters;
+}
+
+void DebugAllocator::AccountUsedSize(ThreadCounters& counters, std::int64_t size)
+{
+	// Accounting every allocation would make all the threads write the same cache line
+	counters.unaccountedSize += size;
+	const std::int64_t granularity = static_cast<std::int64_t>(mSettings.peakGranularity);
+	if (size != 0 && counters.unaccountedSize < granularity && counters.unaccountedSize > -granularity)
+	{
+		return;
+	}
+
+	const std::int64_t accountedSize = mAccountedSize.fetch_add(counters.unaccountedSize, std::memory_order_relaxed) + counters.unaccountedSize;
+	counters.unaccountedSize = 0;
+	std::int64_t peakSize = mPeakSize.load(std::memory_order_relaxed);
+	while (accountedSize > peakSize && !mPeakSize.compare_exchange_weak(peakSize, accountedSize, std::memory_order_relaxed))
+	{
+	}
+}
+
+void DebugAllocator::CountFailure(ThreadCounters* counters)
+{
+	if (counters != nullptr)
+	{
+		counters->failureCount.store(counters->failureCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+}
+
+bool DebugAllocator::TrackBlock(void* ptr, const TrackedBlock& block)
+{
+	if (!mBlocks.Insert(ptr, block))
+	{
+		return false;
+	}
+	if (block.callSite != nullptr)
+	{
+		block.callSite->liveCount++;
+		block.callSite->liveSize += block.size;
+	}
+	return true;
+}
+
+bool DebugAllocator::UntrackBlock(void* ptr, TrackedBlock* block)
+{
+	if (!mBlocks.Remove(ptr, block))
+	{
+		return false;
+	}
+	if (block->callSite != nullptr)
+	{
+		block->callSite->liveCount--;
+		block->callSite->liveSize -= block->size;
+	}
+	return true;
+}
+
+DebugAllocator::CallSite* DebugAllocator::FindCallSite(void* const* frames, std::size_t frameCount)
+{
+	// A collision with another call site moves to the next key
+	for (std::uint64_t hash = HashFrames(frames, frameCount);; ++hash)
+	{
+		const void* key = reinterpret_cast<const void*>(static_cast<std::uintptr_t>((hash != 0) ? hash : 1));
+		CallSite** found = mCallSites.Find(key);
+		if (found == nullptr)
+		{
+			CallSite* callSite = static_cast<CallSite*>(mBlocksAllocator.Allocate(sizeof(CallSite)));
+			if (callSite == nullptr)
+			{
+				return nullptr;
+			}
+			callSite->frameCount = frameCount;
+			std::memcpy(callSite->frames, frames, frameCount * sizeof(void*));
+			callSite->liveCount = 0;
+			callSite->liveSize = 0;
+			if (!mCallSites.Insert(key, callSite))
+			{
+				void* callSitePtr = callSite;
+				mBlocksAllocator.Deallocate(callSitePtr);
+				return nullptr;
+			}
+			return callSite;
+		}
+		CallSite* callSite = *found;
+		if (callSite->frameCount == frameCount && std::memcmp(callSite->frames, frames, frameCount * sizeof(void*)) == 0)
+		{
+			return callSite;
+		}
+	}
+}
+
+SamplingProfilerAllocator::SamplingProfilerAllocator(Allocator& allocator)
+	: SamplingProfilerAllocator(allocator, Settings())
+{
+}
+
+SamplingProfilerAllocator::SamplingProfilerAllocator(Allocator& allocator, const Settings& settings)
+	: mAllocator(allocator)
+	, mSettings(settings)
+	, mSamplesMutex()
+	, mProfileMallocator()
+	, mProfileAllocator((settings.profileAllocator != nullptr) ? *settings.profileAllocator : mProfileMallocator)
+	, mSamples(mProfileAllocator)
+	, mStacks(mProfileAllocator)
+	, mSamplers(&SamplingProfilerAllocator::CreateSampler, &SamplingProfilerAllocator::ReleaseSampler, this)
+{
+	for (std::size_t i = 0; i < FilterSize; ++i)
+	{
+		mFilter[i].store(0, std::memory_order_relaxed);
+	}
+}
+
+SamplingProfilerAllocator::~SamplingProfilerAllocator()
+{
+	Allocator& profileAllocator = mProfileAllocator;
+	mStacks.ForEach([&profileAllocator](const void*, StackRecord* stack)
+	{
+		void* ptr = stack;
+		profileAllocator.Deallocate(ptr);
+	});
+}
+
+void* SamplingProfilerAllocator::Allocate(std::size_t size)
+{
+	void* ptr = mAllocator.Allocate(size);
+	if (ptr == nullptr)
+	{
+		return nullptr;
+	}
+
+	ThreadSampler* sampler = static_cast<ThreadSampler*>(mSamplers.Get());
+	if (sampler != nullptr)
+	{
+		sampler->bytesUntilSample -= static_cast<std::int64_t>(size);
+		if (sampler->bytesUntilSample <= 0)
+		{
+			sampler->bytesUntilSample = DrawSampleInterval(*sampler);
+			void* frames[MaxFrameCount];
+			const std::size_t frameCount = CaptureStack(frames, MaxFrameCount, 1);
+			RecordSample(ptr, size, frames, frameCount);
+		}
+	}
+	return ptr;
+}
+
+bool SamplingProfilerAllocator::Deallocate(void*& ptr)
+{
+	if (ptr == nullptr)
+	{
+		return false;
+	}
+
+	// Removed before the wrapped allocator can give the same address to another thread
+	Sample sample = { nullptr, 0 };
+	std::atomic<std::uint32_t>& filter = mFilter[GetFilterIndex(ptr)];
+	if (filter.load(std::memory_order_relaxed) != 0)
+	{
+		std::lock_guard<std::mutex> lock(mSamplesMutex);
+		if (mSamples.Remove(ptr, &sample))
+		{
+			sample.stack->inUseCount--;
+			sample.stack->inUseSize -= sample.size;
+			filter.fetch_sub(1, std::memory_order_relaxed);
+		}
+	}
+
+	void* samplePtr = ptr;
+	if (!mAllocator.Deallocate(ptr))
+	{
+		if (sample.stack != nullptr)
+		{
+			std::lock_guard<std::mutex> lock(mSamplesMutex);
+			if (mSamples.Insert(samplePtr, sample))
+			{
+				sample.stack->inUseCount++;
+				sample.stack->inUseSize += sample.size;
+				filter.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+		return false;
+	}
+	return true;
+}
+
+bool SamplingProfilerAllocator::Owns(const void* ptr) const
+{
+	return mAllocator.Owns(ptr);
+}
+
+const MemorySource* SamplingProfilerAllocator::GetSource() const
+{
+	return mAllocator.GetSource();
+}
+
+bool SamplingProfilerAllocator::IsThreadSafe() const
+{
+	return mAllocator.IsThreadSafe();
+}
+
+MemoryUsage SamplingProfilerAllocator::GetMemoryUsage() const
+{
+	return mAllocator.GetMemoryUsage();
+}
+
+bool SamplingProfilerAllocator::WriteProfile(std::FILE* file) const
+{
+	if (file == nullptr)
+	{
+		return false;
+	}
+
+	bool success = true;
+	{
+		std::lock_guard<std::mutex> lock(mSamplesMutex);
+		struct Totals
+		{
+			unsigned long long allocatedCount;
+			unsigned long long allocatedSize;
+			unsigned long long inUseCount;
+			unsigned long long inUseSize;
+		} totals = { 0, 0, 0, 0 };
+		mStacks.ForEach([&totals](const void*, const StackRecord* stack)
+		{
+			totals.allocatedCount += stack->allocatedCount;
+			totals.allocatedSize += stack->allocatedSize;
+			totals.inUseCount += stack->inUseCount;
+			totals.inUseSize += stack->inUseSize;
+		});
+		success &= std::fprintf(file, "heap profile: %llu: %llu [%llu: %llu] @ heap_v2/%llu\n", totals.inUseCount, totals.inUseSize, totals.allocatedCount, totals.allocatedSize, static_cast<unsigned long long>(mSettings.samplingInterval)) > 0;
+
+		mStacks.ForEach([file, &success](const void*, const StackRecord* stack)
+		{
+			success &= std::fprintf(file, "%llu: %llu [%llu: %llu] @", static_cast<unsigned long long>(stack->inUseCount), static_cast<unsigned long long>(stack->inUseSize), static_cast<unsigned long long>(stack->allocatedCount), static_cast<unsigned long long>(stack->allocatedSize)) > 0;
+			for (std::size_t i = 0; i < stack->frameCount; ++i)
+			{
+				success &= std::fprintf(file, " 0x%llx", static_cast<unsigned long long>(reinterpret_cast<std::uintptr_t>(stack->frames[i]))) > 0;
+			}
+			success &= std::fputc('\n', file) != EOF;
+		});
+	}
+
+#if defined(__linux__)
+	// Lets pprof symbolize the addresses without the binary being loaded at the same address
+	std::FILE* maps = std::fopen("/proc/self/maps", "r");
+	if (maps != nullptr)
+	{
+		success &= std::fputs("\nMAPPED_LIBRARIES:\n", file) != EOF;
+		char buffer[4096];
+		std::size_t readSize;
+		while ((readSize = std::fread(buffer, 1, sizeof(buffer), maps)) > 0)
+		{
+			success &= std::fwrite(buffer, 1, readSize, file) == readSize;
+		}
+		std::fclose(maps);
+	}
+#endif
+	return success && std::fflush(file) == 0;
+}
+
+bool SamplingProfilerAllocator::WriteProfile(const char* filename) const
+{
+	std::FILE* file = std::fopen(filename, "w");
+	if (file == nullptr)
+	{
+		return false;
+	}
+	const bool success = WriteProfile(file);
+	return (std::fclose(file) == 0) && success;
+}
+
+std::size_t SamplingProfilerAllocator::GetInUseSampleCount() const
+{
+	std::lock_guard<std::mutex> lock(mSamplesMutex);
+	return mSamples.GetSize();
+}
+
+std::size_t SamplingProfilerAllocator::GetStackCount() const
+{
+	std::lock_guard<std::mutex> lock(mSamplesMutex);
+	return mStacks.GetSize();
+}
+
+const SamplingProfilerAllocator::Settings& SamplingProfilerAllocator::GetSettings() const
+{
+	return mSettings;
+}
+
+void* SamplingProfilerAllocator::CreateSampler(void* allocator)
+{
+	SamplingProfilerAllocator* self = static_cast<SamplingProfilerAllocator*>(allocator);
+	ThreadSampler* sampler = new ThreadSampler();
+	sampler->random = ((0x9E3779B97F4A7C15ull * (GetCurrentThreadIndex() + 1)) ^ reinterpret_cast<std::uintptr_t>(sampler)) | 1; // Never 0
+	sampler->bytesUntilSample = self->DrawSampleInterval(*sampler);
+	return sampler;
+}
+
+void SamplingProfilerAllocator::ReleaseSampler(void*, void* sampler)
+{
+	delete static_cast<ThreadSampler*>(sampler);
+}
+
+std::int64_t SamplingProfilerAllocator::DrawSampleInterval(ThreadSampler& sampler) const
+{
+	if (mSettings.samplingInterval == 0)
+	{
+		return 0;
+	}
+
+	// xorshift64*, then -log(u) * interval with u uniform in ]0, 1] follows an exponential distribution of mean interval
+	sampler.random ^= sampler.random >> 12;
+	sampler.random ^= sampler.random << 25;
+	sampler.random ^= sampler.random >> 27;
+	const std::uint64_t bits = (sampler.random * 0x2545F4914F6CDD1Dull) >> 11;
+	const double uniform = static_cast<double>(bits + 1) * (1.0 / 9007199254740992.0);
+	return static_cast<std::int64_t>(-std::log(uniform) * static_cast<double>(mSettings.samplingInterval)) + 1;
+}
+
+void SamplingProfilerAllocator::RecordSample(void* ptr, std::size_t size, void* const* frames, std::size_t frameCount)
+{
+	std::lock_guard<std::mutex> lock(mSamplesMutex);
+	StackRecord* stack = FindStack(frames, frameCount);
+	if (stack == nullptr)
+	{
+		return;
+	}
+	stack->allocatedCount++;
+	stack->allocatedSize += size;
+	if (mSamples.Insert(ptr, { stack, size }))
+	{
+		stack->inUseCount++;
+		stack->inUseSize += size;
+		mFilter[GetFilterIndex(ptr)].fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+SamplingProfilerAllocator::StackRecord* SamplingProfilerAllocator::FindStack(void* const* frames, std::size_t frameCount)
+{
+	// A collision with another stack moves to the next key
+	for (std::uint64_t hash = HashFrames(frames, frameCount);; ++hash)
+	{
+		const void* key = reinterpret_cast<const void*>(static_cast<std::uintptr_t>((hash != 0) ? hash : 1));
+		StackRecord** found = mStacks.Find(key);
+		if (found == nullptr)
+		{
+			StackRecord* stack = static_cast<StackRecord*>(mProfileAllocator.Allocate(sizeof(StackRecord)));
+			if (stack == nullptr)
+			{
+				return nullptr;
+			}
+			stack->frameCount = frameCount;
+			std::memcpy(stack->frames, frames, frameCount * sizeof(void*));
+			stack->allocatedCount = 0;
+			stack->allocatedSize = 0;
+			stack->inUseCount = 0;
+			stack->inUseSize = 0;
+			if (!mStacks.Insert(key, stack))
+			{
+				void* stackPtr = stack;
+				mProfileAllocator.Deallocate(stackPtr);
+				return nullptr;
+			}
+			return stack;
+		}
+		StackRecord* stack = *found;
+		if (stack->frameCount == frameCount && std::memcmp(stack->frames, frames, frameCount * sizeof(void*)) == 0)
+		{
+			return stack;
+		}
+	}
+}
+
+std::size_t SamplingProfilerAllocator::GetFilterIndex(const void* ptr)
+{
+	const std::uint64_t hash = static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(ptr)) * 0x9E3779B97F4A7C15ull;
+	return static_cast<std::size_t>(hash >> 54) & (FilterSize - 1);
+}
+
+namespace
+{
+
+const char TraceMagic[8] = { 'D', 'Y', 'M', 'A', 'T', 'R', 'C', '1' };
+
+std::uint8_t* WriteVarint(std::uint8_t* data, std::uint64_t value)
+{
+	while (value >= 0x80)
+	{
+		*data++ = static_cast<std::uint8_t>(value | 0x80);
+		value >>= 7;
+	}
+	*data++ = static_cast<std::uint8_t>(value);
+	return data;
+}
+
+bool ReadVarint(const std::uint8_t*& data, const std::uint8_t* end, std::uint64_t& value)
+{
+	value = 0;
+	for (unsigned int shift = 0; data < end && shift < 64; shift += 7)
+	{
+		const std::uint8_t byte = *data++;
+		value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+		if ((byte & 0x80) == 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+bool ReadVarint(std::FILE* file, std::uint64_t& value)
+{
+	value = 0;
+	for (unsigned int shift = 0; shift < 64; shift += 7)
+	{
+		const int byte = std::fgetc(file);
+		if (byte == EOF)
+		{
+			return false;
+		}
+		value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+		if ((byte & 0x80) == 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+// Addresses are written relative to the previous one, zigzag keeps the small negative deltas small
+std::uint64_t ZigzagEncode(std::uint64_t delta)
+{
+	return (delta << 1) ^ static_cast<std::uint64_t>(static_cast<std::int64_t>(delta) >> 63);
+}
+
+std::uint64_t ZigzagDecode(std::uint64_t value)
+{
+	return (value >> 1) ^ (~(value & 1) + 1);
+}
+
+} // namespace
+
+TraceRecorderAllocator::TraceRecorderAllocator(Allocator& allocator, std::FILE* file)
+	: mAllocator(allocator)
+	, mFile(file)
+	, mFileMutex()
+	, mFailed(false)
+	, mSequence(0)
+	, mFailedDeallocationCount(0)
+	, mStartTime(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count())
+	, mBuffers(&TraceRecorderAllocator::CreateBuffer, &TraceRecorderAllocator::ReleaseBuffer, this) // Destroyed first, writing the events of the threads still alive
+{
+	if (mFile == nullptr || std::fwrite(TraceMagic, 1, sizeof(TraceMagic), mFile) != sizeof(TraceMagic))
+	{
+		mFailed.store(true, std::memory_order_relaxed);
+	}
+}
+
+void* TraceRecorderAllocator::Allocate(std::size_t size)
+{
+	void* ptr = mAllocator.Allocate(size);
+	if (ptr != nullptr)
+	{
+		// Taken once the block is allocated, so it comes after the deallocation of a previous block at the same address
+		const std::uint64_t sequence = mSequence.fetch_add(1, std::memory_order_relaxed);
+		Record(Event::Type::Allocate, sequence, ptr, size);
+	}
+	return ptr;
+}
+
+bool TraceRecorderAllocator::Deallocate(void*& ptr)
+{
+	// Taken before the block can be allocated again
+	const void* recordedPtr = ptr;
+	const std::uint64_t sequence = mSequence.fetch_add(1, std::memory_order_relaxed);
+	if (!mAllocator.Deallocate(ptr))
+	{
+		mFailedDeallocationCount.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+	Record(Event::Type::Deallocate, sequence, recordedPtr, 0);
+	return true;
+}
+
+bool TraceRecorderAllocator::Owns(const void* ptr) const
+{
+	return mAllocator.Owns(ptr);
+}
+
+const MemorySource* TraceRecorderAllocator::GetSource() const
+{
+	return mAllocator.GetSource();
+}
+
+bool TraceRecorderAllocator::IsThreadSafe() const
+{
+	return mAllocator.IsThreadSafe();
+}
+
+MemoryUsage TraceRecorderAllocator::GetMemoryUsage() const
+{
+	return mAllocator.GetMemoryUsage();
+}
+
+void TraceRecorderAllocator::Flush()
+{
+	ThreadBuffer* buffer = static_cast<ThreadBuffer*>(mBuffers.Get());
+	if (buffer != nullptr)
+	{
+		WriteChunk(*buffer);
+	}
+}
+
+std::uint64_t TraceRecorderAllocator::GetEventCount() const
+{
+	const std::uint64_t failedDeallocationCount = mFailedDeallocationCount.load(std::memory_order_relaxed);
+	const std::uint64_t sequence = mSequence.load(std::memory_order_relaxed);
+	return (sequence > failedDeallocationCount) ? sequence - failedDeallocationCount : 0;
+}
+
+bool TraceRecorderAllocator::HasFailed() const
+{
+	return mFailed.load(std::memory_order_relaxed);
+}
+
+bool TraceRecorderAllocator::ReadTrace(std::FILE* file, std::vector<Event>& events)
+{
+	char magic[sizeof(TraceMagic)];
+	if (file == nullptr || std::fread(magic, 1, sizeof(magic), file) != sizeof(magic) || std::memcmp(magic, TraceMagic, sizeof(magic)) != 0)
+	{
+		return false;
+	}
+
+	std::vector<std::uint8_t> chunk;
+	std::uint64_t thread;
+	while (ReadVarint(file, thread))
+	{
+		std::uint64_t chunkSize;
+		if (!ReadVarint(file, chunkSize))
+		{
+			return false;
+		}
+		chunk.resize(static_cast<std::size_t>(chunkSize));
+		if (std::fread(chunk.data(), 1, chunk.size(), file) != chunk.size())
+		{
+			return false;
+		}
+
+		// Every chunk starts from zero
+		const std::uint8_t* data = chunk.data();
+		const std::uint8_t* end = data + chunk.size();
+		Event event = { Event::Type::Allocate, static_cast<std::uint32_t>(thread), 0, 0, 0, 0 };
+		while (data < end)
+		{
+			const std::uint8_t type = *data++;
+			std::uint64_t sequenceDelta;
+			std::uint64_t timeDelta;
+			std::uint64_t addressDelta;
+			if (type > static_cast<std::uint8_t>(Event::Type::Deallocate) || !ReadVarint(data, end, sequenceDelta) || !ReadVarint(data, end, timeDelta) || !ReadVarint(data, end, addressDelta))
+			{
+				return false;
+			}
+			event.type = static_cast<Event::Type>(type);
+			event.sequence += sequenceDelta;
+			event.time += timeDelta;
+			event.address += ZigzagDecode(addressDelta);
+			event.size = 0;
+			if (event.type == Event::Type::Allocate && !ReadVarint(data, end, event.size))
+			{
+				return false;
+			}
+			events.push_back(event);
+		}
+	}
+
+	std::sort(events.begin(), events.end(), [](const Event& a, const Event& b)
+	{
+		return a.sequence < b.sequence;
+	});
+	return std::feof(file) != 0;
+}
+
+void* TraceRecorderAllocator::CreateBuffer(void*)
+{
+	ThreadBuffer* buffer = new ThreadBuffer();
+	buffer->thread = static_cast<std::uint32_t>(GetCurrentThreadIndex());
+	buffer->size = 0;
+	buffer->previousSequence = 0;
+	buffer->previousTime = 0;
+	buffer->previousAddress = 0;
+	return buffer;
+}
+
+void TraceRecorderAllocator::ReleaseBuffer(void* recorder, void* buffer)
+{
+	ThreadBuffer* threadBuffer = static_cast<ThreadBuffer*>(buffer);
+	static_cast<TraceRecorderAllocator*>(recorder)->WriteChunk(*threadBuffer);
+	delete threadBuffer;
+}
+
+void TraceRecorderAllocator::Record(Event::Type type, std::uint64_t sequence, const void* ptr, std::size_t size)
+{
+	ThreadBuffer* buffer = static_cast<ThreadBuffer*>(mBuffers.Get());
+	if (buffer == nullptr)
+	{
+		mFailed.store(true, std::memory_order_relaxed);
+		return;
+	}
+	if (buffer->size + MaxEventSize > BufferSize)
+	{
+		WriteChunk(*buffer);
+	}
+
+	// Sequences and times only grow within a thread
+	const std::uint64_t time = GetTime();
+	const std::uint64_t address = static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(ptr));
+	std::uint8_t* data = buffer->data + buffer->size;
+	*data++ = static_cast<std::uint8_t>(type);
+	data = WriteVarint(data, sequence - buffer->previousSequence);
+	data = WriteVarint(data, (time > buffer->previousTime) ? time - buffer->previousTime : 0);
+	data = WriteVarint(data, ZigzagEncode(address - buffer->previousAddress));
+	if (type == Event::Type::Allocate)
+	{
+		data = WriteVarint(data, size);
+	}
+	buffer->size = static_cast<std::size_t>(data - buffer->data);
+	buffer->previousSequence = sequence;
+	buffer->previousTime = (time > buffer->previousTime) ? time : buffer->previousTime;
+	buffer->previousAddress = address;
+}
+
+void TraceRecorderAllocator::WriteChunk(ThreadBuffer& buffer)
+{
+	if (buffer.size == 0)
+	{
+		return;
+	}
+
+	std::uint8_t header[2 * 10];
+	std::uint8_t* headerEnd = WriteVarint(header, buffer.thread);
+	headerEnd = WriteVarint(headerEnd, buffer.size);
+	const std::size_t headerSize = static_cast<std::size_t>(headerEnd - header);
+	{
+		std::lock_guard<std::mutex> lock(mFileMutex);
+		if (mFile == nullptr || std::fwrite(header, 1, headerSize, mFile) != headerSize || std::fwrite(buffer.data, 1, buffer.size, mFile) != buffer.size)
+		{
+			mFailed.store(true, std::memory_order_relaxed);
+		}
+	}
+	buffer.size = 0;
+	buffer.previousSequence = 0;
+	buffer.previousTime = 0;
+	buffer.previousAddress = 0;
+}
+
+std::uint64_t TraceRecorderAllocator::GetTime() const
+{
+	const std::int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	return static_cast<std::uint64_t>(now - mStartTime);
+}
+
+namespace
+{
+
+// Index of the highest bit set, value shouldn't be 0
+std::size_t FloorLog2(std::uint64_t value)
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanReverse64(&index, value);
+	return static_cast<std::size_t>(index);
+#elif defined(__GNUC__) || defined(__clang__)
+	return static_cast<std::size_t>(63 - __builtin_clzll(value));
+#else
+	std::size_t index = 0;
+	while (value >>= 1)
+	{
+		index++;
+	}
+	return index;
+#endif
+}
+
+} // namespace
+
+std::uint64_t HistogramAllocator::Histogram::GetTotal() const
+{
+	std::uint64_t total = 0;
+	for (std::size_t i = 0; i < BucketCount; ++i)
+	{
+		total += counts[i];
+	}
+	return total;
+}
+
+HistogramAllocator::HistogramAllocator(Allocator& allocator)
+	: HistogramAllocator(allocator, Settings())
+{
+}
+
+HistogramAllocator::HistogramAllocator(Allocator& allocator, const Settings& settings)
+	: mAllocator(allocator)
+	, mSettings(settings)
+	, mHeaderSize(settings.trackLifetimes ? RoundToAlignment(sizeof(BlockHeader), alignof(std::max_align_t)) : 0)
+	, mAllocationIndex(0)
+	, mStartTime(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count())
+	, mHistogramsMutex()
+	, mHistograms(nullptr)
+	, mExitedHistograms()
+	, mThreadHistograms(&HistogramAllocator::CreateHistograms, &HistogramAllocator::ReleaseHistograms, this) // Destroyed first, summing the histograms of the threads still alive
+{
+	assert(mSettings.indexBatchSize > 0);
+}
+
+void* HistogramAllocator::Allocate(std::size_t size)
+{
+	if (size == 0)
+	{
+		return nullptr;
+	}
+
+	void* rawPtr = mAllocator.Allocate(mHeaderSize + size);
+	if (rawPtr == nullptr)
+	{
+		return nullptr;
+	}
+
+	ThreadHistograms* histograms = static_cast<ThreadHistograms*>(mThreadHistograms.Get());
+	if (histograms != nullptr)
+	{
+		Count(histograms->sizes, histograms->maxSizes, GetSizeBucket(size), size);
+
+		// The shared index is only written once every indexBatchSize allocations of a thread
+		if (++histograms->unaccountedAllocations >= mSettings.indexBatchSize)
+		{
+			mAllocationIndex.fetch_add(histograms->unaccountedAllocations, std::memory_order_relaxed);
+			histograms->unaccountedAllocations = 0;
+		}
+		if (mSettings.trackLifetimes)
+		{
+			BlockHeader* header = static_cast<BlockHeader*>(rawPtr);
+			header->birthTime = GetTime();
+			header->birthIndex = GetAllocationIndex(*histograms);
+		}
+	}
+	return reinterpret_cast<void*>(reinterpret_cast<std::uintptr_t>(rawPtr) + mHeaderSize);
+}
+
+bool HistogramAllocator::Deallocate(void*& ptr)
+{
+	if (ptr == nullptr)
+	{
+		return false;
+	}
+
+	void* rawPtr = reinterpret_cast<void*>(reinterpret_cast<std::uintptr_t>(ptr) - mHeaderSize);
+	BlockHeader header = { 0, 0 };
+	if (mSettings.trackLifetimes)
+	{
+		if (mSettings.checkOwnership && !mAllocator.Owns(rawPtr))
+		{
+			// The header would be read out of a foreign block
+			return false;
+		}
+		header = *static_cast<const BlockHeader*>(rawPtr);
+	}
+	if (!mAllocator.Deallocate(rawPtr))
+	{
+		return false;
+	}
+	ptr = nullptr;
+
+	ThreadHistograms* histograms = static_cast<ThreadHistograms*>(mThreadHistograms.Get());
+	if (histograms != nullptr && mSettings.trackLifetimes)
+	{
+		// Batches of other threads can make the index of the deallocation lower than the one of the allocation
+		const std::uint64_t index = GetAllocationIndex(*histograms);
+		const std::uint64_t lifetimeCount = (index > header.birthIndex) ? index - header.birthIndex : 0;
+		const std::uint64_t time = GetTime();
+		const std::uint64_t lifetimeTime = (time > header.birthTime) ? time - header.birthTime : 0;
+		Count(histograms->lifetimeCounts, histograms->maxLifetimeCounts, GetLifetimeBucket(lifetimeCount), lifetimeCount);
+		Count(histograms->lifetimeTimes, histograms->maxLifetimeTimes, GetLifetimeBucket(lifetimeTime), lifetimeTime);
+	}
+	return true;
+}
+
+bool HistogramAllocator::Owns(const void* ptr) const
+{
+	return ptr != nullptr && mAllocator.Owns(reinterpret_cast<const void*>(reinterpret_cast<std::uintptr_t>(ptr) - mHeaderSize));
+}
+
+const MemorySource* HistogramAllocator::GetSource() const
+{
+	return mAllocator.GetSource();
+}
+
+bool HistogramAllocator::IsThreadSafe() const
+{
+	return mAllocator.IsThreadSafe();
+}
+
+MemoryUsage HistogramAllocator::GetMemoryUsage() const
+{
+	return mAllocator.GetMemoryUsage();
+}
+
+HistogramAllocator::Histogram HistogramAllocator::GetSizeHistogram() const
+{
+	return SumHistograms(&ThreadHistograms::sizes, &ThreadHistograms::maxSizes);
+}
+
+HistogramAllocator::Histogram HistogramAllocator::GetLifetimeCountHistogram() const
+{
+	return SumHistograms(&ThreadHistograms::lifetimeCounts, &ThreadHistograms::maxLifetimeCounts);
+}
+
+HistogramAllocator::Histogram HistogramAllocator::GetLifetimeTimeHistogram() const
+{
+	return SumHistograms(&ThreadHistograms::lifetimeTimes, &ThreadHistograms::maxLifetimeTimes);
+}
+
+std::size_t HistogramAllocator::SuggestPoolBlockSize() const
+{
+	// The largest size of the bucket, not its power of two, so the blocks aren't up to twice too large
+	const Histogram histogram = GetSizeHistogram();
+	std::size_t mostCommonBucket = 0;
+	for (std::size_t i = 1; i < BucketCount; ++i)
+	{
+		if (histogram.counts[i] > histogram.counts[mostCommonBucket])
+		{
+			mostCommonBucket = i;
+		}
+	}
+	if (histogram.counts[mostCommonBucket] == 0)
+	{
+		return 0;
+	}
+	const std::size_t maxSize = static_cast<std::size_t>(histogram.maxValues[mostCommonBucket]);
+	return RoundToAlignment((maxSize > sizeof(void*)) ? maxSize : sizeof(void*), alignof(std::max_align_t));
+}
+
+std::size_t HistogramAllocator::SuggestSegregatorThreshold(double smallerRatio /*= 0.9*/) const
+{
+	const Histogram histogram = GetSizeHistogram();
+	const double total = static_cast<double>(histogram.GetTotal());
+	std::uint64_t count = 0;
+	for (std::size_t i = 0; i < BucketCount; ++i)
+	{
+		count += histogram.counts[i];
+		if (count > 0 && static_cast<double>(count) >= smallerRatio * total)
+		{
+			return static_cast<std::size_t>(histogram.maxValues[i]);
+		}
+	}
+	return 0;
+}
+
+const HistogramAllocator::Settings& HistogramAllocator::GetSettings() const
+{
+	return mSettings;
+}
+
+std::size_t HistogramAllocator::GetHeaderSize() const
+{
+	return mHeaderSize;
+}
+
+std::size_t HistogramAllocator::GetSizeBucket(std::uint64_t size)
+{
+	return (size <= 1) ? 0 : FloorLog2(size - 1) + 1;
+}
+
+std::size_t HistogramAllocator::GetLifetimeBucket(std::uint64_t lifetime)
+{
+	return (lifetime == ~std::uint64_t(0)) ? 63 : FloorLog2(lifetime + 1);
+}
+
+void* HistogramAllocator::CreateHistograms(void* allocator)
+{
+	HistogramAllocator* self = static_cast<HistogramAllocator*>(allocator);
+	ThreadHistograms* histograms = new ThreadHistograms();
+	std::lock_guard<std::mutex> lock(self->mHistogramsMutex);
+	histograms->previous = nullptr;
+	histograms->next = self->mHistograms;
+	if (self->mHistograms != nullptr)
+	{
+		self->mHistograms->previous = histograms;
+	}
+	self->mHistograms = histograms;
+	return histograms;
+}
+
+void HistogramAllocator::ReleaseHistograms(void* allocator, void* histograms)
+{
+	HistogramAllocator* self = static_cast<HistogramAllocator*>(allocator);
+	ThreadHistograms* threadHistograms = static_cast<ThreadHistograms*>(histograms);
+	self->mAllocationIndex.fetch_add(threadHistograms->unaccountedAllocations, std::memory_order_relaxed);
+	{
+		std::lock_guard<std::mutex> lock(self->mHistogramsMutex);
+		ThreadHistograms& exited = self->mExitedHistograms;
+		for (std::size_t i = 0; i < BucketCount; ++i)
+		{
+			exited.sizes[i].fetch_add(threadHistograms->sizes[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+			exited.lifetimeCounts[i].fetch_add(threadHistograms->lifetimeCounts[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+			exited.lifetimeTimes[i].fetch_add(threadHistograms->lifetimeTimes[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+			StoreMax(exited.maxSizes[i], threadHistograms->maxSizes[i].load(std::memory_order_relaxed));
+			StoreMax(exited.maxLifetimeCounts[i], threadHistograms->maxLifetimeCounts[i].load(std::memory_order_relaxed));
+			StoreMax(exited.maxLifetimeTimes[i], threadHistograms->maxLifetimeTimes[i].load(std::memory_order_relaxed));
+		}
+		if (threadHistograms->previous != nullptr)
+		{
+			threadHistograms->previous->next = threadHistograms->next;
+		}
+		else
+		{
+			self->mHistograms = threadHistograms->next;
+		}
+		if (threadHistograms->next != nullptr)
+		{
+			threadHistograms->next->previous = threadHistograms->previous;
+		}
+	}
+	delete threadHistograms;
+}
+
+void HistogramAllocator::Count(std::atomic<std::uint64_t>* counts, std::atomic<std::uint64_t>* maxValues, std::size_t bucket, std::uint64_t value)
+{
+	// Only the owner thread writes, so loads and stores are enough
+	counts[bucket].store(counts[bucket].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	StoreMax(maxValues[bucket], value);
+}
+
+void HistogramAllocator::StoreMax(std::atomic<std::uint64_t>& maxValue, std::uint64_t value)
+{
+	if (value > maxValue.load(std::memory_order_relaxed))
+	{
+		maxValue.store(value, std::memory_order_relaxed);
+	}
+}
+
+HistogramAllocator::Histogram HistogramAllocator::SumHistograms(std::atomic<std::uint64_t> (ThreadHistograms::*counts)[BucketCount], std::atomic<std::uint64_t> (ThreadHistograms::*maxValues)[BucketCount]) const
+{
+	Histogram histogram;
+	std::lock_guard<std::mutex> lock(mHistogramsMutex);
+	for (std::size_t i = 0; i < BucketCount; ++i)
+	{
+		histogram.counts[i] = (mExitedHistograms.*counts)[i].load(std::memory_order_relaxed);
+		histogram.maxValues[i] = (mExitedHistograms.*maxValues)[i].load(std::memory_order_relaxed);
+	}
+	for (const ThreadHistograms* histograms = mHistograms; histograms != nullptr; histograms = histograms->next)
+	{
+		for (std::size_t i = 0; i < BucketCount; ++i)
+		{
+			histogram.counts[i] += ((*histograms).*counts)[i].load(std::memory_order_relaxed);
+			const std::uint64_t maxValue = ((*histograms).*maxValues)[i].load(std::memory_order_relaxed);
+			histogram.maxValues[i] = (maxValue > histogram.maxValues[i]) ? maxValue : histogram.maxValues[i];
+		}
+	}
+	return histogram;
 }
 
-std::size_t SegregatorAllocator::GetThreshold() const
+std::uint64_t HistogramAllocator::GetAllocationIndex(const ThreadHistograms& histograms) const
 {
-	return mThreshold;
+	return mAllocationIndex.load(std::memory_order_relaxed) + histograms.unaccountedAllocations;
+}
+
+std::uint64_t HistogramAllocator::GetTime() const
+{
+	const std::int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	return static_cast<std::uint64_t>(now - mStartTime);
+}
+
+MemoryTagTree::MemoryTagTree(std::size_t capacity /*= 256*/)
+	: mNodes(new Node[capacity])
+	, mCapacity(capacity)
+	, mTagCount(1)
+	, mBudgetCallback(nullptr)
+	, mBudgetUserData(nullptr)
+	, mRegisterMutex()
+{
+	assert(mCapacity > 0 && mCapacity <= InvalidTag);
+	for (std::size_t i = 0; i < mCapacity; ++i)
+	{
+		mNodes[i].usedSize.store(0, std::memory_order_relaxed);
+		mNodes[i].peakSize.store(0, std::memory_order_relaxed);
+		mNodes[i].budget.store(0, std::memory_order_relaxed);
+		mNodes[i].parent = InvalidTag;
+		mNodes[i].name[0] = '\0';
+	}
+}
+
+MemoryTagTree::~MemoryTagTree()
+{
+	delete[] mNodes;
+}
+
+MemoryTag MemoryTagTree::Register(const char* path)
+{
+	std::lock_guard<std::mutex> lock(mRegisterMutex);
+	MemoryTag tag = RootTag;
+	while (*path != '\0')
+	{
+		const char* separator = std::strchr(path, '/');
+		const std::size_t nameSize = (separator != nullptr) ? static_cast<std::size_t>(separator - path) : std::strlen(path);
+		if (nameSize > MaxNameSize)
+		{
+			return InvalidTag;
+		}
+		if (nameSize > 0)
+		{
+			MemoryTag child = FindChild(tag, path, nameSize);
+			if (child == InvalidTag)
+			{
+				const std::size_t tagCount = mTagCount.load(std::memory_order_relaxed);
+				if (tagCount >= mCapacity)
+				{
+					return InvalidTag;
+				}
+				Node& node = mNodes[tagCount];
+				node.parent = tag;
+				std::memcpy(node.name, path, nameSize);
+				node.name[nameSize] = '\0';
+				child = static_cast<MemoryTag>(tagCount);
+
+				// Published after being written, for GetTagCount() readers
+				mTagCount.store(tagCount + 1, std::memory_order_release);
+			}
+			tag = child;
+		}
+		path += nameSize;
+		if (*path == '/')
+		{
+			path++;
+		}
+	}
+	return tag;
+}
+
+MemoryTag MemoryTagTree::Find(const char* path) const
+{
+	std::lock_guard<std::mutex> lock(mRegisterMutex);
+	MemoryTag tag = RootTag;
+	while (*path != '\0' && tag != InvalidTag)
+	{
+		const char* separator = std::strchr(path, '/');
+		const std::size_t nameSize = (separator != nullptr) ? static_cast<std::size_t>(separator - path) : std::strlen(path);
+		if (nameSize > 0)
+		{
+			tag = FindChild(tag, path, nameSize);
+		}
+		path += nameSize;
+		if (*path == '/')
+		{
+			path++;
+		}
+	}
+	return tag;
+}
+
+void MemoryTagTree::SetBudget(MemoryTag tag, std::size_t budget)
+{
+	assert(tag < GetTagCount());
+	mNodes[tag].budget.store(budget, std::memory_order_relaxed);
+}
+
+std::size_t MemoryTagTree::GetBudget(MemoryTag tag) const
+{
+	assert(tag < GetTagCount());
+	return mNodes[tag].budget.load(std::memory_order_relaxed);
+}
+
+void MemoryTagTree::SetBudgetCallback(BudgetCallback callback, void* userData)
+{
+	mBudgetCallback = callback;
+	mBudgetUserData = userData;
+}
+
+bool MemoryTagTree::Charge(MemoryTag tag, std::size_t size)
+{
+	assert(tag < GetTagCount());
+	for (MemoryTag current = tag; current != InvalidTag; current = mNodes[current].parent)
+	{
+		Node& node = mNodes[current];
+		const std::size_t usedSize = node.usedSize.fetch_add(size, std::memory_order_relaxed);
+		const std::size_t budget = node.budget.load(std::memory_order_relaxed);
+		if (budget != 0 && usedSize + size > budget && (mBudgetCallback == nullptr || !mBudgetCallback(mBudgetUserData, current, usedSize, size)))
+		{
+			// Concurrent charges may fail together instead of one of them going through, but the budget is never exceeded
+			for (MemoryTag charged = tag; ; charged = mNodes[charged].parent)
+			{
+				mNodes[charged].usedSize.fetch_sub(size, std::memory_order_relaxed);
+				if (charged == current)
+				{
+					break;
+				}
+			}
+			return false;
+		}
+
+		// The peak of a descendant can count a charge failing at an ancestor, never one exceeding its own budget
+		const std::size_t newUsedSize = usedSize + size;
+		std::size_t peakSize = node.peakSize.load(std::memory_order_relaxed);
+		while (newUsedSize > peakSize && !node.peakSize.compare_exchange_weak(peakSize, newUsedSize, std::memory_order_relaxed))
+		{
+		}
+	}
+	return true;
+}
+
+void MemoryTagTree::Release(MemoryTag tag, std::size_t size)
+{
+	assert(tag < GetTagCount());
+	for (MemoryTag current = tag; current != InvalidTag; current = mNodes[current].parent)
+	{
+		mNodes[current].usedSize.fetch_sub(size, std::memory_order_relaxed);
+	}
+}
+
+std::size_t MemoryTagTree::GetUsedSize(MemoryTag tag) const
+{
+	assert(tag < GetTagCount());
+	return mNodes[tag].usedSize.load(std::memory_order_relaxed);
+}
+
+std::size_t MemoryTagTree::GetPeakSize(MemoryTag tag) const
+{
+	assert(tag < GetTagCount());
+	return mNodes[tag].peakSize.load(std::memory_order_relaxed);
+}
+
+MemoryTag MemoryTagTree::GetParent(MemoryTag tag) const
+{
+	assert(tag < GetTagCount());
+	return mNodes[tag].parent;
+}
+
+const char* MemoryTagTree::GetName(MemoryTag tag) const
+{
+	assert(tag < GetTagCount());
+	return mNodes[tag].name;
+}
+
+std::size_t MemoryTagTree::GetTagCount() const
+{
+	return mTagCount.load(std::memory_order_acquire);
+}
+
+std::size_t MemoryTagTree::GetCapacity() const
+{
+	return mCapacity;
+}
+
+MemoryTag MemoryTagTree::FindChild(MemoryTag parent, const char* name, std::size_t nameSize) const
+{
+	const std::size_t tagCount = mTagCount.load(std::memory_order_relaxed);
+	for (std::size_t i = 1; i < tagCount; ++i)
+	{
+		const Node& node = mNodes[i];
+		if (node.parent == parent && std::strncmp(node.name, name, nameSize) == 0 && node.name[nameSize] == '\0')
+		{
+			return static_cast<MemoryTag>(i);
+		}
+	}
+	return InvalidTag;
+}
+
+namespace
+{
+
+thread_local MemoryTag tCurrentTag = MemoryTagTree::RootTag;
+
+} // namespace
+
+MemoryTagScope::MemoryTagScope(MemoryTag tag)
+	: mPreviousTag(tCurrentTag)
+{
+	tCurrentTag = tag;
+}
+
+MemoryTagScope::~MemoryTagScope()
+{
+	tCurrentTag = mPreviousTag;
+}
+
+MemoryTag MemoryTagScope::GetCurrentTag()
+{
+	return tCurrentTag;
+}
+
+TaggedAllocator::TaggedAllocator(Allocator& allocator, MemoryTagTree& tree)
+	: TaggedAllocator(allocator, tree, Settings())
+{
+}
+
+TaggedAllocator::TaggedAllocator(Allocator& allocator, MemoryTagTree& tree, const Settings& settings)
+	: mAllocator(allocator)
+	, mTree(tree)
+	, mSettings(settings)
+	, mHeaderSize(RoundToAlignment(sizeof(BlockHeader), alignof(std::max_align_t)))
+{
+}
+
+void* TaggedAllocator::Allocate(std::size_t size)
+{
+	return Allocate(size, MemoryTagScope::GetCurrentTag());
+}
+
+void* TaggedAllocator::Allocate(std::size_t size, MemoryTag tag)
+{
+	if (size == 0 || tag >= mTree.GetTagCount() || !mTree.Charge(tag, size))
+	{
+		return nullptr;
+	}
+
+	void* rawPtr = mAllocator.Allocate(mHeaderSize + size);
+	if (rawPtr == nullptr)
+	{
+		mTree.Release(tag, size);
+		return nullptr;
+	}
+
+	BlockHeader* header = static_cast<BlockHeader*>(rawPtr);
+	header->size = size;
+	header->tag = tag;
+	return reinterpret_cast<void*>(reinterpret_cast<std::uintptr_t>(rawPtr) + mHeaderSize);
+}
+
+bool TaggedAllocator::Deallocate(void*& ptr)
+{
+	if (ptr == nullptr)
+	{
+		return false;
+	}
+
+	void* rawPtr = reinterpret_cast<void*>(reinterpret_cast<std::uintptr_t>(ptr) - mHeaderSize);
+	if (mSettings.checkOwnership && !mAllocator.Owns(rawPtr))
+	{
+		// The header would be read out of a foreign block
+		return false;
+	}
+	const BlockHeader header = *static_cast<const BlockHeader*>(rawPtr);
+	if (!mAllocator.Deallocate(rawPtr))
+	{
+		return false;
+	}
+	mTree.Release(header.tag, header.size);
+	ptr = nullptr;
+	return true;
+}
+
+bool TaggedAllocator::Owns(const void* ptr) const
+{
+	return ptr != nullptr && mAllocator.Owns(reinterpret_cast<const void*>(reinterpret_cast<std::uintptr_t>(ptr) - mHeaderSize));
+}
+
+const MemorySource* TaggedAllocator::GetSource() const
+{
+	return mAllocator.GetSource();
+}
+
+bool TaggedAllocator::IsThreadSafe() const
+{
+	return mAllocator.IsThreadSafe();
+}
+
+MemoryUsage TaggedAllocator::GetMemoryUsage() const
+{
+	return mAllocator.GetMemoryUsage();
+}
+
+MemoryTag TaggedAllocator::GetTag(const void* ptr) const
+{
+	assert(ptr != nullptr);
+	return reinterpret_cast<const BlockHeader*>(reinterpret_cast<std::uintptr_t>(ptr) - mHeaderSize)->tag;
+}
+
+MemoryTagTree& TaggedAllocator::GetTree() const
+{
+	return mTree;
+}
+
+std::size_t TaggedAllocator::GetHeaderSize() const
+{
+	return mHeaderSize;
+}
+
+// The page starts with the header, followed by capacity entries
+// Only the publisher writes, the names are written once before entryCount is released
+struct StatsRegistry::SharedHeader
+{
+	std::atomic<std::uint64_t> magic; // Stored last
+	std::uint32_t entrySize;
+	std::uint32_t capacity;
+	std::uint64_t processId;
+	std::atomic<std::uint32_t> entryCount;
+};
+
+struct alignas(64) StatsRegistry::SharedEntry
+{
+	std::atomic<std::uint64_t> sequence; // Odd while the entry is written
+	std::atomic<std::uint64_t> active;
+	std::atomic<std::uint64_t> usedSize;
+	std::atomic<std::uint64_t> peakSize;
+	std::atomic<std::uint64_t> allocationCount;
+	std::atomic<std::uint64_t> deallocationCount;
+	std::atomic<std::uint64_t> failureCount;
+	std::atomic<std::uint64_t> allocationRate;
+	std::atomic<std::uint64_t> timestamp;
+	char name[MaxNameSize + 1];
+};
+
+namespace
+{
+
+constexpr std::uint64_t StatsMagic = 0x31415453414D5944ull; // "DYMASTA1"
+constexpr std::size_t StatsReadRetryCount = 1000; // A publisher that died while writing leaves its entry odd forever
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "The counters of the shared memory must be lock-free");
+static_assert(std::atomic<std::uint32_t>::is_always_lock_free, "The counters of the shared memory must be lock-free");
+
+std::int64_t GetSteadyTime()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+std::uint64_t GetSystemTime()
+{
+	return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+void CopyStatsName(char* destination, const char* source)
+{
+	std::size_t size = 0;
+	for (; source != nullptr && source[size] != '\0' && size < StatsRegistry::MaxNameSize; ++size)
+	{
+		destination[size] = source[size];
+	}
+	destination[size] = '\0';
+}
+
+} // namespace
+
+StatsRegistry::StatsRegistry()
+	: StatsRegistry(Settings())
+{
+}
+
+StatsRegistry::StatsRegistry(const Settings& settings)
+	: mSettings(settings)
+	, mName()
+	, mMapping(nullptr)
+	, mMappingSize(0)
+	, mHeader(nullptr)
+	, mEntries(nullptr)
+	, mSources()
+	, mMutex()
+	, mStopCondition()
+	, mStopping(false)
+	, mPublisher()
+{
+#if defined(_WIN32)
+	std::snprintf(mName, sizeof(mName), "%s", (settings.name != nullptr) ? settings.name : "");
+#else
+	if (settings.name != nullptr)
+	{
+		std::snprintf(mName, sizeof(mName), "%s", settings.name);
+	}
+	else
+	{
+		std::snprintf(mName, sizeof(mName), "/dyma-%ld", static_cast<long>(getpid()));
+	}
+	if (settings.capacity == 0)
+	{
+		return;
+	}
+
+	const std::size_t entriesOffset = RoundToAlignment(sizeof(SharedHeader), alignof(SharedEntry));
+	const std::size_t mappingSize = entriesOffset + settings.capacity * sizeof(SharedEntry);
+	int fd = shm_open(mName, O_CREAT | O_EXCL | O_RDWR, 0644);
+	if (fd < 0 && errno == EEXIST)
+	{
+		// Left by a process that crashed, it is only replaced once that process is gone
+		const int previousFd = shm_open(mName, O_RDONLY, 0);
+		bool stale = false;
+		struct stat status;
+		if (previousFd >= 0 && fstat(previousFd, &status) == 0 && static_cast<std::size_t>(status.st_size) >= sizeof(SharedHeader))
+		{
+			void* previous = mmap(nullptr, sizeof(SharedHeader), PROT_READ, MAP_SHARED, previousFd, 0);
+			if (previous != MAP_FAILED)
+			{
+				const SharedHeader* header = static_cast<const SharedHeader*>(previous);
+				const pid_t processId = static_cast<pid_t>(header->processId);
+				stale = header->magic.load(std::memory_order_acquire) == StatsMagic && kill(processId, 0) != 0 && errno == ESRCH;
+				munmap(previous, sizeof(SharedHeader));
+			}
+		}
+		if (previousFd >= 0)
+		{
+			close(previousFd);
+		}
+		if (stale && shm_unlink(mName) == 0)
+		{
+			fd = shm_open(mName, O_CREAT | O_EXCL | O_RDWR, 0644);
+		}
+	}
+	if (fd < 0)
+	{
+		return;
+	}
+	if (ftruncate(fd, static_cast<off_t>(mappingSize)) != 0)
+	{
+		close(fd);
+		shm_unlink(mName);
+		return;
+	}
+	void* mapping = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED)
+	{
+		shm_unlink(mName);
+		return;
+	}
+
+	// ftruncate fills the page with zeros, the magic is stored last so readers never see a partial header
+	mMapping = mapping;
+	mMappingSize = mappingSize;
+	mHeader = new (mapping) SharedHeader();
+	mHeader->entrySize = static_cast<std::uint32_t>(sizeof(SharedEntry));
+	mHeader->capacity = static_cast<std::uint32_t>(settings.capacity);
+	mHeader->processId = static_cast<std::uint64_t>(getpid());
+	mHeader->entryCount.store(0, std::memory_order_relaxed);
+	mEntries = reinterpret_cast<SharedEntry*>(reinterpret_cast<std::uintptr_t>(mapping) + entriesOffset);
+	for (std::size_t i = 0; i < settings.capacity; ++i)
+	{
+		new (&mEntries[i]) SharedEntry();
+	}
+	mHeader->magic.store(StatsMagic, std::memory_order_release);
+	mSources.reserve(settings.capacity);
+
+	if (settings.publishIntervalMs > 0)
+	{
+		mPublisher = std::thread(&StatsRegistry::RunPublisher, this);
+	}
+#endif
+}
+
+StatsRegistry::~StatsRegistry()
+{
+	if (mPublisher.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mStopping = true;
+		}
+		mStopCondition.notify_all();
+		mPublisher.join();
+	}
+#if !defined(_WIN32)
+	if (mMapping != nullptr)
+	{
+		shm_unlink(mName);
+		munmap(mMapping, mMappingSize);
+	}
+#endif
+}
+
+bool StatsRegistry::IsOpen() const
+{
+	return mMapping != nullptr;
+}
+
+const char* StatsRegistry::GetName() const
+{
+	return mName;
+}
+
+std::size_t StatsRegistry::GetCapacity() const
+{
+	return mSettings.capacity;
+}
+
+std::size_t StatsRegistry::Add(const char* name, const Allocator& allocator)
+{
+	return AddSource(name, &allocator, nullptr);
+}
+
+std::size_t StatsRegistry::Add(const char* name, const DebugAllocator& allocator)
+{
+	return AddSource(name, &allocator, &allocator);
+}
+
+void StatsRegistry::Remove(std::size_t index)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	if (index >= mSources.size() || !mSources[index].active)
+	{
+		return;
+	}
+	mSources[index].active = false;
+	SharedEntry& entry = mEntries[index];
+	const std::uint64_t sequence = entry.sequence.load(std::memory_order_relaxed);
+	entry.sequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	entry.active.store(0, std::memory_order_relaxed);
+	entry.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+void StatsRegistry::Publish()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	PublishSources();
+}
+
+bool StatsRegistry::Read(const char* name, std::vector<Snapshot>& snapshots)
+{
+	snapshots.clear();
+#if defined(_WIN32)
+	return false;
+#else
+	const int fd = shm_open(name, O_RDONLY, 0);
+	if (fd < 0)
+	{
+		return false;
+	}
+	struct stat status;
+	const std::size_t mappingSize = (fstat(fd, &status) == 0) ? static_cast<std::size_t>(status.st_size) : 0;
+	void* mapping = (mappingSize >= sizeof(SharedHeader)) ? mmap(nullptr, mappingSize, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+	close(fd);
+	if (mapping == MAP_FAILED)
+	{
+		return false;
+	}
+
+	const SharedHeader* header = static_cast<const SharedHeader*>(mapping);
+	const std::size_t entriesOffset = RoundToAlignment(sizeof(SharedHeader), alignof(SharedEntry));
+	if (header->magic.load(std::memory_order_acquire) != StatsMagic || header->entrySize != sizeof(SharedEntry) || mappingSize < entriesOffset + header->capacity * sizeof(SharedEntry))
+	{
+		munmap(mapping, mappingSize);
+		return false;
+	}
+
+	const SharedEntry* entries = reinterpret_cast<const SharedEntry*>(reinterpret_cast<std::uintptr_t>(mapping) + entriesOffset);
+	std::uint32_t entryCount = header->entryCount.load(std::memory_order_acquire);
+	entryCount = (entryCount < header->capacity) ? entryCount : header->capacity;
+	for (std::uint32_t i = 0; i < entryCount; ++i)
+	{
+		const SharedEntry& entry = entries[i];
+		Snapshot snapshot;
+		std::memcpy(snapshot.name, entry.name, sizeof(snapshot.name));
+		snapshot.name[MaxNameSize] = '\0';
+		bool active = false;
+		bool consistent = false;
+		for (std::size_t retry = 0; retry < StatsReadRetryCount && !consistent; ++retry)
+		{
+			const std::uint64_t sequence = entry.sequence.load(std::memory_order_acquire);
+			if ((sequence & 1) != 0)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+			active = entry.active.load(std::memory_order_relaxed) != 0;
+			snapshot.usedSize = entry.usedSize.load(std::memory_order_relaxed);
+			snapshot.peakSize = entry.peakSize.load(std::memory_order_relaxed);
+			snapshot.allocationCount = entry.allocationCount.load(std::memory_order_relaxed);
+			snapshot.deallocationCount = entry.deallocationCount.load(std::memory_order_relaxed);
+			snapshot.failureCount = entry.failureCount.load(std::memory_order_relaxed);
+			snapshot.allocationRate = entry.allocationRate.load(std::memory_order_relaxed);
+			snapshot.timestamp = entry.timestamp.load(std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_acquire);
+			consistent = entry.sequence.load(std::memory_order_relaxed) == sequence;
+		}
+		if (consistent && active)
+		{
+			snapshots.push_back(snapshot);
+		}
+	}
+	munmap(mapping, mappingSize);
+	return true;
+#endif
+}
+
+std::size_t StatsRegistry::AddSource(const char* name, const Allocator* allocator, const DebugAllocator* debugAllocator)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	if (mMapping == nullptr || mSources.size() >= mSettings.capacity)
+	{
+		return InvalidIndex;
+	}
+	if (mPublisher.joinable() && debugAllocator == nullptr && !allocator->IsThreadSafe())
+	{
+		// The background thread would read its usage while its thread allocates, the counters of a DebugAllocator are safe to read
+		return InvalidIndex;
+	}
+	const std::size_t index = mSources.size();
+	Source source = { allocator, debugAllocator, 0, 0, GetSteadyTime(), true };
+	if (debugAllocator != nullptr)
+	{
+		source.previousAllocationCount = debugAllocator->GetAllocationCount();
+	}
+	mSources.push_back(source);
+
+	// The entry is only visible once entryCount includes it, its first values are published right away
+	CopyStatsName(mEntries[index].name, name);
+	mEntries[index].active.store(1, std::memory_order_relaxed);
+	mHeader->entryCount.store(static_cast<std::uint32_t>(index + 1), std::memory_order_release);
+	PublishSources();
+	return index;
+}
+
+void StatsRegistry::PublishSources()
+{
+	const std::int64_t now = GetSteadyTime();
+	const std::uint64_t timestamp = GetSystemTime();
+	for (std::size_t i = 0; i < mSources.size(); ++i)
+	{
+		Source& source = mSources[i];
+		if (!source.active)
+		{
+			continue;
+		}
+
+		// The counters are read before entering the seqlock, so it is held for a few stores only
+		std::uint64_t usedSize = 0;
+		std::uint64_t peakSize = 0;
+		std::uint64_t allocationCount = 0;
+		std::uint64_t deallocationCount = 0;
+		std::uint64_t failureCount = 0;
+		if (source.debugAllocator != nullptr)
+		{
+			// Deallocations are read first, so they never outnumber the allocations
+			deallocationCount = source.debugAllocator->GetDeallocationCount();
+			allocationCount = source.debugAllocator->GetAllocationCount();
+			failureCount = source.debugAllocator->GetFailureCount();
+			usedSize = source.debugAllocator->GetUsedSize();
+			peakSize = source.debugAllocator->GetPeakSize();
+			peakSize = (usedSize > peakSize) ? usedSize : peakSize;
+		}
+		else
+		{
+			usedSize = source.allocator->GetMemoryUsage().usedSize;
+			peakSize = (usedSize > source.peakSize) ? usedSize : source.peakSize;
+		}
+		source.peakSize = peakSize;
+
+		std::uint64_t allocationRate = 0;
+		const std::int64_t elapsed = now - source.previousTime;
+		if (elapsed > 0 && allocationCount >= source.previousAllocationCount)
+		{
+			allocationRate = static_cast<std::uint64_t>(static_cast<double>(allocationCount - source.previousAllocationCount) * 1e9 / static_cast<double>(elapsed));
+		}
+		source.previousAllocationCount = allocationCount;
+		source.previousTime = now;
+
+		SharedEntry& entry = mEntries[i];
+		const std::uint64_t sequence = entry.sequence.load(std::memory_order_relaxed);
+		entry.sequence.store(sequence + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		entry.usedSize.store(usedSize, std::memory_order_relaxed);
+		entry.peakSize.store(peakSize, std::memory_order_relaxed);
+		entry.allocationCount.store(allocationCount, std::memory_order_relaxed);
+		entry.deallocationCount.store(deallocationCount, std::memory_order_relaxed);
+		entry.failureCount.store(failureCount, std::memory_order_relaxed);
+		entry.allocationRate.store(allocationRate, std::memory_order_relaxed);
+		entry.timestamp.store(timestamp, std::memory_order_relaxed);
+		entry.sequence.store(sequence + 2, std::memory_order_release);
+	}
+}
+
+void StatsRegistry::RunPublisher()
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	while (!mStopCondition.wait_for(lock, std::chrono::milliseconds(mSettings.publishIntervalMs), [this]() { return mStopping; }))
+	{
+		PublishSources();
+	}
 }
 
 } // namespace dyma
\ No newline at end of file
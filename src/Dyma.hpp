@@ -2,6 +2,21 @@
 
 #include <cstddef> // size_t
 #include <cstdint> // uintptr_t
+#include <cassert> // assert
+#include <atomic> // std::atomic
+#include <condition_variable> // std::condition_variable
+#include <cstdio> // std::FILE
+#include <mutex> // std::mutex
+#include <thread> // std::thread::id
+#include <type_traits> // std::is_trivially_copyable
+#include <vector> // std::vector
+
+#if defined(DYMA_HOOKS) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h> // DTRACE_PROBE
+#define DYMA_USDT
+#endif
+#endif
 
 namespace dyma
 {
@@ -14,6 +29,9 @@ void Free(void* ptr);
 void* AlignedMalloc(std::size_t size, std::size_t alignment);
 void AlignedFree(void* ptr);
 std::size_t RoundToAlignment(std::size_t size, std::size_t alignment);
+std::size_t GetCpuCount(); // Greater than the id of any CPU that can be online
+std::size_t GetCurrentCpu();
+std::size_t GetCurrentThreadIndex();
 
 // Memory source to feed an allocator with
 class MemorySource
@@ -108,6 +126,43 @@ private:
 	std::size_t mAlignment;
 };
 
+// Memory reserved from the virtual address space, pages are only committed by the OS when touched
+class VirtualMemory : public MemorySource
+{
+public:
+	VirtualMemory(std::size_t bytes, std::size_t alignment = alignof(std::max_align_t));
+	~VirtualMemory();
+
+	const void* GetPointer() const override final;
+	std::size_t GetSize() const override final;
+	std::size_t GetAlignment() const override final;
+
+	// NonCopyable
+	VirtualMemory(const VirtualMemory& other) = delete;
+	VirtualMemory& operator=(const VirtualMemory& other) = delete;
+
+	// NonMovable
+	VirtualMemory(VirtualMemory&& other) = delete;
+	VirtualMemory& operator=(VirtualMemory&& other) = delete;
+
+private:
+	void* mMemory;
+	std::size_t mSize;
+	std::size_t mAlignment;
+};
+
+// Memory usage of an allocator, composite allocators sum the usage of their children
+struct MemoryUsage
+{
+	std::size_t usedSize = 0; // Bytes given to blocks, with their rounding and headers
+	std::size_t freeSize = 0; // Bytes that can still be allocated
+	std::size_t largestFreeBlock = 0; // Largest block that can be allocated at once
+	std::size_t wastedSize = 0; // Used bytes that weren't requested (rounding, block-size mismatch, headers) and bytes that can never be allocated
+	std::size_t freeBlockCount = 0; // Free blocks, or free contiguous ranges
+
+	void Add(const MemoryUsage& other);
+};
+
 // Allocator
 class Allocator
 {
@@ -118,11 +173,89 @@ public:
 	virtual bool Deallocate(void*& ptr) = 0;
 	virtual bool Owns(const void* ptr) const = 0;
 
+	// Memory source all the blocks come from, nullptr if there isn't a single one
+	// A source never moves, so checking its range is lock-free and is the same as Owns()
+	virtual const MemorySource* GetSource() const;
+
+	// Whether Allocate(), Deallocate() and Owns() can be called from several threads at once
+	virtual bool IsThreadSafe() const;
+
+	// Zero for allocators that can't know their usage, like Mallocator
+	// Allocators freeing blocks one by one without knowing their requested size only reset their waste once they are empty, so it is an upper bound
+	virtual MemoryUsage GetMemoryUsage() const;
+
 	// NonCopyable
 	Allocator(const Allocator& other) = delete;
 	Allocator& operator=(const Allocator& other) = delete;
 };
 
+#if defined(DYMA_HOOKS)
+
+// AllocationHooks : Callbacks receiving the events of the allocators handing out the blocks, the allocators built on top of them don't emit any
+// Only the blocks deallocated one by one are events, not the ones released at once by markers, frames or DeallocateAll()
+// The same events are USDT probes dyma:allocate, dyma:deallocate and dyma:failure when sys/sdt.h is available, for bpftrace or perf
+struct AllocationHooks
+{
+	void (*onAllocate)(void* userData, const Allocator& allocator, void* ptr, std::size_t size) = nullptr;
+	void (*onDeallocate)(void* userData, const Allocator& allocator, void* ptr) = nullptr;
+	void (*onFailure)(void* userData, const Allocator& allocator, std::size_t size) = nullptr;
+	void* userData = nullptr;
+};
+
+// The hooks must stay alive until no event is in flight anymore once they are replaced, nullptr removes them
+void SetAllocationHooks(const AllocationHooks* hooks);
+const AllocationHooks* GetAllocationHooks();
+
+inline std::atomic<const AllocationHooks*> gAllocationHooks(nullptr);
+
+inline void EmitAllocationEvent(const Allocator& allocator, void* ptr, std::size_t size)
+{
+	const AllocationHooks* hooks = gAllocationHooks.load(std::memory_order_acquire);
+	if (ptr != nullptr)
+	{
+#if defined(DYMA_USDT)
+		DTRACE_PROBE3(dyma, allocate, &allocator, ptr, size);
+#endif
+		if (hooks != nullptr && hooks->onAllocate != nullptr)
+		{
+			hooks->onAllocate(hooks->userData, allocator, ptr, size);
+		}
+	}
+	else if (size > 0)
+	{
+#if defined(DYMA_USDT)
+		DTRACE_PROBE2(dyma, failure, &allocator, size);
+#endif
+		if (hooks != nullptr && hooks->onFailure != nullptr)
+		{
+			hooks->onFailure(hooks->userData, allocator, size);
+		}
+	}
+}
+
+inline void EmitDeallocationEvent(const Allocator& allocator, void* ptr)
+{
+#if defined(DYMA_USDT)
+	DTRACE_PROBE2(dyma, deallocate, &allocator, ptr);
+#endif
+	const AllocationHooks* hooks = gAllocationHooks.load(std::memory_order_acquire);
+	if (hooks != nullptr && hooks->onDeallocate != nullptr)
+	{
+		hooks->onDeallocate(hooks->userData, allocator, ptr);
+	}
+}
+
+// An allocation returning nullptr is a failure
+#define DYMA_HOOK_ALLOCATE(allocator, ptr, size) ::dyma::EmitAllocationEvent(allocator, ptr, size)
+#define DYMA_HOOK_DEALLOCATE(allocator, ptr) ::dyma::EmitDeallocationEvent(allocator, ptr)
+
+#else
+
+#define DYMA_HOOK_ALLOCATE(allocator, ptr, size) ((void)0)
+#define DYMA_HOOK_DEALLOCATE(allocator, ptr) ((void)0)
+
+#endif // DYMA_HOOKS
+
 // Null allocator
 class NullAllocator : public Allocator
 {
@@ -132,6 +265,7 @@ public:
 	void* Allocate(std::size_t size) override;
 	bool Deallocate(void*& ptr) override;
 	bool Owns(const void* ptr) const override;
+	bool IsThreadSafe() const override;
 };
 
 // Forbidden allocator : Every allocation/deallocation will assert()
@@ -143,6 +277,7 @@ public:
 	void* Allocate(std::size_t size) override;
 	bool Deallocate(void*& ptr) override;
 	bool Owns(const void* ptr) const override;
+	bool IsThreadSafe() const override;
 };
 
 // Mallocator : Malloc/Free allocator
@@ -155,6 +290,7 @@ public:
 	void* Allocate(std::size_t size) override;
 	bool Deallocate(void*& ptr) override;
 	bool Owns(const void* ptr) const override;
+	bool IsThreadSafe() const override;
 };
 
 // StackAllocator : Allocator with a stack mechanism
@@ -162,12 +298,19 @@ public:
 class StackAllocator : public Allocator
 {
 public:
+	using Marker = std::uintptr_t;
+
 	StackAllocator(MemorySource& source);
+	~StackAllocator();
 
 	void* Allocate(std::size_t size) override;
 	bool Deallocate(void*& ptr) override;
 	bool Owns(const void* ptr) const override;
+	const MemorySource* GetSource() const override;
+	MemoryUsage GetMemoryUsage() const override;
 
+	Marker GetMarker() const;
+	void FreeToMarker(Marker marker);
 	void DeallocateAll();
 
 	std::size_t GetUsedSize() const;
@@ -178,6 +321,417 @@ public:
 protected:
 	MemorySource& mSource;
 	std::uintptr_t mPointer;
+	std::size_t mWastedSize;
+};
+
+// ScopedArena : Frees everything allocated from a StackAllocator since its construction when going out of scope
+class ScopedArena : public Allocator
+{
+public:
+	ScopedArena(StackAllocator& allocator);
+	~ScopedArena();
+
+	void* Allocate(std::size_t size) override;
+	bool Deallocate(void*& ptr) override;
+	bool Owns(const void* ptr) const override;
+	const MemorySource* GetSource() const override;
+	MemoryUsage GetMemoryUsage() const override;
+
+	StackAllocator& GetAllocator() const;
+	StackAllocator::Marker GetMarker() const;
+
+private:
+	StackAllocator& mAllocator;
+	StackAllocator::Marker mMarker;
+};
+
+// Per-thread scratch arenas : Every thread has two StackAllocators for temporary allocations
+// Pass the allocator your caller gave you as conflict, so nested scratch arenas never share the same stack
+ScopedArena GetScratchArena(const Allocator* conflict = nullptr);
+
+// Size and backing of the scratch arenas, only applies to threads that haven't used them yet
+void SetScratchArenaSize(std::size_t bytes, bool useVirtualMemory = true);
+std::size_t GetScratchArenaSize();
+
+// Leak reports : the allocators handing out blocks one by one from a source write the blocks they still hand out when destroyed
+// They only know how many blocks or bytes that is, a DebugAllocator capturing the call sites tells where the blocks come from
+// nullptr, the default, disables the reports of these allocators
+void SetLeakReportFile(std::FILE* file);
+std::FILE* GetLeakReportFile();
+
+// ConcurrentLinearAllocator : Thread-safe StackAllocator, allocating is a single atomic add on the stack pointer
+// Blocks can't be deallocated one by one, they are all released by DeallocateAll(), which isn't thread-safe
+class ConcurrentLinearAllocator : public Allocator
+{
+public:
+	ConcurrentLinearAllocator(MemorySource& source);
+
+	void* Allocate(std::size_t size) override;
+	bool Deallocate(void*& ptr) override;
+	bool Owns(const void* ptr) const override;
+	const MemorySource* GetSource() const override;
+	bool IsThreadSafe() const override;
+	MemoryUsage GetMemoryUsage() const override;
+
+	void DeallocateAll();
+
+	std::size_t GetUsedSize() const;
+	std::size_t GetRemainingSize() const;
+	std::size_t GetSize() const;
+	std::size_t GetAlignment() const;
+
+protected:
+	MemorySource& mSource;
+	std::atomic<std::size_t> mOffset;
+	std::atomic<std::size_t> mWastedSize;
+};
+
+// TaskArenaAllocator : Splits a memory source into one stack per worker thread of a job system
+// A task allocates from the arena of the worker running it, so a stolen task uses the arena of its thief
+// Blocks can't be deallocated one by one, every arena is released by DeallocateAll() once the task graph completed
+class TaskArenaAllocator : public Allocator
+{
+public:
+	static constexpr std::size_t NoWorker = static_cast<std::size_t>(-1);
+
+	TaskArenaAllocator(MemorySource& source, std::size_t workerCount);
+	~TaskArenaAllocator();
+
+	void* Allocate(std::size_t size) override;
+	bool Deallocate(void*& ptr) override;
+	bool Owns(const void* ptr) const override;
+	const MemorySource* GetSource() const override;
+	bool IsThreadSafe() const override;
+	MemoryUsage GetMemoryUsage() const override;
+
+	void DeallocateAll();
+
+	// Each worker thread of the job system should declare its index once, shared by every TaskArenaAllocator
+	static void SetCurrentWorker(std::size_t workerIndex);
+	static std::size_t GetCurrentWorker();
+
+	std::size_t GetWorkerCount() const;
+	std::size_t GetArenaSize() const;
+	std::size_t GetUsedSize(std::size_t workerIndex) const;
+	std::size_t GetUsedSize() const;
+
+	// NonCopyable
+	TaskArenaAllocator(const TaskArenaAllocator& other) = delete;
+	TaskArenaAllocator& operator=(const TaskArenaAllocator& other) = delete;
+
+protected:
+	// Arenas don't share cache lines
+	struct alignas(64) Arena
+	{
+		std::uintptr_t begin;
+		std::uintptr_t pointer;
+		std::size_t wastedSize;
+	};
+
+	MemorySource& mSource;
+	Arena* mArenas;
+	std::size_t mWorkerCount;
+	std::size_t mArenaSize;
+};
+
+// DoubleEndedStackAllocator : Two stacks growing toward each other in the same memory source
+// Allocate() uses the bottom stack, meant for long-lived data, AllocateTop() is meant for transient data
+// Top blocks are released together with FreeToTopMarker() or DeallocateTop(), Deallocate() on one of them only clears the pointer
+class DoubleEndedStackAllocator : public Allocator
+{
+public:
+	using Marker = std::uintptr_t;
+
+	DoubleEndedStackAllocator(MemorySource& source);
+	~DoubleEndedStackAllocator();
+
+	void* Allocate(std::size_t size) override;
+	bool Deallocate(void*& ptr) override;
+	bool Owns(const void* ptr) const override;
+	const MemorySource* GetSource() const override;
+	MemoryUsage GetMemoryUsage() const override;
+
+	void* AllocateBottom(std::size_t size);
+	void* AllocateTop(std::size_t size);
+
+	Marker GetBottomMarker() const;
+	Marker GetTopMarker() const;
+	void FreeToBottomMarker(Marker marker);
+	void FreeToTopMarker(Marker marker);
+
+	void DeallocateBottom();
+	void DeallocateTop();
+	void DeallocateAll();
+
+	std::size_t GetBottomUsedSize() const;
+	std::size_t GetTopUsedSize() const;
+	std::size_t GetUsedSize() const;
+	std::size_t GetRemainingSize() const;
+	std::size_t GetSize() const;
+	std::size_t GetAlignment() const;
+
+protected:
+	MemorySource& mSource;
+	std::uintptr_t mBottom;
+	std::uintptr_t mTop;
+	std::size_t mWastedSize;
+};
+
+// RingAllocator : Allocates contiguous blocks in a circular buffer, wrapping around the end of the memory source
+// Blocks should be freed roughly in allocation order, a block freed early is reclaimed once every older block is freed
+class RingAllocator : public Allocator
+{
+public:
+	RingAllocator(MemorySource& source);
+	~RingAllocator();
+
+	void* Allocate(std::size_t size) override;
+	bool Deallocate(void*& ptr) override;
+	bool Owns(const void* ptr) const override;
+	const MemorySource* GetSource() const override;
+	MemoryUsage GetMemoryUsage() const override;
+
+	void DeallocateAll();
+
+	std::size_t GetUsedSize() const;
+	std::size_t GetRemainingSize() const;
+	std::size_t GetSize() const;
+	std::size_t GetAlignment() const;
+
+protected:
+	struct BlockHeader
+	{
+		std::size_t size;
+		std::size_t freed;
+	};
+
+	BlockHeader* GetHeader(std::size_t offset) const;
+	void ReclaimFreedBlocks();
+
+	MemorySource& mSource;
+	std::size_t mHeaderSize;
+	std::size_t mHead;
+	std::size_t mTail;
+	std::size_t mUsedSize;
+	std::size_t mWastedSize;
+};
+
+// FrameAllocator : Splits a memory source into stacks, one for each of the FrameCount frames in flight
+// BeginFrame() starts recording the next frame, EndFrame() hands it to the consumer
+// The memory of a frame is only reused once the consumer called ReleaseFrame(), which can be done from another thread
+template <std::size_t FrameCount>
+class FrameAllocator : public Allocator
+{
+public:
+	static_assert(FrameCount > 0, "FrameAllocator needs at least one frame");
+
+	FrameAllocator(MemorySource& source)
+		: mSource(source)
+		, mFrameSize(0)
+		, mFrameNumber(0)
+		, mRecording(false)
+	{
+		const std::size_t alignment = mSource.GetAlignment();
+		mFrameSize = mSource.GetSize() / FrameCount;
+		if (alignment > 0)
+		{
+			mFrameSize -= mFrameSize % alignment;
+		}
+		for (std::size_t i = 0; i < FrameCount; ++i)
+		{
+			mFrames[i].begin = reinterpret_cast<std::uintptr_t>(mSource.GetPointer()) + i * mFrameSize;
+			mFrames[i].pointer = mFrames[i].begin;
+			mFrames[i].highWater = 0;
+			mFrames[i].wastedSize = 0;
+			mFrames[i].inFlightNumber.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	void* Allocate(std::size_t size) override
+	{
+		void* ptr = nullptr;
+		if (mRecording)
+		{
+			Frame& frame = GetFrame(mFrameNumber - 1);
+			const std::size_t alignedSize = RoundToAlignment(size, mSource.GetAlignment());
+			if (size > 0 && alignedSize <= frame.begin + mFrameSize - frame.pointer)
+			{
+				ptr = reinterpret_cast<void*>(frame.pointer);
+				frame.pointer += alignedSize;
+				frame.wastedSize += alignedSize - size;
+			}
+		}
+		DYMA_HOOK_ALLOCATE(*this, ptr, size);
+		return ptr;
+	}
+
+	bool Deallocate(void*& ptr) override
+	{
+		// You should only deallocate the last allocated block of the current frame
+		if (mRecording && ptr != nullptr)
+		{
+			Frame& frame = GetFrame(mFrameNumber - 1);
+			const std::uintptr_t address = reinterpret_cast<std::uintptr_t>(ptr);
+			if (frame.begin <= address && address < frame.pointer)
+			{
+				UpdateHighWater(frame);
+				frame.pointer = address;
+				DYMA_HOOK_DEALLOCATE(*this, ptr);
+				ptr = nullptr;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool Owns(const void* ptr) const override
+	{
+		return mSource.Owns(ptr);
+	}
+
+	const MemorySource* GetSource() const override
+	{
+		return &mSource;
+	}
+
+	// Frames in flight are entirely used until they are released, their unused end being wasted
+	MemoryUsage GetMemoryUsage() const override
+	{
+		MemoryUsage usage;
+		usage.wastedSize = mSource.GetSize() - FrameCount * mFrameSize;
+		for (std::size_t i = 0; i < FrameCount; ++i)
+		{
+			const Frame& frame = mFrames[i];
+			const std::size_t usedSize = frame.pointer - frame.begin;
+			std::size_t freeSize = mFrameSize;
+			if (frame.inFlightNumber.load(std::memory_order_acquire) != 0)
+			{
+				usage.usedSize += mFrameSize;
+				usage.wastedSize += frame.wastedSize + mFrameSize - usedSize;
+				freeSize = 0;
+			}
+			else if (mRecording && &frame == &GetFrame(mFrameNumber - 1))
+			{
+				usage.usedSize += usedSize;
+				usage.wastedSize += frame.wastedSize;
+				freeSize = mFrameSize - usedSize;
+			}
+			if (freeSize > 0)
+			{
+				usage.freeSize += freeSize;
+				usage.largestFreeBlock = (freeSize > usage.largestFreeBlock) ? freeSize : usage.largestFreeBlock;
+				usage.freeBlockCount++;
+			}
+		}
+		return usage;
+	}
+
+	// Returns false if the memory of the next frame is still in flight
+	bool BeginFrame()
+	{
+		assert(!mRecording);
+		Frame& frame = GetFrame(mFrameNumber);
+		if (frame.inFlightNumber.load(std::memory_order_acquire) != 0)
+		{
+			return false;
+		}
+		frame.pointer = frame.begin;
+		frame.wastedSize = 0;
+		mRecording = true;
+		mFrameNumber++;
+		return true;
+	}
+
+	// Returns the number of the frame, to give back to ReleaseFrame() once the consumer is done with it
+	std::uint64_t EndFrame()
+	{
+		assert(mRecording);
+		const std::uint64_t frameNumber = mFrameNumber - 1;
+		Frame& frame = GetFrame(frameNumber);
+		UpdateHighWater(frame);
+		frame.inFlightNumber.store(frameNumber + 1, std::memory_order_release);
+		mRecording = false;
+		return frameNumber;
+	}
+
+	// Returns false if the frame isn't in flight, a late or repeated release never frees a newer frame of the same slot
+	bool ReleaseFrame(std::uint64_t frameNumber)
+	{
+		std::uint64_t inFlightNumber = frameNumber + 1;
+		return GetFrame(frameNumber).inFlightNumber.compare_exchange_strong(inFlightNumber, 0, std::memory_order_release, std::memory_order_relaxed);
+	}
+
+	bool IsFrameInFlight(std::uint64_t frameNumber) const
+	{
+		return GetFrame(frameNumber).inFlightNumber.load(std::memory_order_acquire) == frameNumber + 1;
+	}
+
+	bool IsRecording() const { return mRecording; }
+	std::uint64_t GetFrameNumber() const { return mFrameNumber; }
+	std::size_t GetFrameCount() const { return FrameCount; }
+	std::size_t GetFrameSize() const { return mFrameSize; }
+
+	std::size_t GetUsedSize() const
+	{
+		if (mRecording)
+		{
+			const Frame& frame = GetFrame(mFrameNumber - 1);
+			return frame.pointer - frame.begin;
+		}
+		return 0;
+	}
+
+	// Peak usage of the frames recorded in the given slot
+	std::size_t GetFrameHighWater(std::size_t slot) const
+	{
+		assert(slot < FrameCount);
+		const Frame& frame = mFrames[slot];
+		const std::size_t used = frame.pointer - frame.begin;
+		return (used > frame.highWater) ? used : frame.highWater;
+	}
+
+	// Peak usage of every frame recorded so far
+	std::size_t GetHighWater() const
+	{
+		std::size_t highWater = 0;
+		for (std::size_t i = 0; i < FrameCount; ++i)
+		{
+			const std::size_t frameHighWater = GetFrameHighWater(i);
+			if (frameHighWater > highWater)
+			{
+				highWater = frameHighWater;
+			}
+		}
+		return highWater;
+	}
+
+private:
+	struct Frame
+	{
+		std::uintptr_t begin;
+		std::uintptr_t pointer;
+		std::size_t highWater;
+		std::size_t wastedSize;
+		std::atomic<std::uint64_t> inFlightNumber; // Number of the frame in flight + 1, 0 once released
+	};
+
+	Frame& GetFrame(std::uint64_t frameNumber) { return mFrames[frameNumber % FrameCount]; }
+	const Frame& GetFrame(std::uint64_t frameNumber) const { return mFrames[frameNumber % FrameCount]; }
+
+	void UpdateHighWater(Frame& frame)
+	{
+		const std::size_t used = frame.pointer - frame.begin;
+		if (used > frame.highWater)
+		{
+			frame.highWater = used;
+		}
+	}
+
+	MemorySource& mSource;
+	Frame mFrames[FrameCount];
+	std::size_t mFrameSize;
+	std::uint64_t mFrameNumber;
+	bool mRecording;
 };
 
 // PoolAllocator : Allocator specialized for same sized-blocks
@@ -186,10 +740,13 @@ class PoolAllocator : public Allocator
 {
 public:
 	PoolAllocator(MemorySource& source, std::size_t blockSize);
+	~PoolAllocator();
 
 	void* Allocate(std::size_t size) override;
 	bool Deallocate(void*& ptr) override;
 	bool Owns(const void* ptr) const override;
+	const MemorySource* GetSource() const override;
+	MemoryUsage GetMemoryUsage() const override;
 
 	std::size_t GetBlockSize() const;
 	std::size_t GetBlockCount() const;
@@ -206,6 +763,90 @@ protected:
 	std::size_t mBlockSize;
 };
 
+// ConcurrentPoolAllocator : Thread-safe PoolAllocator, the free list is a lock-free stack
+// The head of the stack packs the block index with a tag incremented on every change to prevent the ABA problem
+// The block size should be greater than or equals to the size of a pointer, and there should be less than 2^32 blocks
+class ConcurrentPoolAllocator : public Allocator
+{
+public:
+	ConcurrentPoolAllocator(MemorySource& source, std::size_t blockSize);
+	~ConcurrentPoolAllocator();
+
+	void* Allocate(std::size_t size) override;
+	bool Deallocate(void*& ptr) override;
+	bool Owns(const void* ptr) const override;
+	const MemorySource* GetSource() const override;
+	bool IsThreadSafe() const override;
+	MemoryUsage GetMemoryUsage() const override;
+
+	std::size_t GetBlockSize() const;
+	std::size_t GetBlockCount() const;
+	std::size_t GetSize() const;
+
+protected:
+	struct Node
+	{
+		std::atomic<Node*> next;
+	};
+
+	Node* GetNode(std::uint64_t head) const;
+	std::uint64_t MakeHead(const Node* node, std::uint64_t previousHead) const;
+
+	MemorySource& mSource;
+	std::atomic<std::uint64_t> mHead;
+	std::atomic<std::size_t> mFreeCount;
+	std::size_t mBlockSize;
+};
+
+// GrowablePoolAllocator : Pool of same sized-blocks getting chunks of blocks from an upstream allocator when it runs out of blocks
+// A chunk is given back to the upstream allocator as soon as all its blocks are free
+// Finding the chunk of a block is linear in the number of chunks, so chunks should hold a fair amount of blocks
+class GrowablePoolAllocator : public Allocator
+{
+public:
+	GrowablePoolAllocator(Allocator& upstream, std::size_t blockSize, std::size_t blocksPerChunk);
+	~GrowablePoolAllocator();
+
+	void* Allocate(std::size_t size) override;
+	bool Deallocate(void*& ptr) override;
+	bool Owns(const void* ptr) const override;
+	MemoryUsage GetMemoryUsage() const override;
+
+	std::size_t GetBlockSize() const;
+	std::size_t GetBlocksPerChunk() const;
+	std::size_t GetChunkSize() const;
+	std::size_t GetChunkCount() const;
+
+protected:
+	struct Node
+	{
+		Node* next;
+	};
+
+	// Chunks with free blocks are kept before the full ones
+	struct Chunk
+	{
+		Chunk* previous;
+		Chunk* next;
+		Node* rootNode;
+		std::size_t freeCount;
+	};
+
+	Chunk* CreateChunk();
+	Chunk* FindChunk(const void* ptr) const;
+	void LinkFront(Chunk* chunk);
+	void LinkBack(Chunk* chunk);
+	void Unlink(Chunk* chunk);
+
+	Allocator& mUpstream;
+	Chunk* mFirstChunk;
+	Chunk* mLastChunk;
+	std::size_t mBlockSize;
+	std::size_t mBlocksPerChunk;
+	std::size_t mChunkHeaderSize;
+	std::size_t mChunkCount;
+};
+
 // FallbackAllocator : Try the primary allocator, then the secondary if the primary failed
 class FallbackAllocator : public Allocator
 {
@@ -215,6 +856,8 @@ public:
 	void* Allocate(std::size_t size) override;
 	bool Deallocate(void*& ptr) override;
 	bool Owns(const void* ptr) const override;
+	bool IsThreadSafe() const override;
+	MemoryUsage GetMemoryUsage() const override;
 
 protected:
 	Allocator& mPrimary;
@@ -230,6 +873,8 @@ public:
 	void* Allocate(std::size_t size) override;
 	bool Deallocate(void*& ptr) override;
 	bool Owns(const void* ptr) const override;
+	bool IsThreadSafe() const override;
+	MemoryUsage GetMemoryUsage() const override;
 
 	std::size_t GetThreshold() const;
 
@@ -239,4 +884,1211 @@ private:
 	std::size_t mThreshold;
 };
 
+// LockedAllocator : Makes an allocator thread-safe by using it behind a lock, the lock is skipped if the allocator is already thread-safe
+// Owns() checks the range of the memory source of the allocator without lock when it has one
+// Aligned on a cache line, so the locks of the children of a composite allocator aren't shared
+class alignas(64) LockedAllocator : public Allocator
+{
+public:
+	LockedAllocator(Allocator& allocator);
+
+	void* Allocate(std::size_t size) override;
+	bool Deallocate(void*& ptr) override;
+	bool Owns(const void* ptr) const override;
+	const MemorySource* GetSource() const override;
+	bool IsThreadSafe() const override;
+	MemoryUsage GetMemoryUsage() const override;
+
+	Allocator& GetAllocator() const;
+
+private:
+	Allocator& mAllocator;
+	bool mThreadSafe;
+	mutable std::mutex mMutex;
+};
+
+// ConcurrentFallbackAllocator : Thread-safe FallbackAllocator, each allocator is used behind its own LockedAllocator
+// Only the allocator serving the request is locked, as long as the primary has a memory source or is thread-safe
+class ConcurrentFallbackAllocator : public Allocator
+{
+public:
+	ConcurrentFallbackAllocator(Allocator& primaryAllocator, Allocator& secondaryAllocator);
+
+	void* Allocate(std::size_t size) override;
+	bool Deallocate(void*& ptr) override;
+	bool Owns(const void* ptr) const override;
+	bool IsThreadSafe() const override;
+	MemoryUsage GetMemoryUsage() const override;
+
+protected:
+	LockedAllocator mPrimary;
+	LockedAllocator mSecondary;
+};
+
+// ConcurrentSegregatorAllocator : Thread-safe SegregatorAllocator, each allocator is used behind its own LockedAllocator
+// Only the allocator serving the request is locked, as long as the smaller allocator has a memory source or is thread-safe
+class ConcurrentSegregatorAllocator : public Allocator
+{
+public:
+	ConcurrentSegregatorAllocator(std::size_t threshold, Allocator& smaller, Allocator& larger);
+
+	void* Allocate(std::size_t size) override;
+	bool Deallocate(void*& ptr) override;
+	bool Owns(const void* ptr) const override;
+	bool IsThreadSafe() const override;
+	MemoryUsage GetMemoryUsage() const override;
+
+	std::size_t GetThreshold() const;
+
+private:
+	LockedAllocator mSmallerAllocator;
+	LockedAllocator mLargerAllocator;
+	std::size_t mThreshold;
+};
+
+// ThreadLocalSlots : One slot per thread and per instance, created on the first Get() of each thread
+// A slot is released on the thread exit, or by the destructor for the threads still alive
+class ThreadLocalSlots
+{
+public:
+	using CreateFunction = void* (*)(void* userData);
+	using ReleaseFunction = void (*)(void* userData, void* slot);
+	using VisitFunction = void (*)(void* context, void* slot);
+
+	ThreadLocalSlots(CreateFunction create, ReleaseFunction release, void* userData);
+	~ThreadLocalSlots();
+
+	void* Get();
+
+	// Visits the slots of every thread, slots can't be created or released meanwhile
+	void ForEach(VisitFunction visit, void* context) const;
+
+	// NonCopyable
+	ThreadLocalSlots(const ThreadLocalSlots& other) = delete;
+	ThreadLocalSlots& operator=(const ThreadLocalSlots& other) = delete;
+
+private:
+	friend struct ThreadLocalSlotsRegistry;
+	struct Entry;
+
+	CreateFunction mCreate;
+	ReleaseFunction mRelease;
+	void* mUserData;
+	std::uint64_t mId;
+	Entry* mEntries;
+};
+
+// ThreadCachingAllocator : Keeps per-thread lists of free blocks for each size class in front of an upstream allocator
+// Blocks carry a small header holding their size class, the upstream allocator receives the size of the class plus the header
+// A PoolAllocator upstream must then have blocks of GetSizeClass(i) + GetHeaderSize() bytes and serves that class only, use a SegregatorAllocator of such pools for several classes
+// The upstream allocator is only used under a lock, by batches, so it doesn't need to be thread-safe
+// Deallocate() rejects the blocks out of the source of the upstream allocator, without a source only the blocks whose header isn't a size class
+class ThreadCachingAllocator : public Allocator
+{
+public:
+	struct Settings
+	{
+		std::size_t maxCachedSize = 256; // Larger blocks aren't cached
+		std::size_t batchSize = 32; // Blocks moved from/to the upstream allocator at once
+		std::size_t maxCachedBlocks = 128; // Blocks a thread keeps for each size class before flushing a batch
+	};
+
+	ThreadCachingAllocator(Allocator& upstream);
+	ThreadCachingAllocator(Allocator& upstream, const Settings& settings);
+
+	void* Allocate(std::size_t size) override;
+	bool Deallocate(void*& ptr) override;
+	bool Owns(const void* ptr) const override;
+	const MemorySource* GetSource() const override;
+	bool IsThreadSafe() const override;
+	MemoryUsage GetMemoryUsage() const override;
+
+	// Gives the blocks cached by the calling thread back to the upstream allocator
+	void Flush();
+
+	const Settings& GetSettings() const;
+	std::size_t GetSizeClassCount() const;
+	std::size_t GetSizeClass(std::size_t index) const;
+	std::size_t GetHeaderSize() const; // Added to the size of the class by the upstream allocations
+
+protected:
+	static constexpr std::size_t MaxSizeClassCount = 16;
+
+	struct Node
+	{
+		Node* next;
+	};
+
+	struct Bin
+	{
+		Node* rootNode;
+		std::size_t count;
+	};
+
+	struct ThreadCache
+	{
+		Bin bins[MaxSizeClassCount];
+	};
+
+	static void* CreateCache(void* allocator);
+	static void ReleaseCache(void* allocator, void* cache);
+
+	std::size_t GetSizeClassIndex(std::size_t size) const;
+	// False for the blocks that can't come from this allocator, mSizeClassCount for the blocks too large to be cached
+	bool ReadSizeClassIndex(const void* ptr, std::size_t& classIndex) const;
+	void* AllocateFromUpstream(std::size_t size, std::size_t classIndex);
+	bool DeallocateToUpstream(void* ptr);
+	bool Refill(Bin& bin, std::size_t classIndex);
+	void FlushBin(Bin& bin, std::size_t count);
+
+	Allocator& mUpstream;
+	Settings mSettings;
+	std::size_t mHeaderSize;
+	std::size_t mSizeClassCount;
+	mutable std::mutex mUpstreamMutex;
+	ThreadLocalSlots mCaches;
+};
+
+// CpuCachingAllocator : ThreadCachingAllocator keeping its caches per CPU instead of per thread, bounding their memory by the core count
+// On Linux x86-64, the caches are used in restartable sequences (rseq), which need no atomic instruction
+// Falls back to the per-thread caches of ThreadCachingAllocator when rseq isn't available
+class CpuCachingAllocator : public ThreadCachingAllocator
+{
+public:
+	CpuCachingAllocator(Allocator& upstream);
+	CpuCachingAllocator(Allocator& upstream, const Settings& settings);
+	~CpuCachingAllocator();
+
+	void* Allocate(std::size_t size) override;
+	bool Deallocate(void*& ptr) override;
+
+	bool UsesCpuCaches() const;
+	static bool IsRseqAvailable();
+
+	// NonCopyable
+	CpuCachingAllocator(const CpuCachingAllocator& other) = delete;
+	CpuCachingAllocator& operator=(const CpuCachingAllocator& other) = delete;
+
+protected:
+	void* PopFromCpu(std::size_t classIndex);
+	bool PushToCpu(std::size_t classIndex, void* ptr);
+
+	// Each CPU has a bin per size class, made of a block count followed by the blocks
+	std::uintptr_t* mCpuBins;
+	std::size_t mCpuCount; // CPUs with a higher id fall back to the per-thread caches
+	std::size_t mBinStride;
+	std::size_t mCpuStride;
+};
+
+// RemoteFreeAllocator : Gives a pool- or slab-style allocator to an owner thread, other threads can still deallocate its blocks
+// Deallocations from other threads are pushed on a lock-free queue, drained by the owner on its next allocation
+// The allocator should serve same sized-blocks of at least the size of a pointer, and its Owns() should be safe to call from any thread
+class RemoteFreeAllocator : public Allocator
+{
+public:
+	RemoteFreeAllocator(Allocator& allocator);
+	~RemoteFreeAllocator();
+
+	void* Allocate(std::size_t size) override;
+	bool Deallocate(void*& ptr) override;
+	bool Owns(const void* ptr) const override;
+	const MemorySource* GetSource() const override;
+	MemoryUsage GetMemoryUsage() const override;
+
+	// Gives the blocks freed by other threads back to the allocator, only from the owner thread
+	std::size_t DrainRemoteFrees();
+
+	// The owner is the thread which constructed the allocator, until changed
+	void SetOwnerThread();
+	bool IsOwnerThread() const;
+
+	// NonCopyable
+	RemoteFreeAllocator(const RemoteFreeAllocator& other) = delete;
+	RemoteFreeAllocator& operator=(const RemoteFreeAllocator& other) = delete;
+
+protected:
+	struct Node
+	{
+		Node* next;
+	};
+
+	Allocator& mAllocator;
+	std::atomic<std::thread::id> mOwnerThread;
+	std::atomic<Node*> mRemoteFrees;
+};
+
+// ShardedAllocator : Spreads the threads over ShardCount allocators, each one behind its own lock
+// A thread starts with the shard of its thread or CPU and tries the other ones if it fails, blocks go back to the shard owning them
+// Ownership is checked on the memory source of a shard without lock, a shard without memory source is locked to call its Owns()
+template <std::size_t ShardCount>
+class ShardedAllocator : public Allocator
+{
+public:
+	static_assert(ShardCount > 0, "ShardedAllocator needs at least one shard");
+
+	enum class ShardSelection
+	{
+		Thread,
+		Cpu
+	};
+
+	template <typename... Allocators>
+	ShardedAllocator(Allocators&... shards)
+		: mShardSelection(ShardSelection::Thread)
+	{
+		static_assert(sizeof...(Allocators) == ShardCount, "ShardedAllocator needs ShardCount allocators");
+		Allocator* allocators[] = { &shards... };
+		for (std::size_t i = 0; i < ShardCount; ++i)
+		{
+			mShards[i].allocator = allocators[i];
+		}
+	}
+
+	void* Allocate(std::size_t size) override
+	{
+		const std::size_t first = GetCurrentShardIndex();
+		for (std::size_t i = 0; i < ShardCount; ++i)
+		{
+			Shard& shard = mShards[(first + i) % ShardCount];
+			std::lock_guard<std::mutex> lock(shard.mutex);
+			void* ptr = shard.allocator->Allocate(size);
+			if (ptr != nullptr)
+			{
+				return ptr;
+			}
+		}
+		return nullptr;
+	}
+
+	bool Deallocate(void*& ptr) override
+	{
+		for (std::size_t i = 0; i < ShardCount; ++i)
+		{
+			Shard& shard = mShards[i];
+			if (ShardOwns(shard, ptr))
+			{
+				std::lock_guard<std::mutex> lock(shard.mutex);
+				return shard.allocator->Deallocate(ptr);
+			}
+		}
+		return false;
+	}
+
+	bool Owns(const void* ptr) const override
+	{
+		for (std::size_t i = 0; i < ShardCount; ++i)
+		{
+			if (ShardOwns(mShards[i], ptr))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool IsThreadSafe() const override
+	{
+		return true;
+	}
+
+	MemoryUsage GetMemoryUsage() const override
+	{
+		MemoryUsage usage;
+		for (std::size_t i = 0; i < ShardCount; ++i)
+		{
+			std::lock_guard<std::mutex> lock(mShards[i].mutex);
+			usage.Add(mShards[i].allocator->GetMemoryUsage());
+		}
+		return usage;
+	}
+
+	void SetShardSelection(ShardSelection shardSelection) { mShardSelection = shardSelection; }
+	ShardSelection GetShardSelection() const { return mShardSelection; }
+
+	std::size_t GetCurrentShardIndex() const
+	{
+		return ((mShardSelection == ShardSelection::Cpu) ? GetCurrentCpu() : GetCurrentThreadIndex()) % ShardCount;
+	}
+
+	std::size_t GetShardCount() const { return ShardCount; }
+	Allocator& GetShard(std::size_t index) const { return *mShards[index].allocator; }
+
+private:
+	// Shards don't share cache lines
+	struct alignas(64) Shard
+	{
+		Allocator* allocator;
+		mutable std::mutex mutex;
+	};
+
+	static bool ShardOwns(const Shard& shard, const void* ptr)
+	{
+		const MemorySource* source = shard.allocator->GetSource();
+		if (source != nullptr)
+		{
+			return source->Owns(ptr);
+		}
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		return shard.allocator->Owns(ptr);
+	}
+
+	Shard mShards[ShardCount];
+	ShardSelection mShardSelection;
+};
+
+// EpochAllocator : Defers deallocations until no thread can still read the blocks (epoch-based reclamation)
+// Readers of shared blocks should stay between Enter() and Exit(), or use an EpochGuard
+// A block deallocated during an epoch is given back to the allocator, by batches, once every reader moved two epochs further
+// The allocator is only used under a lock and its blocks should be at least of the size of a pointer
+class EpochAllocator : public Allocator
+{
+public:
+	EpochAllocator(Allocator& allocator, std::size_t batchSize = 64);
+	~EpochAllocator();
+
+	void* Allocate(std::size_t size) override;
+	bool Deallocate(void*& ptr) override;
+	bool Owns(const void* ptr) const override;
+	const MemorySource* GetSource() const override;
+	bool IsThreadSafe() const override;
+	MemoryUsage GetMemoryUsage() const override;
+
+	// Critical sections of the readers, they can be nested
+	void Enter();
+	void Exit();
+
+	// Tries to move to the next epoch and gives back the blocks nobody can read anymore
+	bool TryAdvanceEpoch();
+
+	std::uint64_t GetEpoch() const;
+	std::size_t GetBatchSize() const;
+
+	// NonCopyable
+	EpochAllocator(const EpochAllocator& other) = delete;
+	EpochAllocator& operator=(const EpochAllocator& other) = delete;
+
+protected:
+	static constexpr std::size_t BucketCount = 3;
+
+	struct Node
+	{
+		Node* next;
+	};
+
+	struct Bucket
+	{
+		Node* rootNode;
+		std::uint64_t epoch;
+	};
+
+	// The state holds the epoch seen by the thread, shifted by one, and whether it is in a critical section
+	struct ThreadRecord
+	{
+		std::atomic<std::uint64_t> state;
+		std::size_t nesting;
+		std::size_t retiredCount;
+		Bucket buckets[BucketCount];
+	};
+
+	static void* CreateRecord(void* allocator);
+	static void ReleaseRecord(void* allocator, void* record);
+
+	void FreeBucket(Bucket& bucket);
+	void FreeReclaimableBuckets(ThreadRecord& record, std::uint64_t epoch);
+
+	Allocator& mAllocator;
+	std::size_t mBatchSize;
+	std::atomic<std::uint64_t> mEpoch;
+	mutable std::mutex mAllocatorMutex;
+	Bucket mOrphans;
+	ThreadLocalSlots mRecords;
+};
+
+// EpochGuard : Stays in a critical section of an EpochAllocator while in scope
+class EpochGuard
+{
+public:
+	EpochGuard(EpochAllocator& allocator);
+	~EpochGuard();
+
+	// NonCopyable
+	EpochGuard(const EpochGuard& other) = delete;
+	EpochGuard& operator=(const EpochGuard& other) = delete;
+
+private:
+	EpochAllocator& mAllocator;
+};
+
+// PointerMap : Hash table from pointers to trivially copyable values, with open addressing and linear probing
+// Its slots are taken from its own allocator, so it can track the blocks of another allocator without recursing into it
+// Removing a pointer shifts the following slots back instead of leaving a tombstone, so lookups stay short
+template <typename Value>
+class PointerMap
+{
+public:
+	static_assert(std::is_trivially_copyable<Value>::value, "PointerMap only holds trivially copyable values");
+
+	PointerMap(Allocator& allocator)
+		: mAllocator(allocator)
+		, mSlots(nullptr)
+		, mCapacity(0)
+		, mSize(0)
+		, mShift(64)
+	{
+	}
+
+	~PointerMap()
+	{
+		void* slots = mSlots;
+		mAllocator.Deallocate(slots);
+	}
+
+	// Replaces the value of a pointer already in the map, returns false if the table couldn't grow
+	bool Insert(const void* key, const Value& value)
+	{
+		assert(key != nullptr);
+		if ((mSize + 1) * 4 > mCapacity * 3 && !Grow())
+		{
+			return false;
+		}
+		std::size_t index = GetIdealIndex(key);
+		while (mSlots[index].key != nullptr && mSlots[index].key != key)
+		{
+			index = (index + 1) & (mCapacity - 1);
+		}
+		if (mSlots[index].key == nullptr)
+		{
+			mSlots[index].key = key;
+			mSize++;
+		}
+		mSlots[index].value = value;
+		return true;
+	}
+
+	Value* Find(const void* key) const
+	{
+		const std::size_t index = FindIndex(key);
+		return (index < mCapacity) ? &mSlots[index].value : nullptr;
+	}
+
+	// The value is copied in value when it isn't null
+	bool Remove(const void* key, Value* value = nullptr)
+	{
+		std::size_t index = FindIndex(key);
+		if (index >= mCapacity)
+		{
+			return false;
+		}
+		if (value != nullptr)
+		{
+			*value = mSlots[index].value;
+		}
+		mSize--;
+
+		// Shifts back the next slots that can't be reached anymore from their ideal index
+		const std::size_t mask = mCapacity - 1;
+		std::size_t next = (index + 1) & mask;
+		while (mSlots[next].key != nullptr)
+		{
+			const std::size_t ideal = GetIdealIndex(mSlots[next].key);
+			if (((next - ideal) & mask) >= ((next - index) & mask))
+			{
+				mSlots[index] = mSlots[next];
+				index = next;
+			}
+			next = (next + 1) & mask;
+		}
+		mSlots[index].key = nullptr;
+		return true;
+	}
+
+	void Clear()
+	{
+		for (std::size_t i = 0; i < mCapacity; ++i)
+		{
+			mSlots[i].key = nullptr;
+		}
+		mSize = 0;
+	}
+
+	// Calls function(key, value) for every pointer of the map
+	template <typename Function>
+	void ForEach(Function function) const
+	{
+		for (std::size_t i = 0; i < mCapacity; ++i)
+		{
+			if (mSlots[i].key != nullptr)
+			{
+				function(mSlots[i].key, mSlots[i].value);
+			}
+		}
+	}
+
+	std::size_t GetSize() const { return mSize; }
+	std::size_t GetCapacity() const { return mCapacity; }
+
+	// NonCopyable
+	PointerMap(const PointerMap& other) = delete;
+	PointerMap& operator=(const PointerMap& other) = delete;
+
+private:
+	struct Slot
+	{
+		const void* key;
+		Value value;
+	};
+
+	static constexpr std::size_t MinCapacity = 16;
+
+	std::size_t GetIdealIndex(const void* key) const
+	{
+		// Fibonacci hashing, the high bits of the product are the best mixed ones
+		const std::uint64_t hash = static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(key)) * 0x9E3779B97F4A7C15ull;
+		return static_cast<std::size_t>(hash >> mShift);
+	}
+
+	std::size_t FindIndex(const void* key) const
+	{
+		if (mSize == 0 || key == nullptr)
+		{
+			return mCapacity;
+		}
+		std::size_t index = GetIdealIndex(key);
+		while (mSlots[index].key != nullptr)
+		{
+			if (mSlots[index].key == key)
+			{
+				return index;
+			}
+			index = (index + 1) & (mCapacity - 1);
+		}
+		return mCapacity;
+	}
+
+	bool Grow()
+	{
+		const std::size_t capacity = (mCapacity > 0) ? mCapacity * 2 : MinCapacity;
+		Slot* slots = static_cast<Slot*>(mAllocator.Allocate(capacity * sizeof(Slot)));
+		if (slots == nullptr)
+		{
+			return false;
+		}
+		for (std::size_t i = 0; i < capacity; ++i)
+		{
+			slots[i].key = nullptr;
+		}
+
+		Slot* oldSlots = mSlots;
+		const std::size_t oldCapacity = mCapacity;
+		mSlots = slots;
+		mCapacity = capacity;
+		mShift--;
+		while ((std::size_t(1) << (64 - mShift)) < mCapacity)
+		{
+			mShift--;
+		}
+		for (std::size_t i = 0; i < oldCapacity; ++i)
+		{
+			if (oldSlots[i].key != nullptr)
+			{
+				std::size_t index = GetIdealIndex(oldSlots[i].key);
+				while (mSlots[index].key != nullptr)
+				{
+					index = (index + 1) & (mCapacity - 1);
+				}
+				mSlots[index] = oldSlots[i];
+			}
+		}
+		void* oldPtr = oldSlots;
+		mAllocator.Deallocate(oldPtr);
+		return true;
+	}
+
+	Allocator& mAllocator;
+	Slot* mSlots;
+	std::size_t mCapacity;
+	std::size_t mSize;
+	unsigned int mShift;
+};
+
+// DebugAllocator : Wraps an allocator to count its allocations and the memory in use
+// Counters are kept per thread and summed on read, the peak is tracked lock-free from batches of at least peakGranularity bytes per thread
+// By default sizes are passed through unchanged and only the blocks are counted, cheap enough to stay enabled in production
+// The memory in use is known with blockHeaders, blocks carrying a small header holding their size, or with trackBlocks
+// With block headers, the wrapped allocator receives the size plus the header, so it can't be a pool
+// Tracked blocks are kept in a table, which takes a lock and a hash table lookup, and can keep the call stack they were allocated from
+class DebugAllocator : public Allocator
+{
+public:
+	static constexpr std::size_t MaxCallSiteDepth = 16;
+
+	struct Settings
+	{
+		bool blockHeaders = false; // Keeps the size of the blocks in a header rather than in the list of the blocks
+		bool checkOwnership = true; // With block headers, the wrapped allocator must own a block before its header is read, false for allocators that can't tell like Mallocator
+		bool trackBlocks = false; // Keeps the list of the allocated blocks and their size
+		Allocator* blocksAllocator = nullptr; // Allocator of the list of blocks and of their call sites, a Mallocator if null
+		std::size_t peakGranularity = 4096; // Bytes a thread allocates or deallocates before accounting them in the peak
+		std::size_t callSiteDepth = 0; // Frames captured for each tracked block, up to MaxCallSiteDepth, 0 to not capture them
+		bool reportLeaks = false; // Writes the leak report when destroyed, to GetLeakReportFile() or stderr
+	};
+
+	struct Block
+	{
+		void* ptr;
+		std::size_t size;
+	};
+
+	DebugAllocator(Allocator& allocator);
+	DebugAllocator(Allocator& allocator, const Settings& settings);
+	~DebugAllocator();
+
+	void* Allocate(std::size_t size) override;
+	bool Deallocate(void*& ptr) override;
+	bool Owns(const void* ptr) const override;
+	const MemorySource* GetSource() const override;
+	bool IsThreadSafe() const override;
+	MemoryUsage GetMemoryUsage() const override;
+
+	std::size_t GetAllocationCount() const;
+	std::size_t GetDeallocationCount() const;
+	std::size_t GetFailureCount() const; // Allocations the wrapped allocator failed, and deallocations of blocks that weren't allocated
+	std::size_t GetUsedSize() const; // 0 when the sizes aren't known
+	std::size_t GetPeakSize() const;
+	// Whether the blocks have a header or are tracked
+	bool KnowsSizes() const;
+
+	// Copy of the blocks currently allocated, empty if the blocks aren't tracked
+	std::vector<Block> GetBlocks() const;
+
+	// Writes the blocks still allocated, grouped by call site when they are tracked, and returns their count
+	std::size_t WriteLeakReport(std::FILE* file) const;
+
+	const Settings& GetSettings() const;
+	std::size_t GetHeaderSize() const; // 0 without block headers
+
+protected:
+	struct BlockHeader
+	{
+		std::uint64_t magic;
+		std::size_t size;
+	};
+
+	// Only written by their thread, the atomics let other threads sum them
+	struct alignas(64) ThreadCounters
+	{
+		std::atomic<std::uint64_t> allocationCount;
+		std::atomic<std::uint64_t> deallocationCount;
+		std::atomic<std::uint64_t> failureCount;
+		std::atomic<std::uint64_t> allocatedSize;
+		std::atomic<std::uint64_t> deallocatedSize;
+		std::int64_t unaccountedSize;
+		ThreadCounters* previous;
+		ThreadCounters* next;
+	};
+
+	struct CallSite
+	{
+		std::size_t frameCount;
+		void* frames[MaxCallSiteDepth];
+		std::size_t liveCount;
+		std::size_t liveSize;
+	};
+
+	struct TrackedBlock
+	{
+		std::size_t size;
+		CallSite* callSite; // nullptr when not captured
+	};
+
+	static constexpr std::uint64_t AllocatedMagic = 0xD1A6A110CA7EDB10ull;
+
+	static void* CreateCounters(void* allocator);
+	static void ReleaseCounters(void* allocator, void* counters);
+
+	void AccountUsedSize(ThreadCounters& counters, std::int64_t size);
+	void CountFailure(ThreadCounters* counters);
+	bool TrackBlock(void* ptr, const TrackedBlock& block);
+	bool UntrackBlock(void* ptr, TrackedBlock* block);
+	CallSite* FindCallSite(void* const* frames, std::size_t frameCount);
+
+	Allocator& mAllocator;
+	Settings mSettings;
+	std::size_t mHeaderSize;
+	std::atomic<std::int64_t> mAccountedSize;
+	std::atomic<std::int64_t> mPeakSize;
+	mutable std::mutex mCountersMutex;
+	ThreadCounters* mCounters; // Threads alive
+	ThreadCounters mExitedCounters; // Sum of the threads that exited
+	mutable std::mutex mBlocksMutex;
+	Mallocator mBlocksMallocator;
+	Allocator& mBlocksAllocator;
+	PointerMap<TrackedBlock> mBlocks;
+	PointerMap<CallSite*> mCallSites; // Keyed by the hash of the frames
+	ThreadLocalSlots mThreadCounters;
+};
+
+// SamplingProfilerAllocator : Heap profiler sampling on average one allocation every samplingInterval bytes, like tcmalloc
+// The bytes until the next sample are drawn from an exponential distribution per thread, so every byte has the same chance to be sampled
+// Only sampled allocations capture their call stack, deallocations only take a lock when a sampled block may have the same address
+// WriteProfile() writes the in-use and allocated samples in the legacy heap format of pprof, which unbiases them with the interval
+class SamplingProfilerAllocator : public Allocator
+{
+public:
+	static constexpr std::size_t MaxFrameCount = 32;
+
+	struct Settings
+	{
+		std::size_t samplingInterval = 512 * 1024; // Mean bytes allocated between two samples, 0 samples every allocation
+		Allocator* profileAllocator = nullptr; // Allocator of the samples and their call stacks, a Mallocator if null
+	};
+
+	SamplingProfilerAllocator(Allocator& allocator);
+	SamplingProfilerAllocator(Allocator& allocator, const Settings& settings);
+	~SamplingProfilerAllocator();
+
+	void* Allocate(std::size_t size) override;
+	bool Deallocate(void*& ptr) override;
+	bool Owns(const void* ptr) const override;
+	const MemorySource* GetSource() const override;
+	bool IsThreadSafe() const override;
+	MemoryUsage GetMemoryUsage() const override;
+
+	// Heap profile in the legacy text format of pprof (heap_v2), followed by the mapped libraries on Linux
+	bool WriteProfile(std::FILE* file) const;
+	bool WriteProfile(const char* filename) const;
+
+	std::size_t GetInUseSampleCount() const;
+	std::size_t GetStackCount() const;
+	const Settings& GetSettings() const;
+
+	// NonCopyable
+	SamplingProfilerAllocator(const SamplingProfilerAllocator& other) = delete;
+	SamplingProfilerAllocator& operator=(const SamplingProfilerAllocator& other) = delete;
+
+protected:
+	// Samples with the same call stack share their record
+	struct StackRecord
+	{
+		std::size_t frameCount;
+		void* frames[MaxFrameCount];
+		std::uint64_t allocatedCount;
+		std::uint64_t allocatedSize;
+		std::uint64_t inUseCount;
+		std::uint64_t inUseSize;
+	};
+
+	struct Sample
+	{
+		StackRecord* stack;
+		std::size_t size;
+	};
+
+	struct ThreadSampler
+	{
+		std::int64_t bytesUntilSample;
+		std::uint64_t random;
+	};
+
+	// Counts the sampled blocks per address hash, a zero means the block to deallocate can't be a sampled one
+	static constexpr std::size_t FilterSize = 1024;
+
+	static void* CreateSampler(void* allocator);
+	static void ReleaseSampler(void* allocator, void* sampler);
+
+	std::int64_t DrawSampleInterval(ThreadSampler& sampler) const;
+	void RecordSample(void* ptr, std::size_t size, void* const* frames, std::size_t frameCount);
+	StackRecord* FindStack(void* const* frames, std::size_t frameCount);
+	static std::size_t GetFilterIndex(const void* ptr);
+
+	Allocator& mAllocator;
+	Settings mSettings;
+	mutable std::mutex mSamplesMutex;
+	Mallocator mProfileMallocator;
+	Allocator& mProfileAllocator;
+	PointerMap<Sample> mSamples;
+	PointerMap<StackRecord*> mStacks; // Keyed by the hash of the frames
+	std::atomic<std::uint32_t> mFilter[FilterSize];
+	ThreadLocalSlots mSamplers;
+};
+
+// TraceRecorderAllocator : Records every successful allocation and deallocation of an allocator in a binary trace file, see tools/DymaReplay
+// Each thread buffers its events and writes them by chunks, events are ordered by a sequence number shared by every thread
+// A deallocation takes its number before the block can be allocated again, so the ones that fail leave a gap in the sequence
+// The trace starts with "DYMATRC1", then each chunk holds its thread index, its size and events of varints relative to the previous event
+// A thread writes its remaining events when it exits, or when the recorder is destroyed, the file is left open
+class TraceRecorderAllocator : public Allocator
+{
+public:
+	struct Event
+	{
+		enum class Type : std::uint8_t
+		{
+			Allocate,
+			Deallocate
+		};
+
+		Type type;
+		std::uint32_t thread;
+		std::uint64_t sequence;
+		std::uint64_t time; // Nanoseconds since the creation of the recorder
+		std::uint64_t address; // Identifies the block, an address can be reused once deallocated
+		std::uint64_t size; // 0 for deallocations
+	};
+
+	TraceRecorderAllocator(Allocator& allocator, std::FILE* file);
+
+	void* Allocate(std::size_t size) override;
+	bool Deallocate(void*& ptr) override;
+	bool Owns(const void* ptr) const override;
+	const MemorySource* GetSource() const override;
+	bool IsThreadSafe() const override;
+	MemoryUsage GetMemoryUsage() const override;
+
+	// Writes the events buffered by the calling thread
+	void Flush();
+
+	std::uint64_t GetEventCount() const;
+	bool HasFailed() const;
+
+	// Reads a whole trace, events are sorted by sequence, returns false if the file isn't a valid trace
+	static bool ReadTrace(std::FILE* file, std::vector<Event>& events);
+
+	// NonCopyable
+	TraceRecorderAllocator(const TraceRecorderAllocator& other) = delete;
+	TraceRecorderAllocator& operator=(const TraceRecorderAllocator& other) = delete;
+
+protected:
+	static constexpr std::size_t BufferSize = 4096;
+	static constexpr std::size_t MaxEventSize = 1 + 4 * 10; // Type and four varints
+
+	struct ThreadBuffer
+	{
+		std::uint32_t thread;
+		std::size_t size;
+		std::uint64_t previousSequence;
+		std::uint64_t previousTime;
+		std::uint64_t previousAddress;
+		std::uint8_t data[BufferSize];
+	};
+
+	static void* CreateBuffer(void* recorder);
+	static void ReleaseBuffer(void* recorder, void* buffer);
+
+	void Record(Event::Type type, std::uint64_t sequence, const void* ptr, std::size_t size);
+	void WriteChunk(ThreadBuffer& buffer);
+	std::uint64_t GetTime() const;
+
+	Allocator& mAllocator;
+	std::FILE* mFile;
+	std::mutex mFileMutex;
+	std::atomic<bool> mFailed;
+	std::atomic<std::uint64_t> mSequence;
+	std::atomic<std::uint64_t> mFailedDeallocationCount; // Numbers of the sequence without event
+	std::int64_t mStartTime;
+	ThreadLocalSlots mBuffers;
+};
+
+// HistogramAllocator : Wraps an allocator to build power-of-two histograms of the sizes and the lifetimes of its blocks, to tune allocator graphs
+// Lifetimes are measured in nanoseconds and in allocations made in between, counted by batches of indexBatchSize per thread
+// Histograms are kept per thread and summed on read, blocks carry a small header holding their birth when lifetimes are tracked
+class HistogramAllocator : public Allocator
+{
+public:
+	static constexpr std::size_t BucketCount = 65;
+
+	// Bucket i of a size histogram counts the sizes in ]2^(i-1), 2^i], bucket i of a lifetime histogram counts the lifetimes in [2^i - 1, 2^(i+1) - 1[
+	struct Histogram
+	{
+		std::uint64_t counts[BucketCount];
+		std::uint64_t maxValues[BucketCount]; // Largest value counted by each bucket
+
+		std::uint64_t GetTotal() const;
+	};
+
+	struct Settings
+	{
+		bool trackLifetimes = true; // Adds a header to the blocks
+		bool checkOwnership = true; // With lifetimes, the wrapped allocator must own a block before its header is read, false for allocators that can't tell like Mallocator
+		std::size_t indexBatchSize = 256; // Allocations a thread counts before adding them to the shared allocation index
+	};
+
+	HistogramAllocator(Allocator& allocator);
+	HistogramAllocator(Allocator& allocator, const Settings& settings);
+
+	void* Allocate(std::size_t size) override;
+	bool Deallocate(void*& ptr) override;
+	bool Owns(const void* ptr) const override;
+	const MemorySource* GetSource() const override;
+	bool IsThreadSafe() const override;
+	MemoryUsage GetMemoryUsage() const override;
+
+	Histogram GetSizeHistogram() const;
+	Histogram GetLifetimeCountHistogram() const; // Allocations made between the allocation and the deallocation of the blocks
+	Histogram GetLifetimeTimeHistogram() const; // Nanoseconds
+
+	// Block size of a PoolAllocator serving the most common bucket of sizes, 0 without allocation
+	std::size_t SuggestPoolBlockSize() const;
+	// Threshold of a SegregatorAllocator sending at least the given ratio of the allocations to the smaller allocator, 0 without allocation
+	std::size_t SuggestSegregatorThreshold(double smallerRatio = 0.9) const;
+
+	const Settings& GetSettings() const;
+	std::size_t GetHeaderSize() const;
+
+	static std::size_t GetSizeBucket(std::uint64_t size);
+	static std::size_t GetLifetimeBucket(std::uint64_t lifetime);
+
+protected:
+	struct BlockHeader
+	{
+		std::uint64_t birthTime;
+		std::uint64_t birthIndex;
+	};
+
+	// Only written by their thread, the atomics let other threads sum them
+	struct ThreadHistograms
+	{
+		std::atomic<std::uint64_t> sizes[BucketCount];
+		std::atomic<std::uint64_t> maxSizes[BucketCount];
+		std::atomic<std::uint64_t> lifetimeCounts[BucketCount];
+		std::atomic<std::uint64_t> maxLifetimeCounts[BucketCount];
+		std::atomic<std::uint64_t> lifetimeTimes[BucketCount];
+		std::atomic<std::uint64_t> maxLifetimeTimes[BucketCount];
+		std::uint64_t unaccountedAllocations;
+		ThreadHistograms* previous;
+		ThreadHistograms* next;
+	};
+
+	static void* CreateHistograms(void* allocator);
+	static void ReleaseHistograms(void* allocator, void* histograms);
+
+	static void Count(std::atomic<std::uint64_t>* counts, std::atomic<std::uint64_t>* maxValues, std::size_t bucket, std::uint64_t value);
+	static void StoreMax(std::atomic<std::uint64_t>& maxValue, std::uint64_t value);
+	Histogram SumHistograms(std::atomic<std::uint64_t> (ThreadHistograms::*counts)[BucketCount], std::atomic<std::uint64_t> (ThreadHistograms::*maxValues)[BucketCount]) const;
+	std::uint64_t GetAllocationIndex(const ThreadHistograms& histograms) const;
+	std::uint64_t GetTime() const;
+
+	Allocator& mAllocator;
+	Settings mSettings;
+	std::size_t mHeaderSize;
+	std::atomic<std::uint64_t> mAllocationIndex;
+	std::int64_t mStartTime;
+	mutable std::mutex mHistogramsMutex;
+	ThreadHistograms* mHistograms; // Threads alive
+	ThreadHistograms mExitedHistograms; // Sum of the threads that exited
+	ThreadLocalSlots mThreadHistograms;
+};
+
+// MemoryTag : Small id of a node of a MemoryTagTree
+using MemoryTag = std::uint16_t;
+
+// MemoryTagTree : Tree of tags like "net/rx/buffers" counting the bytes of their blocks and of the blocks of their children
+// Each tag can have a budget, a charge exceeding the budget of the tag or of one of its ancestors fails unless the budget callback allows it
+// Tags are never removed, so their ids stay valid and charges don't take any lock
+class MemoryTagTree
+{
+public:
+	static constexpr MemoryTag RootTag = 0;
+	static constexpr MemoryTag InvalidTag = 0xFFFF;
+	static constexpr std::size_t MaxNameSize = 31;
+
+	// Called with the tag whose budget would be exceeded, returns true to let the charge through
+	using BudgetCallback = bool (*)(void* userData, MemoryTag tag, std::size_t usedSize, std::size_t size);
+
+	MemoryTagTree(std::size_t capacity = 256);
+	~MemoryTagTree();
+
+	// NonCopyable
+	MemoryTagTree(const MemoryTagTree& other) = delete;
+	MemoryTagTree& operator=(const MemoryTagTree& other) = delete;
+
+	// Creates the missing tags of the path, InvalidTag if the tree is full or a name is longer than MaxNameSize
+	MemoryTag Register(const char* path);
+	// InvalidTag if the path isn't registered, the empty path being the root
+	MemoryTag Find(const char* path) const;
+
+	// A budget of 0 means no budget
+	void SetBudget(MemoryTag tag, std::size_t budget);
+	std::size_t GetBudget(MemoryTag tag) const;
+	// Should be set before charging
+	void SetBudgetCallback(BudgetCallback callback, void* userData);
+
+	// Adds the size to the tag and its ancestors, nothing is added when it fails
+	bool Charge(MemoryTag tag, std::size_t size);
+	void Release(MemoryTag tag, std::size_t size);
+
+	std::size_t GetUsedSize(MemoryTag tag) const; // Includes the children
+	std::size_t GetPeakSize(MemoryTag tag) const;
+	MemoryTag GetParent(MemoryTag tag) const; // InvalidTag for the root
+	const char* GetName(MemoryTag tag) const;
+	std::size_t GetTagCount() const;
+	std::size_t GetCapacity() const;
+
+protected:
+	struct Node
+	{
+		std::atomic<std::size_t> usedSize;
+		std::atomic<std::size_t> peakSize;
+		std::atomic<std::size_t> budget;
+		MemoryTag parent;
+		char name[MaxNameSize + 1];
+	};
+
+	MemoryTag FindChild(MemoryTag parent, const char* name, std::size_t nameSize) const;
+
+	Node* mNodes;
+	std::size_t mCapacity;
+	std::atomic<std::size_t> mTagCount;
+	BudgetCallback mBudgetCallback;
+	void* mBudgetUserData;
+	mutable std::mutex mRegisterMutex;
+};
+
+// MemoryTagScope : Sets the tag of the allocations of the current thread while in scope, restoring the previous one after
+class MemoryTagScope
+{
+public:
+	MemoryTagScope(MemoryTag tag);
+	~MemoryTagScope();
+
+	// NonCopyable
+	MemoryTagScope(const MemoryTagScope& other) = delete;
+	MemoryTagScope& operator=(const MemoryTagScope& other) = delete;
+
+	// RootTag outside of any scope
+	static MemoryTag GetCurrentTag();
+
+private:
+	MemoryTag mPreviousTag;
+};
+
+// TaggedAllocator : Wraps an allocator to charge its blocks to the tags of a MemoryTagTree, failing the allocations exceeding a budget
+// Blocks carry a header holding their tag and size, the tag is the one of the current MemoryTagScope unless given explicitly
+// Budgets count the requested sizes, not the headers
+// A PoolAllocator must then have blocks of the requested size + GetHeaderSize() bytes, use a SegregatorAllocator of such pools for several sizes
+class TaggedAllocator : public Allocator
+{
+public:
+	struct Settings
+	{
+		bool checkOwnership = true; // Deallocate() rejects the blocks the wrapped allocator doesn't own, false for allocators that can't tell like Mallocator
+	};
+
+	TaggedAllocator(Allocator& allocator, MemoryTagTree& tree);
+	TaggedAllocator(Allocator& allocator, MemoryTagTree& tree, const Settings& settings);
+
+	void* Allocate(std::size_t size) override;
+	void* Allocate(std::size_t size, MemoryTag tag);
+	bool Deallocate(void*& ptr) override;
+	bool Owns(const void* ptr) const override;
+	const MemorySource* GetSource() const override;
+	bool IsThreadSafe() const override;
+	MemoryUsage GetMemoryUsage() const override;
+
+	// Tag the block was charged to
+	MemoryTag GetTag(const void* ptr) const;
+
+	MemoryTagTree& GetTree() const;
+	std::size_t GetHeaderSize() const;
+
+protected:
+	struct BlockHeader
+	{
+		std::size_t size;
+		MemoryTag tag;
+	};
+
+	Allocator& mAllocator;
+	MemoryTagTree& mTree;
+	Settings mSettings;
+	std::size_t mHeaderSize;
+};
+
+// StatsRegistry : Publishes the counters of allocators in a shared memory page, so another process like DymaTop can watch them live
+// Counters are read by a background thread every publishIntervalMs, the allocators themselves aren't touched
+// Each entry of the page is written under a seqlock, readers retry while it is being written and never block the publisher
+// Allocators that aren't thread-safe can only be added with a publishIntervalMs of 0, their thread publishing them with Publish(), or behind a LockedAllocator
+// A DebugAllocator can wrap any of them, only its own counters being read
+// Only available on POSIX systems, IsOpen() is false elsewhere
+class StatsRegistry
+{
+public:
+	static constexpr std::size_t MaxNameSize = 47;
+	static constexpr std::size_t InvalidIndex = ~static_cast<std::size_t>(0);
+
+	struct Settings
+	{
+		const char* name = nullptr; // Name of the shared memory, "/dyma-<pid>" if null
+		std::size_t capacity = 64; // Allocators that can be added, removed ones included
+		std::uint32_t publishIntervalMs = 1000; // 0 to only publish on Publish()
+	};
+
+	struct Snapshot
+	{
+		char name[MaxNameSize + 1];
+		std::uint64_t usedSize;
+		std::uint64_t peakSize;
+		std::uint64_t allocationCount; // 0 when the allocator doesn't count them
+		std::uint64_t deallocationCount;
+		std::uint64_t failureCount;
+		std::uint64_t allocationRate; // Allocations per second between the last two publications
+		std::uint64_t timestamp; // Nanoseconds since the epoch of the system clock
+	};
+
+	StatsRegistry();
+	StatsRegistry(const Settings& settings);
+	~StatsRegistry();
+
+	// NonCopyable
+	StatsRegistry(const StatsRegistry& other) = delete;
+	StatsRegistry& operator=(const StatsRegistry& other) = delete;
+
+	bool IsOpen() const;
+	const char* GetName() const;
+	std::size_t GetCapacity() const;
+
+	// The allocator must outlive its entry, InvalidIndex if the registry is full or not open, or if the allocator isn't thread-safe while the background thread publishes
+	// Only the used size of GetMemoryUsage() is known for any allocator, the peak being the highest published
+	std::size_t Add(const char* name, const Allocator& allocator);
+	// All the counters are known for a DebugAllocator, the sizes when it KnowsSizes(), and the allocator it wraps doesn't need to be thread-safe
+	std::size_t Add(const char* name, const DebugAllocator& allocator);
+	// Entries aren't reused, readers stop seeing them
+	void Remove(std::size_t index);
+
+	void Publish();
+
+	// Reads the entries of the registry of another process, false if it can't be opened or isn't a registry
+	static bool Read(const char* name, std::vector<Snapshot>& snapshots);
+
+private:
+	struct SharedHeader;
+	struct SharedEntry;
+
+	struct Source
+	{
+		const Allocator* allocator;
+		const DebugAllocator* debugAllocator;
+		std::uint64_t peakSize;
+		std::uint64_t previousAllocationCount;
+		std::int64_t previousTime;
+		bool active;
+	};
+
+	std::size_t AddSource(const char* name, const Allocator* allocator, const DebugAllocator* debugAllocator);
+	void PublishSources();
+	void RunPublisher();
+
+	Settings mSettings;
+	char mName[64];
+	void* mMapping;
+	std::size_t mMappingSize;
+	SharedHeader* mHeader;
+	SharedEntry* mEntries;
+	std::vector<Source> mSources;
+	std::mutex mMutex;
+	std::condition_variable mStopCondition;
+	bool mStopping;
+	std::thread mPublisher;
+};
+
 } // namespace dyma
@@ -0,0 +1,101 @@
+#include "../src/Dyma.hpp"
+#include "doctest.h"
+
+#if defined(DYMA_HOOKS)
+
+using namespace dyma;
+
+namespace
+{
+
+struct HookEvents
+{
+	std::size_t allocationCount = 0;
+	std::size_t deallocationCount = 0;
+	std::size_t failureCount = 0;
+	const Allocator* lastAllocator = nullptr;
+	std::size_t lastSize = 0;
+};
+
+void OnAllocate(void* userData, const Allocator& allocator, void*, std::size_t size)
+{
+	HookEvents* events = static_cast<HookEvents*>(userData);
+	events->allocationCount++;
+	events->lastAllocator = &allocator;
+	events->lastSize = size;
+}
+
+void OnDeallocate(void* userData, const Allocator& allocator, void*)
+{
+	HookEvents* events = static_cast<HookEvents*>(userData);
+	events->deallocationCount++;
+	events->lastAllocator = &allocator;
+}
+
+void OnFailure(void* userData, const Allocator& allocator, std::size_t size)
+{
+	HookEvents* events = static_cast<HookEvents*>(userData);
+	events->failureCount++;
+	events->lastAllocator = &allocator;
+	events->lastSize = size;
+}
+
+} // namespace
+
+DOCTEST_TEST_CASE("AllocationHooks")
+{
+	HookEvents events;
+	AllocationHooks hooks;
+	hooks.onAllocate = &OnAllocate;
+	hooks.onDeallocate = &OnDeallocate;
+	hooks.onFailure = &OnFailure;
+	hooks.userData = &events;
+	SetAllocationHooks(&hooks);
+	DOCTEST_CHECK(GetAllocationHooks() == &hooks);
+
+	DOCTEST_SUBCASE("Leaf allocators emit the events")
+	{
+		StackMemory<256, 16> memory;
+		PoolAllocator pool(memory, 64);
+		void* ptr = pool.Allocate(64);
+		DOCTEST_CHECK(events.allocationCount == 1);
+		DOCTEST_CHECK(events.lastAllocator == &pool);
+		DOCTEST_CHECK(events.lastSize == 64);
+
+		DOCTEST_CHECK(pool.Allocate(32) == nullptr);
+		DOCTEST_CHECK(events.failureCount == 1);
+		DOCTEST_CHECK(events.lastSize == 32);
+
+		pool.Deallocate(ptr);
+		DOCTEST_CHECK(events.deallocationCount == 1);
+	}
+
+	DOCTEST_SUBCASE("Composite allocators don't emit their own events")
+	{
+		StackMemory<256, 16> poolMemory;
+		StackMemory<256, 16> stackMemory;
+		PoolAllocator pool(poolMemory, 64);
+		StackAllocator stack(stackMemory);
+		FallbackAllocator allocator(pool, stack);
+		void* ptr = allocator.Allocate(32);
+		DOCTEST_CHECK(events.failureCount == 1);
+		DOCTEST_CHECK(events.allocationCount == 1);
+		DOCTEST_CHECK(events.lastAllocator == &stack);
+		allocator.Deallocate(ptr);
+		DOCTEST_CHECK(events.deallocationCount == 1);
+	}
+
+	DOCTEST_SUBCASE("Removed hooks")
+	{
+		SetAllocationHooks(nullptr);
+		Mallocator mallocator;
+		void* ptr = mallocator.Allocate(16);
+		mallocator.Deallocate(ptr);
+		DOCTEST_CHECK(events.allocationCount == 0);
+		DOCTEST_CHECK(events.deallocationCount == 0);
+	}
+
+	SetAllocationHooks(nullptr);
+}
+
+#endif // DYMA_HOOKS
\ No newline at end of file
@@ -0,0 +1,71 @@
+#include "../src/Dyma.hpp"
+#include "doctest.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace dyma;
+
+DOCTEST_TEST_CASE("ConcurrentLinearAllocator")
+{
+	DOCTEST_SUBCASE("Allocate")
+	{
+		StackMemory<256, 16> memory;
+		ConcurrentLinearAllocator allocator(memory);
+		DOCTEST_CHECK(allocator.Allocate(0) == nullptr);
+		DOCTEST_CHECK(allocator.Allocate(512) == nullptr);
+
+		void* a = allocator.Allocate(8);
+		void* b = allocator.Allocate(24);
+		DOCTEST_CHECK(a == memory.GetPointer());
+		DOCTEST_CHECK(reinterpret_cast<std::uintptr_t>(b) == reinterpret_cast<std::uintptr_t>(a) + 16);
+		DOCTEST_CHECK(allocator.GetUsedSize() == 48);
+
+		DOCTEST_CHECK(allocator.Deallocate(a));
+		DOCTEST_CHECK(a == nullptr);
+		DOCTEST_CHECK(allocator.GetUsedSize() == 48);
+
+		DOCTEST_CHECK(allocator.Allocate(208) != nullptr);
+		DOCTEST_CHECK(allocator.Allocate(16) == nullptr);
+		DOCTEST_CHECK(allocator.GetRemainingSize() == 0);
+
+		allocator.DeallocateAll();
+		DOCTEST_CHECK(allocator.GetUsedSize() == 0);
+		DOCTEST_CHECK(allocator.Allocate(16) == memory.GetPointer());
+	}
+
+	DOCTEST_SUBCASE("Threads")
+	{
+		HeapMemory memory(4 * 1000 * 16);
+		ConcurrentLinearAllocator allocator(memory);
+
+		std::atomic<std::size_t> errorCount(0);
+		std::vector<std::thread> threads;
+		for (std::size_t t = 0; t < 4; ++t)
+		{
+			threads.emplace_back([&allocator, &errorCount, t]()
+			{
+				std::size_t* blocks[1000];
+				for (std::size_t i = 0; i < 1000; ++i)
+				{
+					blocks[i] = static_cast<std::size_t*>(allocator.Allocate(sizeof(std::size_t)));
+					*blocks[i] = t;
+				}
+				for (std::size_t i = 0; i < 1000; ++i)
+				{
+					if (*blocks[i] != t)
+					{
+						errorCount++;
+					}
+				}
+			});
+		}
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+		DOCTEST_CHECK(errorCount == 0);
+		DOCTEST_CHECK(allocator.GetRemainingSize() == 0);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,82 @@
+#include "../src/Dyma.hpp"
+#include "doctest.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace dyma;
+
+DOCTEST_TEST_CASE("ConcurrentPoolAllocator")
+{
+	DOCTEST_SUBCASE("Allocate")
+	{
+		StackMemory<256, 16> memory;
+		ConcurrentPoolAllocator allocator(memory, 16);
+		DOCTEST_CHECK(allocator.GetBlockCount() == 16);
+		DOCTEST_CHECK(allocator.Allocate(8) == nullptr);
+
+		void* blocks[16];
+		for (std::size_t i = 0; i < 16; ++i)
+		{
+			blocks[i] = allocator.Allocate(16);
+			DOCTEST_CHECK(blocks[i] != nullptr);
+			DOCTEST_CHECK(allocator.Owns(blocks[i]));
+		}
+		DOCTEST_CHECK(allocator.Allocate(16) == nullptr);
+
+		void* last = blocks[15];
+		DOCTEST_CHECK(allocator.Deallocate(blocks[15]));
+		DOCTEST_CHECK(blocks[15] == nullptr);
+		DOCTEST_CHECK(allocator.Allocate(16) == last);
+
+		int a;
+		void* aPtr = (void*)&a;
+		DOCTEST_CHECK(!allocator.Deallocate(aPtr));
+	}
+
+	DOCTEST_SUBCASE("Threads")
+	{
+		HeapMemory memory(64 * 1024);
+		ConcurrentPoolAllocator allocator(memory, 64);
+
+		std::atomic<std::size_t> errorCount(0);
+		std::vector<std::thread> threads;
+		for (std::size_t t = 0; t < 4; ++t)
+		{
+			threads.emplace_back([&allocator, &errorCount, t]()
+			{
+				void* blocks[32];
+				for (std::size_t iteration = 0; iteration < 2000; ++iteration)
+				{
+					for (std::size_t i = 0; i < 32; ++i)
+					{
+						blocks[i] = allocator.Allocate(64);
+						*static_cast<std::size_t*>(blocks[i]) = t;
+					}
+					for (std::size_t i = 0; i < 32; ++i)
+					{
+						// No other thread got the same block
+						if (*static_cast<std::size_t*>(blocks[i]) != t)
+						{
+							errorCount++;
+						}
+						allocator.Deallocate(blocks[i]);
+					}
+				}
+			});
+		}
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+		DOCTEST_CHECK(errorCount == 0);
+
+		std::size_t blockCount = 0;
+		while (allocator.Allocate(64) != nullptr)
+		{
+			blockCount++;
+		}
+		DOCTEST_CHECK(blockCount == allocator.GetBlockCount());
+	}
+}
\ No newline at end of file
@@ -0,0 +1,142 @@
+#include "../src/Dyma.hpp"
+#include "doctest.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace dyma;
+
+namespace
+{
+
+// Pretends the CPUs have higher ids than the ones that have a cache
+class NoCpuCachingAllocator : public CpuCachingAllocator
+{
+public:
+	NoCpuCachingAllocator(Allocator& upstream)
+		: CpuCachingAllocator(upstream)
+	{
+		mCpuCount = 0;
+	}
+};
+
+} // namespace
+
+DOCTEST_TEST_CASE("CpuCachingAllocator")
+{
+	DOCTEST_SUBCASE("Allocate")
+	{
+		Mallocator mallocator;
+		CpuCachingAllocator allocator(mallocator);
+		DOCTEST_CHECK(allocator.UsesCpuCaches() == CpuCachingAllocator::IsRseqAvailable());
+		DOCTEST_CHECK(allocator.Allocate(0) == nullptr);
+
+		void* small = allocator.Allocate(24);
+		void* large = allocator.Allocate(1000);
+		DOCTEST_CHECK(small != nullptr);
+		DOCTEST_CHECK(large != nullptr);
+
+		// The last freed block is the first one reused
+		void* smallCopy = small;
+		DOCTEST_CHECK(allocator.Deallocate(small));
+		DOCTEST_CHECK(small == nullptr);
+		DOCTEST_CHECK(allocator.Allocate(24) == smallCopy);
+		DOCTEST_CHECK(allocator.Deallocate(smallCopy));
+		DOCTEST_CHECK(allocator.Deallocate(large));
+	}
+
+	DOCTEST_SUBCASE("Foreign blocks")
+	{
+		// Rejected by the source of the upstream allocator, before indexing the bins of the CPU
+		HeapMemory memory(16 * 32);
+		PoolAllocator pool(memory, 16 + 16);
+		CpuCachingAllocator::Settings settings;
+		settings.maxCachedSize = 16;
+		CpuCachingAllocator allocator(pool, settings);
+		Mallocator mallocator;
+		void* foreign = mallocator.Allocate(64);
+		void* foreignCopy = foreign;
+		DOCTEST_CHECK(!allocator.Deallocate(foreign));
+		DOCTEST_CHECK(foreign == foreignCopy);
+		mallocator.Deallocate(foreign);
+
+		// Without a source, by the size class of their header
+		CpuCachingAllocator mallocAllocator(mallocator);
+		std::size_t words[4] = { 1000, 1000, 1000, 1000 };
+		void* fake = &words[2];
+		DOCTEST_CHECK(!mallocAllocator.Deallocate(fake));
+		DOCTEST_CHECK(fake == &words[2]);
+	}
+
+	DOCTEST_SUBCASE("CPUs without a cache")
+	{
+		DOCTEST_CHECK(GetCurrentCpu() < GetCpuCount());
+
+		// Their blocks go through the per-thread caches
+		Mallocator mallocator;
+		GrowablePoolAllocator upstream(mallocator, 48, 64);
+		{
+			NoCpuCachingAllocator allocator(upstream);
+			void* blocks[64];
+			for (void*& block : blocks)
+			{
+				block = allocator.Allocate(32);
+				DOCTEST_CHECK(block != nullptr);
+			}
+			void* lastCopy = blocks[63];
+			for (void*& block : blocks)
+			{
+				DOCTEST_CHECK(allocator.Deallocate(block));
+			}
+			DOCTEST_CHECK(allocator.Allocate(32) == lastCopy);
+			allocator.Deallocate(lastCopy);
+		}
+		DOCTEST_CHECK(upstream.GetChunkCount() == 0);
+	}
+
+	DOCTEST_SUBCASE("Threads")
+	{
+		Mallocator mallocator;
+		GrowablePoolAllocator upstream(mallocator, 80, 256);
+		std::atomic<std::size_t> errorCount(0);
+		{
+			CpuCachingAllocator::Settings settings;
+			settings.batchSize = 16;
+			settings.maxCachedBlocks = 32;
+			CpuCachingAllocator allocator(upstream, settings);
+			std::vector<std::thread> threads;
+			for (std::size_t t = 0; t < 8; ++t)
+			{
+				threads.emplace_back([&allocator, &errorCount, t]()
+				{
+					void* blocks[64];
+					for (std::size_t iteration = 0; iteration < 500; ++iteration)
+					{
+						for (std::size_t i = 0; i < 64; ++i)
+						{
+							blocks[i] = allocator.Allocate(64);
+							*static_cast<std::size_t*>(blocks[i]) = t;
+						}
+						for (std::size_t i = 0; i < 64; ++i)
+						{
+							if (*static_cast<std::size_t*>(blocks[i]) != t)
+							{
+								errorCount++;
+							}
+							allocator.Deallocate(blocks[i]);
+						}
+					}
+				});
+			}
+			for (std::thread& thread : threads)
+			{
+				thread.join();
+			}
+		}
+		DOCTEST_CHECK(errorCount == 0);
+
+		// Every cache has been drained
+		DOCTEST_CHECK(upstream.GetChunkCount() == 0);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,293 @@
+#include "../src/Dyma.hpp"
+#include "doctest.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace dyma;
+
+namespace
+{
+
+std::string ReadFile(std::FILE* file)
+{
+	std::string content;
+	char buffer[256];
+	std::rewind(file);
+	std::size_t readSize = 0;
+	while ((readSize = std::fread(buffer, 1, sizeof(buffer), file)) > 0)
+	{
+		content.append(buffer, readSize);
+	}
+	return content;
+}
+
+// Every block allocated through it has the same call site when only one frame is captured
+#if defined(_MSC_VER)
+__declspec(noinline)
+#elif defined(__GNUC__) || defined(__clang__)
+__attribute__((noinline))
+#endif
+void* AllocateFromHelper(Allocator& allocator, std::size_t size)
+{
+	return allocator.Allocate(size);
+}
+
+} // namespace
+
+DOCTEST_TEST_CASE("DebugAllocator")
+{
+	DOCTEST_SUBCASE("Statistics")
+	{
+		StackMemory<1024, 16> memory;
+		StackAllocator stackAllocator(memory);
+		DebugAllocator::Settings settings;
+		settings.blockHeaders = true;
+		settings.peakGranularity = 0;
+		DebugAllocator allocator(stackAllocator, settings);
+		DOCTEST_CHECK(allocator.Allocate(0) == nullptr);
+
+		void* ptr8 = allocator.Allocate(8);
+		void* ptr32 = allocator.Allocate(32);
+		DOCTEST_CHECK(allocator.Owns(ptr8));
+		DOCTEST_CHECK(stackAllocator.GetUsedSize() == 2 * allocator.GetHeaderSize() + 16 + 32);
+		DOCTEST_CHECK(allocator.Deallocate(ptr32));
+		DOCTEST_CHECK(ptr32 == nullptr);
+		DOCTEST_CHECK(allocator.GetAllocationCount() == 2);
+		DOCTEST_CHECK(allocator.GetDeallocationCount() == 1);
+		DOCTEST_CHECK(allocator.GetUsedSize() == 8);
+		DOCTEST_CHECK(allocator.GetPeakSize() == 40);
+		DOCTEST_CHECK(allocator.GetBlocks().empty());
+	}
+
+	DOCTEST_SUBCASE("Foreign blocks")
+	{
+		// Their header isn't read, they count as failures
+		StackMemory<256, 16> memory;
+		StackAllocator stackAllocator(memory);
+		DebugAllocator::Settings settings;
+		settings.blockHeaders = true;
+		DebugAllocator allocator(stackAllocator, settings);
+		Mallocator mallocator;
+		void* foreign = mallocator.Allocate(64);
+		void* foreignCopy = foreign;
+		DOCTEST_CHECK(!allocator.Deallocate(foreign));
+		DOCTEST_CHECK(foreign == foreignCopy);
+		DOCTEST_CHECK(allocator.GetFailureCount() == 1);
+		mallocator.Deallocate(foreign);
+
+		// Neither are the blocks deallocated twice
+		void* ptr = allocator.Allocate(16);
+		void* ptrCopy = ptr;
+		DOCTEST_CHECK(allocator.Deallocate(ptr));
+		DOCTEST_CHECK(!allocator.Deallocate(ptrCopy));
+		DOCTEST_CHECK(allocator.GetFailureCount() == 2);
+		DOCTEST_CHECK(allocator.GetDeallocationCount() == 1);
+	}
+
+	DOCTEST_SUBCASE("Sizes are passed through")
+	{
+		// Pools only accept their block size
+		StackMemory<256, 16> poolMemory;
+		PoolAllocator pool(poolMemory, 64);
+		DebugAllocator::Settings settings;
+		settings.trackBlocks = true;
+		settings.peakGranularity = 0;
+		DebugAllocator allocator(pool, settings);
+		DOCTEST_CHECK(allocator.GetHeaderSize() == 0);
+		DOCTEST_CHECK(allocator.KnowsSizes());
+
+		void* ptr = allocator.Allocate(64);
+		DOCTEST_CHECK(ptr != nullptr);
+		DOCTEST_CHECK(pool.Owns(ptr));
+		DOCTEST_CHECK(allocator.Owns(ptr));
+		DOCTEST_CHECK(allocator.Allocate(32) == nullptr);
+		DOCTEST_CHECK(allocator.GetFailureCount() == 1);
+		DOCTEST_CHECK(allocator.GetUsedSize() == 64);
+
+		// Pointers it didn't allocate are rejected
+		int a;
+		void* aPtr = &a;
+		DOCTEST_CHECK(!allocator.Deallocate(aPtr));
+		DOCTEST_CHECK(allocator.Deallocate(ptr));
+		DOCTEST_CHECK(allocator.GetUsedSize() == 0);
+		DOCTEST_CHECK(allocator.GetPeakSize() == 64);
+
+		// And so can a shared pool, only the blocks being counted by default
+		StackMemory<64 * 64, 16> concurrentMemory;
+		ConcurrentPoolAllocator concurrentPool(concurrentMemory, 64);
+		DebugAllocator concurrentAllocator(concurrentPool);
+		DOCTEST_CHECK(concurrentAllocator.IsThreadSafe());
+		DOCTEST_CHECK(!concurrentAllocator.KnowsSizes());
+		std::vector<std::thread> threads;
+		for (std::size_t t = 0; t < 4; ++t)
+		{
+			threads.emplace_back([&concurrentAllocator]()
+			{
+				for (std::size_t i = 0; i < 1000; ++i)
+				{
+					void* block = concurrentAllocator.Allocate(64);
+					if (block != nullptr)
+					{
+						concurrentAllocator.Deallocate(block);
+					}
+				}
+			});
+		}
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+		DOCTEST_CHECK(concurrentAllocator.GetAllocationCount() == 4 * 1000);
+		DOCTEST_CHECK(concurrentAllocator.GetDeallocationCount() == 4 * 1000);
+		DOCTEST_CHECK(concurrentAllocator.GetUsedSize() == 0);
+		DOCTEST_CHECK(concurrentAllocator.GetPeakSize() == 0);
+		DOCTEST_CHECK(concurrentAllocator.GetBlocks().empty());
+	}
+
+	DOCTEST_SUBCASE("Blocks")
+	{
+		StackMemory<1024, 16> memory;
+		StackAllocator stackAllocator(memory);
+		DebugAllocator::Settings settings;
+		settings.trackBlocks = true;
+		DebugAllocator allocator(stackAllocator, settings);
+
+		void* ptr8 = allocator.Allocate(8);
+		void* ptr16 = allocator.Allocate(16);
+		void* ptr32 = allocator.Allocate(32);
+		allocator.Deallocate(ptr32);
+
+		const std::vector<DebugAllocator::Block> blocks = allocator.GetBlocks();
+		DOCTEST_CHECK(blocks.size() == 2);
+		for (const DebugAllocator::Block& block : blocks)
+		{
+			DOCTEST_CHECK(((block.ptr == ptr8 && block.size == 8) || (block.ptr == ptr16 && block.size == 16)));
+		}
+	}
+
+	DOCTEST_SUBCASE("Threads")
+	{
+		Mallocator mallocator;
+		DebugAllocator::Settings settings;
+		settings.blockHeaders = true;
+		settings.checkOwnership = false;
+		settings.peakGranularity = 1024;
+		DebugAllocator allocator(mallocator, settings);
+
+		// Threads exit before the counters are read, their counters are kept
+		std::vector<std::thread> threads;
+		for (std::size_t t = 0; t < 8; ++t)
+		{
+			threads.emplace_back([&allocator]()
+			{
+				void* blocks[64];
+				for (std::size_t iteration = 0; iteration < 100; ++iteration)
+				{
+					for (std::size_t i = 0; i < 64; ++i)
+					{
+						blocks[i] = allocator.Allocate(32);
+					}
+					for (std::size_t i = 0; i < 64; ++i)
+					{
+						allocator.Deallocate(blocks[i]);
+					}
+				}
+			});
+		}
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+		DOCTEST_CHECK(allocator.GetAllocationCount() == 8 * 100 * 64);
+		DOCTEST_CHECK(allocator.GetDeallocationCount() == 8 * 100 * 64);
+		DOCTEST_CHECK(allocator.GetUsedSize() == 0);
+		DOCTEST_CHECK(allocator.GetPeakSize() >= 64 * 32 - 1024);
+		DOCTEST_CHECK(allocator.GetPeakSize() <= 8 * 64 * 32 + 8 * 1024);
+	}
+
+	DOCTEST_SUBCASE("Leak report")
+	{
+		StackMemory<1024, 16> memory;
+		StackAllocator stack(memory);
+		DebugAllocator::Settings settings;
+		settings.trackBlocks = true;
+		settings.callSiteDepth = 1;
+		DebugAllocator allocator(stack, settings);
+
+		void* blocks[3];
+		for (void*& block : blocks)
+		{
+			block = AllocateFromHelper(allocator, 32);
+		}
+		void* other = allocator.Allocate(16);
+		void* freed = allocator.Allocate(8);
+		allocator.Deallocate(freed);
+
+		std::FILE* file = std::tmpfile();
+		DOCTEST_REQUIRE(file != nullptr);
+		DOCTEST_CHECK(allocator.WriteLeakReport(file) == 4);
+		const std::string report = ReadFile(file);
+		std::fclose(file);
+		DOCTEST_CHECK(report.find("4 blocks (112 bytes) still allocated") != std::string::npos);
+#if defined(__linux__)
+		// Blocks allocated from the same place are grouped, the largest group first
+		DOCTEST_CHECK(report.find("3 blocks (96 bytes) allocated from") < report.find("1 blocks (16 bytes) allocated from"));
+#endif
+
+		allocator.Deallocate(other);
+		for (std::size_t i = 3; i > 0; --i)
+		{
+			allocator.Deallocate(blocks[i - 1]);
+		}
+		file = std::tmpfile();
+		DOCTEST_REQUIRE(file != nullptr);
+		DOCTEST_CHECK(allocator.WriteLeakReport(file) == 0);
+		DOCTEST_CHECK(ReadFile(file).empty());
+		std::fclose(file);
+	}
+
+	DOCTEST_SUBCASE("Leak report of the allocators of a source")
+	{
+		std::FILE* file = std::tmpfile();
+		DOCTEST_REQUIRE(file != nullptr);
+		SetLeakReportFile(file);
+		{
+			StackMemory<256, 16> memory;
+			PoolAllocator pool(memory, 32);
+			void* leaked = pool.Allocate(32);
+			void* freed = pool.Allocate(32);
+			pool.Deallocate(freed);
+			DOCTEST_CHECK(leaked != nullptr);
+		}
+		{
+			StackMemory<256, 16> memory;
+			StackAllocator stack(memory);
+			void* ptr = stack.Allocate(16);
+			stack.Deallocate(ptr);
+		}
+		{
+			StackMemory<256, 16> memory;
+			StackAllocator stack(memory);
+			DebugAllocator::Settings settings;
+			settings.reportLeaks = true;
+			DebugAllocator allocator(stack, settings);
+			allocator.Allocate(8);
+		}
+		SetLeakReportFile(nullptr);
+		const std::string report = ReadFile(file);
+		std::fclose(file);
+		DOCTEST_CHECK(report.find("PoolAllocator") != std::string::npos);
+		DOCTEST_CHECK(report.find("1 blocks (32 bytes) still allocated") != std::string::npos);
+		DOCTEST_CHECK(report.find("DebugAllocator") != std::string::npos);
+		DOCTEST_CHECK(report.find("DebugAllocator") < report.find("1 blocks still allocated"));
+
+		// The StackAllocator below the DebugAllocator leaks the block too, the empty one doesn't report anything
+		DOCTEST_CHECK(report.find("StackAllocator") != std::string::npos);
+		DOCTEST_CHECK(report.find("StackAllocator") == report.rfind("StackAllocator"));
+	}
+}
\ No newline at end of file
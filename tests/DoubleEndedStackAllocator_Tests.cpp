@@ -0,0 +1,83 @@
+#include "../src/Dyma.hpp"
+#include "doctest.h"
+
+using namespace dyma;
+
+DOCTEST_TEST_CASE("DoubleEndedStackAllocator")
+{
+	DOCTEST_SUBCASE("Allocate")
+	{
+		StackMemory<256, 16> memory;
+		DoubleEndedStackAllocator allocator(memory);
+		DOCTEST_CHECK(allocator.Allocate(0) == nullptr);
+		DOCTEST_CHECK(allocator.AllocateTop(0) == nullptr);
+
+		void* bottom = allocator.AllocateBottom(8);
+		void* top = allocator.AllocateTop(8);
+		DOCTEST_CHECK(bottom == memory.GetPointer());
+		DOCTEST_CHECK(reinterpret_cast<std::uintptr_t>(top) + 16 == reinterpret_cast<std::uintptr_t>(memory.GetEndPointer()));
+		DOCTEST_CHECK(allocator.GetBottomUsedSize() == 16);
+		DOCTEST_CHECK(allocator.GetTopUsedSize() == 16);
+		DOCTEST_CHECK(allocator.GetRemainingSize() == 224);
+	}
+
+	DOCTEST_SUBCASE("Sides share the remaining memory")
+	{
+		StackMemory<256, 16> memory;
+		DoubleEndedStackAllocator allocator(memory);
+
+		// One side can use what the other side leaves unused
+		DOCTEST_CHECK(allocator.AllocateBottom(192) != nullptr);
+		DOCTEST_CHECK(allocator.AllocateTop(64) != nullptr);
+		DOCTEST_CHECK(allocator.GetRemainingSize() == 0);
+		DOCTEST_CHECK(allocator.AllocateTop(16) == nullptr);
+		DOCTEST_CHECK(allocator.AllocateBottom(16) == nullptr);
+
+		allocator.DeallocateTop();
+		DOCTEST_CHECK(allocator.GetTopUsedSize() == 0);
+		DOCTEST_CHECK(allocator.GetBottomUsedSize() == 192);
+		DOCTEST_CHECK(allocator.AllocateBottom(64) != nullptr);
+		DOCTEST_CHECK(allocator.AllocateTop(16) == nullptr);
+
+		allocator.DeallocateAll();
+		DOCTEST_CHECK(allocator.GetUsedSize() == 0);
+	}
+
+	DOCTEST_SUBCASE("Markers")
+	{
+		StackMemory<256, 16> memory;
+		DoubleEndedStackAllocator allocator(memory);
+
+		void* persistent = allocator.AllocateBottom(32);
+		const DoubleEndedStackAllocator::Marker bottomMarker = allocator.GetBottomMarker();
+		const DoubleEndedStackAllocator::Marker topMarker = allocator.GetTopMarker();
+		allocator.AllocateBottom(32);
+		allocator.AllocateTop(32);
+		allocator.AllocateTop(32);
+
+		allocator.FreeToBottomMarker(bottomMarker);
+		allocator.FreeToTopMarker(topMarker);
+		DOCTEST_CHECK(allocator.GetBottomUsedSize() == 32);
+		DOCTEST_CHECK(allocator.GetTopUsedSize() == 0);
+		DOCTEST_CHECK(allocator.Owns(persistent));
+	}
+
+	DOCTEST_SUBCASE("Deallocate")
+	{
+		StackMemory<256, 16> memory;
+		DoubleEndedStackAllocator allocator(memory);
+
+		void* bottom = allocator.Allocate(16);
+		void* top = allocator.AllocateTop(16);
+		DOCTEST_CHECK(allocator.Deallocate(bottom));
+		DOCTEST_CHECK(bottom == nullptr);
+		DOCTEST_CHECK(allocator.GetBottomUsedSize() == 0);
+		DOCTEST_CHECK(allocator.Deallocate(top));
+		DOCTEST_CHECK(top == nullptr);
+
+		int a;
+		void* aPtr = (void*)&a;
+		DOCTEST_CHECK(!allocator.Deallocate(aPtr));
+		DOCTEST_CHECK(aPtr == &a);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,82 @@
+#include "../src/Dyma.hpp"
+#include "doctest.h"
+
+#include <atomic>
+#include <thread>
+
+using namespace dyma;
+
+DOCTEST_TEST_CASE("EpochAllocator")
+{
+	DOCTEST_SUBCASE("Deferred deallocation")
+	{
+		StackMemory<64, 16> memory;
+		PoolAllocator pool(memory, 16);
+		EpochAllocator allocator(pool, 1);
+
+		void* blocks[4];
+		for (std::size_t i = 0; i < 4; ++i)
+		{
+			blocks[i] = allocator.Allocate(16);
+			DOCTEST_CHECK(blocks[i] != nullptr);
+		}
+
+		DOCTEST_CHECK(allocator.Deallocate(blocks[0]));
+		DOCTEST_CHECK(blocks[0] == nullptr);
+		DOCTEST_CHECK(allocator.Allocate(16) == nullptr);
+
+		// Two epochs later, the block is back in the pool
+		allocator.TryAdvanceEpoch();
+		allocator.TryAdvanceEpoch();
+		DOCTEST_CHECK(allocator.GetEpoch() >= 2);
+		DOCTEST_CHECK(allocator.Allocate(16) != nullptr);
+
+		int a;
+		void* aPtr = (void*)&a;
+		DOCTEST_CHECK(!allocator.Deallocate(aPtr));
+	}
+
+	DOCTEST_SUBCASE("Readers")
+	{
+		StackMemory<64, 16> memory;
+		PoolAllocator pool(memory, 16);
+		EpochAllocator allocator(pool, 1);
+
+		void* blocks[4];
+		for (std::size_t i = 0; i < 4; ++i)
+		{
+			blocks[i] = allocator.Allocate(16);
+		}
+
+		std::atomic<int> step(0);
+		std::thread reader([&allocator, &step]()
+		{
+			EpochGuard guard(allocator);
+			step = 1;
+			while (step != 2)
+			{
+				std::this_thread::yield();
+			}
+		});
+		while (step != 1)
+		{
+			std::this_thread::yield();
+		}
+
+		// The reader is stuck in its epoch, the block can't be reclaimed
+		const std::uint64_t epoch = allocator.GetEpoch();
+		DOCTEST_CHECK(allocator.Deallocate(blocks[0]));
+		for (std::size_t i = 0; i < 4; ++i)
+		{
+			allocator.TryAdvanceEpoch();
+		}
+		DOCTEST_CHECK(allocator.GetEpoch() <= epoch + 1);
+		DOCTEST_CHECK(allocator.Allocate(16) == nullptr);
+
+		step = 2;
+		reader.join();
+		allocator.TryAdvanceEpoch();
+		allocator.TryAdvanceEpoch();
+		DOCTEST_CHECK(allocator.Allocate(16) != nullptr);
+	}
+}
\ No newline at end of file
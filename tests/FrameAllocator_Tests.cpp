@@ -0,0 +1,84 @@
+#include "../src/Dyma.hpp"
+#include "doctest.h"
+
+using namespace dyma;
+
+DOCTEST_TEST_CASE("FrameAllocator")
+{
+	DOCTEST_SUBCASE("Allocate")
+	{
+		StackMemory<384, 16> memory;
+		FrameAllocator<3> allocator(memory);
+		DOCTEST_CHECK(allocator.GetFrameSize() == 128);
+
+		// Nothing can be allocated outside of a frame
+		DOCTEST_CHECK(allocator.Allocate(16) == nullptr);
+
+		DOCTEST_CHECK(allocator.BeginFrame());
+		DOCTEST_CHECK(allocator.Allocate(0) == nullptr);
+		void* a = allocator.Allocate(8);
+		DOCTEST_CHECK(a != nullptr);
+		DOCTEST_CHECK(allocator.Allocate(112) != nullptr);
+		DOCTEST_CHECK(allocator.Allocate(16) == nullptr);
+		DOCTEST_CHECK(allocator.GetUsedSize() == 128);
+		DOCTEST_CHECK(allocator.EndFrame() == 0);
+		DOCTEST_CHECK(allocator.Allocate(16) == nullptr);
+	}
+
+	DOCTEST_SUBCASE("Fences")
+	{
+		StackMemory<384, 16> memory;
+		FrameAllocator<3> allocator(memory);
+
+		void* frames[3];
+		for (std::uint64_t i = 0; i < 3; ++i)
+		{
+			DOCTEST_CHECK(allocator.BeginFrame());
+			frames[i] = allocator.Allocate(16);
+			DOCTEST_CHECK(allocator.EndFrame() == i);
+			DOCTEST_CHECK(allocator.IsFrameInFlight(i));
+		}
+
+		// Every frame is still used by the consumer
+		DOCTEST_CHECK(!allocator.BeginFrame());
+		DOCTEST_CHECK(!allocator.IsRecording());
+
+		DOCTEST_CHECK(allocator.ReleaseFrame(0));
+		DOCTEST_CHECK(!allocator.IsFrameInFlight(0));
+		DOCTEST_CHECK(allocator.BeginFrame());
+		DOCTEST_CHECK(allocator.Allocate(16) == frames[0]);
+		DOCTEST_CHECK(allocator.EndFrame() == 3);
+		DOCTEST_CHECK(!allocator.BeginFrame());
+
+		// A late or repeated release doesn't free the newer frame of the same slot
+		DOCTEST_CHECK(!allocator.IsFrameInFlight(0));
+		DOCTEST_CHECK(allocator.IsFrameInFlight(3));
+		DOCTEST_CHECK(!allocator.ReleaseFrame(0));
+		DOCTEST_CHECK(allocator.IsFrameInFlight(3));
+		DOCTEST_CHECK(!allocator.BeginFrame());
+		DOCTEST_CHECK(allocator.ReleaseFrame(3));
+		DOCTEST_CHECK(!allocator.IsFrameInFlight(3));
+		DOCTEST_CHECK(!allocator.ReleaseFrame(3));
+	}
+
+	DOCTEST_SUBCASE("High water")
+	{
+		StackMemory<256, 16> memory;
+		FrameAllocator<2> allocator(memory);
+
+		allocator.BeginFrame();
+		allocator.Allocate(64);
+		void* last = allocator.Allocate(32);
+		DOCTEST_CHECK(allocator.Deallocate(last));
+		DOCTEST_CHECK(allocator.GetUsedSize() == 64);
+		allocator.ReleaseFrame(allocator.EndFrame());
+
+		allocator.BeginFrame();
+		allocator.Allocate(16);
+		allocator.ReleaseFrame(allocator.EndFrame());
+
+		DOCTEST_CHECK(allocator.GetFrameHighWater(0) == 96);
+		DOCTEST_CHECK(allocator.GetFrameHighWater(1) == 16);
+		DOCTEST_CHECK(allocator.GetHighWater() == 96);
+	}
+}
\ No newline at end of file
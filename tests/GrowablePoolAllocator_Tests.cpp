@@ -0,0 +1,75 @@
+#include "../src/Dyma.hpp"
+#include "doctest.h"
+
+using namespace dyma;
+
+DOCTEST_TEST_CASE("GrowablePoolAllocator")
+{
+	DOCTEST_SUBCASE("Allocate")
+	{
+		Mallocator mallocator;
+		GrowablePoolAllocator allocator(mallocator, 16, 4);
+		DOCTEST_CHECK(allocator.GetChunkCount() == 0);
+		DOCTEST_CHECK(allocator.Allocate(8) == nullptr);
+		DOCTEST_CHECK(allocator.Allocate(32) == nullptr);
+
+		void* blocks[6];
+		for (std::size_t i = 0; i < 6; ++i)
+		{
+			blocks[i] = allocator.Allocate(16);
+			DOCTEST_CHECK(blocks[i] != nullptr);
+			DOCTEST_CHECK(allocator.Owns(blocks[i]));
+		}
+		DOCTEST_CHECK(allocator.GetChunkCount() == 2);
+
+		for (std::size_t i = 0; i < 6; ++i)
+		{
+			DOCTEST_CHECK(allocator.Deallocate(blocks[i]));
+			DOCTEST_CHECK(blocks[i] == nullptr);
+		}
+		DOCTEST_CHECK(allocator.GetChunkCount() == 0);
+	}
+
+	DOCTEST_SUBCASE("Chunk recycling")
+	{
+		StackMemory<1024> memory;
+		StackAllocator upstream(memory);
+		GrowablePoolAllocator allocator(upstream, 16, 4);
+
+		void* blocks[8];
+		for (std::size_t i = 0; i < 8; ++i)
+		{
+			blocks[i] = allocator.Allocate(16);
+		}
+		DOCTEST_CHECK(allocator.GetChunkCount() == 2);
+		const std::size_t usedSize = upstream.GetUsedSize();
+
+		// The first chunk gets a free block and is used again before growing
+		void* reused = blocks[1];
+		DOCTEST_CHECK(allocator.Deallocate(blocks[1]));
+		DOCTEST_CHECK(allocator.Allocate(16) == reused);
+		DOCTEST_CHECK(upstream.GetUsedSize() == usedSize);
+
+		// The last chunk is given back to the stack once all its blocks are free
+		for (std::size_t i = 4; i < 8; ++i)
+		{
+			DOCTEST_CHECK(allocator.Deallocate(blocks[i]));
+		}
+		DOCTEST_CHECK(allocator.GetChunkCount() == 1);
+		DOCTEST_CHECK(upstream.GetUsedSize() == usedSize / 2);
+	}
+
+	DOCTEST_SUBCASE("Deallocate")
+	{
+		Mallocator mallocator;
+		GrowablePoolAllocator allocator(mallocator, 16, 4);
+
+		void* iPtr = nullptr;
+		DOCTEST_CHECK(!allocator.Deallocate(iPtr));
+
+		int a;
+		void* aPtr = (void*)&a;
+		DOCTEST_CHECK(!allocator.Deallocate(aPtr));
+		DOCTEST_CHECK(!allocator.Owns(aPtr));
+	}
+}
\ No newline at end of file
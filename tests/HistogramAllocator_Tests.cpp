@@ -0,0 +1,128 @@
+#include "../src/Dyma.hpp"
+#include "doctest.h"
+
+#include <thread>
+#include <vector>
+
+using namespace dyma;
+
+DOCTEST_TEST_CASE("HistogramAllocator")
+{
+	DOCTEST_SUBCASE("Buckets")
+	{
+		DOCTEST_CHECK(HistogramAllocator::GetSizeBucket(1) == 0);
+		DOCTEST_CHECK(HistogramAllocator::GetSizeBucket(2) == 1);
+		DOCTEST_CHECK(HistogramAllocator::GetSizeBucket(3) == 2);
+		DOCTEST_CHECK(HistogramAllocator::GetSizeBucket(4) == 2);
+		DOCTEST_CHECK(HistogramAllocator::GetSizeBucket(5) == 3);
+		DOCTEST_CHECK(HistogramAllocator::GetSizeBucket(~std::uint64_t(0)) == 64);
+		DOCTEST_CHECK(HistogramAllocator::GetLifetimeBucket(0) == 0);
+		DOCTEST_CHECK(HistogramAllocator::GetLifetimeBucket(1) == 1);
+		DOCTEST_CHECK(HistogramAllocator::GetLifetimeBucket(2) == 1);
+		DOCTEST_CHECK(HistogramAllocator::GetLifetimeBucket(3) == 2);
+		DOCTEST_CHECK(HistogramAllocator::GetLifetimeBucket(~std::uint64_t(0)) == 63);
+	}
+
+	DOCTEST_SUBCASE("Histograms")
+	{
+		Mallocator mallocator;
+		HistogramAllocator::Settings settings;
+		settings.indexBatchSize = 1;
+		settings.checkOwnership = false;
+		HistogramAllocator allocator(mallocator, settings);
+		DOCTEST_CHECK(allocator.Allocate(0) == nullptr);
+		DOCTEST_CHECK(allocator.SuggestPoolBlockSize() == 0);
+		DOCTEST_CHECK(allocator.SuggestSegregatorThreshold() == 0);
+
+		// A long-lived block, and 3 allocations in between
+		void* longLived = allocator.Allocate(100);
+		void* shortLived = allocator.Allocate(24);
+		DOCTEST_CHECK(allocator.Owns(shortLived) == mallocator.Owns(shortLived));
+		DOCTEST_CHECK(allocator.Deallocate(shortLived));
+		DOCTEST_CHECK(shortLived == nullptr);
+		for (std::size_t i = 0; i < 2; ++i)
+		{
+			void* block = allocator.Allocate(20);
+			allocator.Deallocate(block);
+		}
+		allocator.Deallocate(longLived);
+
+		const HistogramAllocator::Histogram sizes = allocator.GetSizeHistogram();
+		DOCTEST_CHECK(sizes.GetTotal() == 4);
+		DOCTEST_CHECK(sizes.counts[5] == 3);
+		DOCTEST_CHECK(sizes.maxValues[5] == 24);
+		DOCTEST_CHECK(sizes.counts[7] == 1);
+
+		const HistogramAllocator::Histogram lifetimeCounts = allocator.GetLifetimeCountHistogram();
+		DOCTEST_CHECK(lifetimeCounts.GetTotal() == 4);
+		DOCTEST_CHECK(lifetimeCounts.counts[0] == 3);
+		DOCTEST_CHECK(lifetimeCounts.counts[2] == 1);
+		DOCTEST_CHECK(lifetimeCounts.maxValues[2] == 3);
+		DOCTEST_CHECK(allocator.GetLifetimeTimeHistogram().GetTotal() == 4);
+	}
+
+	DOCTEST_SUBCASE("Foreign blocks")
+	{
+		// Their header isn't read
+		StackMemory<256, 16> memory;
+		PoolAllocator pool(memory, 64);
+		HistogramAllocator allocator(pool);
+		void* ptr = allocator.Allocate(64 - allocator.GetHeaderSize());
+		DOCTEST_CHECK(ptr != nullptr);
+
+		Mallocator mallocator;
+		void* foreign = mallocator.Allocate(64);
+		void* foreignCopy = foreign;
+		DOCTEST_CHECK(!allocator.Deallocate(foreign));
+		DOCTEST_CHECK(foreign == foreignCopy);
+		mallocator.Deallocate(foreign);
+
+		DOCTEST_CHECK(allocator.Deallocate(ptr));
+		DOCTEST_CHECK(allocator.GetLifetimeCountHistogram().GetTotal() == 1);
+	}
+
+	DOCTEST_SUBCASE("Suggestions")
+	{
+		// Mostly blocks of 40 bytes, a few larger ones
+		Mallocator mallocator;
+		HistogramAllocator::Settings settings;
+		settings.checkOwnership = false;
+		HistogramAllocator allocator(mallocator, settings);
+		for (std::size_t i = 0; i < 100; ++i)
+		{
+			void* block = allocator.Allocate((i % 10 == 0) ? 1000 : 33 + i % 8);
+			allocator.Deallocate(block);
+		}
+		DOCTEST_CHECK(allocator.SuggestPoolBlockSize() == 48);
+		DOCTEST_CHECK(allocator.SuggestSegregatorThreshold(0.9) == 40);
+		DOCTEST_CHECK(allocator.SuggestSegregatorThreshold(1.0) == 1000);
+	}
+
+	DOCTEST_SUBCASE("Threads")
+	{
+		Mallocator mallocator;
+		HistogramAllocator::Settings settings;
+		settings.trackLifetimes = false;
+		HistogramAllocator allocator(mallocator, settings);
+		DOCTEST_CHECK(allocator.GetHeaderSize() == 0);
+
+		std::vector<std::thread> threads;
+		for (std::size_t t = 0; t < 8; ++t)
+		{
+			threads.emplace_back([&allocator]()
+			{
+				for (std::size_t i = 0; i < 1000; ++i)
+				{
+					void* block = allocator.Allocate(64);
+					allocator.Deallocate(block);
+				}
+			});
+		}
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+		DOCTEST_CHECK(allocator.GetSizeHistogram().counts[6] == 8 * 1000);
+		DOCTEST_CHECK(allocator.GetLifetimeCountHistogram().GetTotal() == 0);
+	}
+}
\ No newline at end of file
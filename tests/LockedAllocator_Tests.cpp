@@ -0,0 +1,157 @@
+#include "../src/Dyma.hpp"
+#include "doctest.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace dyma;
+
+DOCTEST_TEST_CASE("LockedAllocator")
+{
+	DOCTEST_SUBCASE("Sources")
+	{
+		StackMemory<256, 16> memory;
+		PoolAllocator pool(memory, 32);
+		ConcurrentPoolAllocator concurrentPool(memory, 32);
+		Mallocator mallocator;
+		DOCTEST_CHECK(pool.GetSource() == &memory);
+		DOCTEST_CHECK(!pool.IsThreadSafe());
+		DOCTEST_CHECK(concurrentPool.IsThreadSafe());
+		DOCTEST_CHECK(mallocator.GetSource() == nullptr);
+		DOCTEST_CHECK(mallocator.IsThreadSafe());
+
+		FallbackAllocator fallback(pool, mallocator);
+		DOCTEST_CHECK(fallback.GetSource() == nullptr);
+		DOCTEST_CHECK(!fallback.IsThreadSafe());
+
+		LockedAllocator locked(pool);
+		DOCTEST_CHECK(locked.GetSource() == &memory);
+		DOCTEST_CHECK(locked.IsThreadSafe());
+		DOCTEST_CHECK(&locked.GetAllocator() == &pool);
+		void* ptr = locked.Allocate(32);
+		DOCTEST_CHECK(locked.Owns(ptr));
+		DOCTEST_CHECK(locked.Deallocate(ptr));
+		DOCTEST_CHECK(ptr == nullptr);
+	}
+
+	DOCTEST_SUBCASE("Without source")
+	{
+		Mallocator mallocator;
+		GrowablePoolAllocator growablePool(mallocator, 32, 8);
+		LockedAllocator locked(growablePool);
+		DOCTEST_CHECK(locked.GetSource() == nullptr);
+
+		void* ptr = locked.Allocate(32);
+		DOCTEST_CHECK(locked.Owns(ptr));
+		DOCTEST_CHECK(locked.Deallocate(ptr));
+	}
+}
+
+DOCTEST_TEST_CASE("ConcurrentFallbackAllocator")
+{
+	DOCTEST_SUBCASE("Fallback")
+	{
+		StackMemory<64, 16> memory;
+		PoolAllocator pool(memory, 32);
+		Mallocator mallocator;
+		ConcurrentFallbackAllocator allocator(pool, mallocator);
+		DOCTEST_CHECK(allocator.IsThreadSafe());
+
+		void* a = allocator.Allocate(32);
+		void* b = allocator.Allocate(32);
+		void* c = allocator.Allocate(32);
+		DOCTEST_CHECK(memory.Owns(a));
+		DOCTEST_CHECK(memory.Owns(b));
+		DOCTEST_CHECK(c != nullptr);
+		DOCTEST_CHECK(!memory.Owns(c));
+		DOCTEST_CHECK(allocator.Owns(a));
+		DOCTEST_CHECK(allocator.Deallocate(a));
+		DOCTEST_CHECK(allocator.Deallocate(c));
+		DOCTEST_CHECK(allocator.Allocate(32) != nullptr);
+	}
+
+	DOCTEST_SUBCASE("Threads")
+	{
+		HeapMemory memory(64 * 256);
+		PoolAllocator pool(memory, 64);
+		Mallocator mallocator;
+		ConcurrentFallbackAllocator allocator(pool, mallocator);
+
+		std::atomic<std::size_t> errorCount(0);
+		std::vector<std::thread> threads;
+		for (std::size_t t = 0; t < 8; ++t)
+		{
+			threads.emplace_back([&allocator, &errorCount, t]()
+			{
+				void* blocks[64];
+				for (std::size_t iteration = 0; iteration < 200; ++iteration)
+				{
+					for (std::size_t i = 0; i < 64; ++i)
+					{
+						blocks[i] = allocator.Allocate(64);
+						*static_cast<std::size_t*>(blocks[i]) = t;
+					}
+					for (std::size_t i = 0; i < 64; ++i)
+					{
+						if (*static_cast<std::size_t*>(blocks[i]) != t)
+						{
+							errorCount++;
+						}
+						allocator.Deallocate(blocks[i]);
+					}
+				}
+			});
+		}
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+		DOCTEST_CHECK(errorCount == 0);
+	}
+}
+
+DOCTEST_TEST_CASE("ConcurrentSegregatorAllocator")
+{
+	HeapMemory memory(32 * 1024);
+	PoolAllocator pool(memory, 32);
+	Mallocator mallocator;
+	ConcurrentSegregatorAllocator allocator(32, pool, mallocator);
+	DOCTEST_CHECK(allocator.GetThreshold() == 32);
+
+	std::atomic<std::size_t> errorCount(0);
+	std::vector<std::thread> threads;
+	for (std::size_t t = 0; t < 8; ++t)
+	{
+		threads.emplace_back([&allocator, &memory, &errorCount, t]()
+		{
+			void* blocks[64];
+			for (std::size_t iteration = 0; iteration < 200; ++iteration)
+			{
+				for (std::size_t i = 0; i < 64; ++i)
+				{
+					const std::size_t size = (i % 2 == 0) ? 32 : 128;
+					blocks[i] = allocator.Allocate(size);
+					if (memory.Owns(blocks[i]) != (size <= 32))
+					{
+						errorCount++;
+					}
+					*static_cast<std::size_t*>(blocks[i]) = t;
+				}
+				for (std::size_t i = 0; i < 64; ++i)
+				{
+					if (*static_cast<std::size_t*>(blocks[i]) != t)
+					{
+						errorCount++;
+					}
+					allocator.Deallocate(blocks[i]);
+				}
+			}
+		});
+	}
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+	DOCTEST_CHECK(errorCount == 0);
+}
\ No newline at end of file
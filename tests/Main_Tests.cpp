@@ -1,4 +1,7 @@
 #ifndef DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #endif
+#ifndef DOCTEST_CONFIG_NO_POSIX_SIGNALS
+#define DOCTEST_CONFIG_NO_POSIX_SIGNALS // SIGSTKSZ isn't a constant anymore with recent glibc
+#endif
 #include "doctest.h"
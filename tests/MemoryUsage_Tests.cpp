@@ -0,0 +1,144 @@
+#include "../src/Dyma.hpp"
+#include "doctest.h"
+
+using namespace dyma;
+
+DOCTEST_TEST_CASE("MemoryUsage")
+{
+	DOCTEST_SUBCASE("Unknown usage")
+	{
+		Mallocator mallocator;
+		void* ptr = mallocator.Allocate(64);
+		const MemoryUsage usage = mallocator.GetMemoryUsage();
+		DOCTEST_CHECK(usage.usedSize == 0);
+		DOCTEST_CHECK(usage.freeSize == 0);
+		DOCTEST_CHECK(usage.freeBlockCount == 0);
+		mallocator.Deallocate(ptr);
+	}
+
+	DOCTEST_SUBCASE("StackAllocator")
+	{
+		StackMemory<256, 16> memory;
+		StackAllocator allocator(memory);
+		allocator.Allocate(10);
+		allocator.Allocate(16);
+		MemoryUsage usage = allocator.GetMemoryUsage();
+		DOCTEST_CHECK(usage.usedSize == 32);
+		DOCTEST_CHECK(usage.freeSize == 224);
+		DOCTEST_CHECK(usage.largestFreeBlock == 224);
+		DOCTEST_CHECK(usage.wastedSize == 6);
+		DOCTEST_CHECK(usage.freeBlockCount == 1);
+
+		// The waste is reset once the stack is empty
+		allocator.DeallocateAll();
+		allocator.Allocate(16);
+		usage = allocator.GetMemoryUsage();
+		DOCTEST_CHECK(usage.usedSize == 16);
+		DOCTEST_CHECK(usage.wastedSize == 0);
+	}
+
+	DOCTEST_SUBCASE("RingAllocator")
+	{
+		StackMemory<256, 16> memory;
+		RingAllocator allocator(memory);
+		void* first = allocator.Allocate(8);
+		allocator.Allocate(8);
+		MemoryUsage usage = allocator.GetMemoryUsage();
+		DOCTEST_CHECK(usage.usedSize == allocator.GetUsedSize());
+		DOCTEST_CHECK(usage.wastedSize == usage.usedSize - 16);
+		DOCTEST_CHECK(usage.freeSize == 256 - usage.usedSize);
+		DOCTEST_CHECK(usage.largestFreeBlock == usage.freeSize);
+		DOCTEST_CHECK(usage.freeBlockCount == 1);
+
+		// The free memory is split around the remaining block
+		allocator.Deallocate(first);
+		usage = allocator.GetMemoryUsage();
+		DOCTEST_CHECK(usage.freeBlockCount == 2);
+		DOCTEST_CHECK(usage.largestFreeBlock == 256 - 2 * usage.usedSize);
+	}
+
+	DOCTEST_SUBCASE("FrameAllocator")
+	{
+		StackMemory<256, 16> memory;
+		FrameAllocator<2> allocator(memory);
+		allocator.BeginFrame();
+		allocator.Allocate(8);
+		MemoryUsage usage = allocator.GetMemoryUsage();
+		DOCTEST_CHECK(usage.usedSize == 16);
+		DOCTEST_CHECK(usage.wastedSize == 8);
+		DOCTEST_CHECK(usage.freeSize == 240);
+		DOCTEST_CHECK(usage.largestFreeBlock == 128);
+		DOCTEST_CHECK(usage.freeBlockCount == 2);
+
+		// The frame in flight is held until it is released
+		const std::uint64_t frameNumber = allocator.EndFrame();
+		usage = allocator.GetMemoryUsage();
+		DOCTEST_CHECK(usage.usedSize == 128);
+		DOCTEST_CHECK(usage.wastedSize == 120);
+		DOCTEST_CHECK(usage.freeSize == 128);
+		allocator.ReleaseFrame(frameNumber);
+		DOCTEST_CHECK(allocator.GetMemoryUsage().freeSize == 256);
+	}
+
+	DOCTEST_SUBCASE("PoolAllocator")
+	{
+		StackMemory<256, 16> memory;
+		PoolAllocator allocator(memory, 32);
+		allocator.Allocate(32);
+		allocator.Allocate(32);
+		const MemoryUsage usage = allocator.GetMemoryUsage();
+		DOCTEST_CHECK(usage.usedSize == 64);
+		DOCTEST_CHECK(usage.freeSize == 192);
+		DOCTEST_CHECK(usage.largestFreeBlock == 32);
+		DOCTEST_CHECK(usage.freeBlockCount == 6);
+		DOCTEST_CHECK(usage.wastedSize == 0);
+	}
+
+	DOCTEST_SUBCASE("GrowablePoolAllocator")
+	{
+		Mallocator mallocator;
+		GrowablePoolAllocator allocator(mallocator, 32, 4);
+		DOCTEST_CHECK(allocator.GetMemoryUsage().usedSize == 0);
+		void* ptr = allocator.Allocate(32);
+		const MemoryUsage usage = allocator.GetMemoryUsage();
+		DOCTEST_CHECK(usage.usedSize == allocator.GetChunkSize() - 3 * 32);
+		DOCTEST_CHECK(usage.wastedSize == allocator.GetChunkSize() - 4 * 32);
+		DOCTEST_CHECK(usage.freeSize == 96);
+		DOCTEST_CHECK(usage.freeBlockCount == 3);
+		allocator.Deallocate(ptr);
+	}
+
+	DOCTEST_SUBCASE("Composite allocators sum their children")
+	{
+		StackMemory<256, 16> poolMemory;
+		StackMemory<512, 16> stackMemory;
+		PoolAllocator pool(poolMemory, 32);
+		StackAllocator stack(stackMemory);
+		SegregatorAllocator allocator(32, pool, stack);
+		allocator.Allocate(32);
+		allocator.Allocate(40);
+		const MemoryUsage usage = allocator.GetMemoryUsage();
+		DOCTEST_CHECK(usage.usedSize == 32 + 48);
+		DOCTEST_CHECK(usage.freeSize == 224 + 464);
+		DOCTEST_CHECK(usage.largestFreeBlock == 464);
+		DOCTEST_CHECK(usage.wastedSize == 8);
+		DOCTEST_CHECK(usage.freeBlockCount == 7 + 1);
+
+		LockedAllocator locked(allocator);
+		DOCTEST_CHECK(locked.GetMemoryUsage().usedSize == usage.usedSize);
+	}
+
+	DOCTEST_SUBCASE("DebugAllocator headers are wasted")
+	{
+		StackMemory<256, 16> memory;
+		StackAllocator stack(memory);
+		DebugAllocator::Settings settings;
+		settings.blockHeaders = true;
+		DebugAllocator allocator(stack, settings);
+		void* ptr = allocator.Allocate(16);
+		const MemoryUsage usage = allocator.GetMemoryUsage();
+		DOCTEST_CHECK(usage.usedSize == allocator.GetHeaderSize() + 16);
+		DOCTEST_CHECK(usage.wastedSize == allocator.GetHeaderSize());
+		allocator.Deallocate(ptr);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,92 @@
+#include "../src/Dyma.hpp"
+#include "doctest.h"
+
+#include <random>
+#include <unordered_map>
+
+using namespace dyma;
+
+DOCTEST_TEST_CASE("PointerMap")
+{
+	DOCTEST_SUBCASE("Insert/Find/Remove")
+	{
+		Mallocator mallocator;
+		PointerMap<std::size_t> map(mallocator);
+		int a;
+		int b;
+		DOCTEST_CHECK(map.Find(&a) == nullptr);
+		DOCTEST_CHECK(!map.Remove(&a));
+
+		DOCTEST_CHECK(map.Insert(&a, 1));
+		DOCTEST_CHECK(map.Insert(&b, 2));
+		DOCTEST_CHECK(map.Insert(&a, 3));
+		DOCTEST_CHECK(map.GetSize() == 2);
+		DOCTEST_CHECK(*map.Find(&a) == 3);
+
+		std::size_t value = 0;
+		DOCTEST_CHECK(map.Remove(&b, &value));
+		DOCTEST_CHECK(value == 2);
+		DOCTEST_CHECK(map.Find(&b) == nullptr);
+		DOCTEST_CHECK(map.GetSize() == 1);
+
+		map.Clear();
+		DOCTEST_CHECK(map.GetSize() == 0);
+		DOCTEST_CHECK(map.Find(&a) == nullptr);
+	}
+
+	DOCTEST_SUBCASE("Own allocator")
+	{
+		// The table can't grow once its memory is used
+		StackMemory<16 * 2 * sizeof(void*), 16> memory;
+		StackAllocator stackAllocator(memory);
+		PointerMap<std::size_t> map(stackAllocator);
+		for (std::uintptr_t i = 1; i <= 12; ++i)
+		{
+			DOCTEST_CHECK(map.Insert(reinterpret_cast<const void*>(i * 16), i));
+		}
+		DOCTEST_CHECK(map.GetCapacity() == 16);
+		DOCTEST_CHECK(!map.Insert(reinterpret_cast<const void*>(13 * 16), 13));
+	}
+
+	DOCTEST_SUBCASE("Random operations")
+	{
+		// Removals shift the colliding slots back, every remaining pointer should still be found
+		Mallocator mallocator;
+		PointerMap<std::size_t> map(mallocator);
+		std::unordered_map<std::uintptr_t, std::size_t> reference;
+		std::mt19937 random(42);
+		std::size_t errorCount = 0;
+		for (std::size_t i = 0; i < 100000; ++i)
+		{
+			const std::uintptr_t key = (random() % 4096 + 1) * 16;
+			if (random() % 3 == 0)
+			{
+				if (map.Remove(reinterpret_cast<const void*>(key)) != (reference.erase(key) == 1))
+				{
+					errorCount++;
+				}
+			}
+			else
+			{
+				map.Insert(reinterpret_cast<const void*>(key), i);
+				reference[key] = i;
+			}
+		}
+		for (const auto& entry : reference)
+		{
+			const std::size_t* value = map.Find(reinterpret_cast<const void*>(entry.first));
+			if (value == nullptr || *value != entry.second)
+			{
+				errorCount++;
+			}
+		}
+		std::size_t visited = 0;
+		map.ForEach([&visited](const void*, std::size_t)
+		{
+			visited++;
+		});
+		DOCTEST_CHECK(errorCount == 0);
+		DOCTEST_CHECK(map.GetSize() == reference.size());
+		DOCTEST_CHECK(visited == reference.size());
+	}
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+#include "../src/Dyma.hpp"
+#include "doctest.h"
+
+using namespace dyma;
+
+DOCTEST_TEST_CASE("PoolAllocator")
+{
+	DOCTEST_SUBCASE("Every block can be allocated")
+	{
+		StackMemory<256, 16> memory;
+		PoolAllocator allocator(memory, 32);
+		DOCTEST_CHECK(allocator.GetBlockCount() == 8);
+		DOCTEST_CHECK(allocator.Allocate(16) == nullptr);
+
+		void* blocks[8];
+		for (std::size_t i = 0; i < 8; ++i)
+		{
+			blocks[i] = allocator.Allocate(32);
+			DOCTEST_CHECK(blocks[i] != nullptr);
+			DOCTEST_CHECK(allocator.Owns(blocks[i]));
+		}
+		DOCTEST_CHECK(allocator.Allocate(32) == nullptr);
+
+		// The last block of the source is the last one given
+		DOCTEST_CHECK(reinterpret_cast<std::uintptr_t>(blocks[7]) + 32 == reinterpret_cast<std::uintptr_t>(memory.GetEndPointer()));
+
+		for (std::size_t i = 0; i < 8; ++i)
+		{
+			DOCTEST_CHECK(allocator.Deallocate(blocks[i]));
+			DOCTEST_CHECK(blocks[i] == nullptr);
+		}
+		DOCTEST_CHECK(allocator.Allocate(32) != nullptr);
+	}
+
+	DOCTEST_SUBCASE("Single block")
+	{
+		StackMemory<32, 16> memory;
+		PoolAllocator allocator(memory, 32);
+		void* block = allocator.Allocate(32);
+		DOCTEST_CHECK(block == memory.GetPointer());
+		DOCTEST_CHECK(allocator.Allocate(32) == nullptr);
+		DOCTEST_CHECK(allocator.Deallocate(block));
+	}
+}
\ No newline at end of file
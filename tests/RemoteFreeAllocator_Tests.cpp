@@ -0,0 +1,64 @@
+#include "../src/Dyma.hpp"
+#include "doctest.h"
+
+#include <thread>
+
+using namespace dyma;
+
+DOCTEST_TEST_CASE("RemoteFreeAllocator")
+{
+	DOCTEST_SUBCASE("Owner thread")
+	{
+		StackMemory<256, 16> memory;
+		PoolAllocator pool(memory, 16);
+		RemoteFreeAllocator allocator(pool);
+		DOCTEST_CHECK(allocator.IsOwnerThread());
+
+		void* ptr = allocator.Allocate(16);
+		void* ptrCopy = ptr;
+		DOCTEST_CHECK(allocator.Owns(ptr));
+		DOCTEST_CHECK(allocator.Deallocate(ptr));
+		DOCTEST_CHECK(ptr == nullptr);
+		DOCTEST_CHECK(allocator.DrainRemoteFrees() == 0);
+		DOCTEST_CHECK(allocator.Allocate(16) == ptrCopy);
+
+		int a;
+		void* aPtr = (void*)&a;
+		DOCTEST_CHECK(!allocator.Deallocate(aPtr));
+	}
+
+	DOCTEST_SUBCASE("Remote frees")
+	{
+		StackMemory<256, 16> memory;
+		PoolAllocator pool(memory, 16);
+		RemoteFreeAllocator allocator(pool);
+
+		void* blocks[16];
+		for (std::size_t i = 0; i < 16; ++i)
+		{
+			blocks[i] = allocator.Allocate(16);
+		}
+		DOCTEST_CHECK(allocator.Allocate(16) == nullptr);
+
+		// Another thread frees every block, they go back to the pool on the next allocation
+		std::thread consumer([&allocator, &blocks]()
+		{
+			DOCTEST_CHECK(!allocator.IsOwnerThread());
+			for (std::size_t i = 0; i < 16; ++i)
+			{
+				allocator.Deallocate(blocks[i]);
+			}
+		});
+		consumer.join();
+		for (std::size_t i = 0; i < 16; ++i)
+		{
+			DOCTEST_CHECK(blocks[i] == nullptr);
+		}
+
+		for (std::size_t i = 0; i < 16; ++i)
+		{
+			DOCTEST_CHECK(allocator.Allocate(16) != nullptr);
+		}
+		DOCTEST_CHECK(allocator.Allocate(16) == nullptr);
+	}
+}
\ No newline at end of file
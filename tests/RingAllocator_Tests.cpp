@@ -0,0 +1,103 @@
+#include "../src/Dyma.hpp"
+#include "doctest.h"
+
+using namespace dyma;
+
+DOCTEST_TEST_CASE("RingAllocator")
+{
+	DOCTEST_SUBCASE("Allocate")
+	{
+		StackMemory<256, 16> memory;
+		RingAllocator allocator(memory);
+		DOCTEST_CHECK(allocator.Allocate(0) == nullptr);
+		DOCTEST_CHECK(allocator.Allocate(512) == nullptr);
+
+		void* a = allocator.Allocate(8);
+		void* b = allocator.Allocate(16);
+		DOCTEST_CHECK(a != nullptr);
+		DOCTEST_CHECK(b != nullptr);
+		DOCTEST_CHECK(allocator.Owns(a));
+		DOCTEST_CHECK(allocator.Owns(b));
+		DOCTEST_CHECK(reinterpret_cast<std::uintptr_t>(a) % 16 == 0);
+		DOCTEST_CHECK(reinterpret_cast<std::uintptr_t>(b) % 16 == 0);
+		DOCTEST_CHECK(allocator.GetUsedSize() == 64);
+	}
+
+	DOCTEST_SUBCASE("FIFO")
+	{
+		StackMemory<256, 16> memory;
+		RingAllocator allocator(memory);
+
+		// Each block takes 64 bytes with its header
+		void* blocks[4];
+		for (std::size_t i = 0; i < 4; ++i)
+		{
+			blocks[i] = allocator.Allocate(48);
+			DOCTEST_CHECK(blocks[i] != nullptr);
+		}
+		DOCTEST_CHECK(allocator.Allocate(16) == nullptr);
+
+		DOCTEST_CHECK(allocator.Deallocate(blocks[0]));
+		DOCTEST_CHECK(blocks[0] == nullptr);
+		void* wrapped = allocator.Allocate(48);
+		DOCTEST_CHECK(wrapped != nullptr);
+		DOCTEST_CHECK(reinterpret_cast<std::uintptr_t>(wrapped) < reinterpret_cast<std::uintptr_t>(blocks[1]));
+		DOCTEST_CHECK(allocator.Allocate(16) == nullptr);
+
+		allocator.DeallocateAll();
+		DOCTEST_CHECK(allocator.GetUsedSize() == 0);
+	}
+
+	DOCTEST_SUBCASE("Out of order")
+	{
+		StackMemory<256, 16> memory;
+		RingAllocator allocator(memory);
+
+		void* a = allocator.Allocate(48);
+		void* b = allocator.Allocate(48);
+		void* c = allocator.Allocate(48);
+
+		// b is only reclaimed once a is freed
+		DOCTEST_CHECK(allocator.Deallocate(b));
+		DOCTEST_CHECK(allocator.GetUsedSize() == 192);
+		DOCTEST_CHECK(allocator.Deallocate(a));
+		DOCTEST_CHECK(allocator.GetUsedSize() == 64);
+		DOCTEST_CHECK(allocator.Deallocate(c));
+		DOCTEST_CHECK(allocator.GetUsedSize() == 0);
+	}
+
+	DOCTEST_SUBCASE("Wrap around")
+	{
+		StackMemory<256, 16> memory;
+		RingAllocator allocator(memory);
+
+		void* a = allocator.Allocate(80); // 96 bytes
+		void* b = allocator.Allocate(80); // 96 bytes
+		DOCTEST_CHECK(allocator.Deallocate(a));
+
+		// Doesn't fit in the 64 bytes left at the end, the block is placed at the beginning
+		void* c = allocator.Allocate(64); // 80 bytes
+		DOCTEST_CHECK(c != nullptr);
+		DOCTEST_CHECK(reinterpret_cast<std::uintptr_t>(c) < reinterpret_cast<std::uintptr_t>(b));
+		DOCTEST_CHECK(allocator.GetUsedSize() == 96 + 64 + 80);
+
+		// The padding at the end is reclaimed with b
+		DOCTEST_CHECK(allocator.Deallocate(b));
+		DOCTEST_CHECK(allocator.GetUsedSize() == 80);
+		DOCTEST_CHECK(allocator.Deallocate(c));
+		DOCTEST_CHECK(allocator.GetUsedSize() == 0);
+	}
+
+	DOCTEST_SUBCASE("Deallocate")
+	{
+		StackMemory<256, 16> memory;
+		RingAllocator allocator(memory);
+
+		void* iPtr = nullptr;
+		DOCTEST_CHECK(!allocator.Deallocate(iPtr));
+
+		int a;
+		void* aPtr = (void*)&a;
+		DOCTEST_CHECK(!allocator.Deallocate(aPtr));
+	}
+}
\ No newline at end of file
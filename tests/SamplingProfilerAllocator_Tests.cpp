@@ -0,0 +1,115 @@
+#include "../src/Dyma.hpp"
+#include "doctest.h"
+
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+using namespace dyma;
+
+namespace
+{
+
+void* AllocateFromFirstSite(Allocator& allocator)
+{
+	return allocator.Allocate(32);
+}
+
+void* AllocateFromSecondSite(Allocator& allocator)
+{
+	return allocator.Allocate(64);
+}
+
+} // namespace
+
+DOCTEST_TEST_CASE("SamplingProfilerAllocator")
+{
+	DOCTEST_SUBCASE("Every allocation")
+	{
+		Mallocator mallocator;
+		SamplingProfilerAllocator::Settings settings;
+		settings.samplingInterval = 0;
+		SamplingProfilerAllocator allocator(mallocator, settings);
+
+		void* blocks[4];
+		blocks[0] = AllocateFromFirstSite(allocator);
+		blocks[1] = AllocateFromFirstSite(allocator);
+		blocks[2] = AllocateFromSecondSite(allocator);
+		blocks[3] = AllocateFromSecondSite(allocator);
+		DOCTEST_CHECK(allocator.GetInUseSampleCount() == 4);
+		DOCTEST_CHECK(allocator.Deallocate(blocks[0]));
+		DOCTEST_CHECK(allocator.Deallocate(blocks[2]));
+		DOCTEST_CHECK(allocator.GetInUseSampleCount() == 2);
+
+		std::FILE* file = std::tmpfile();
+		DOCTEST_REQUIRE(file != nullptr);
+		DOCTEST_CHECK(allocator.WriteProfile(file));
+		std::rewind(file);
+		char line[256];
+		DOCTEST_CHECK(std::fgets(line, sizeof(line), file) != nullptr);
+		DOCTEST_CHECK(std::strcmp(line, "heap profile: 2: 96 [4: 192] @ heap_v2/0\n") == 0);
+		std::fclose(file);
+
+		allocator.Deallocate(blocks[1]);
+		allocator.Deallocate(blocks[3]);
+		DOCTEST_CHECK(allocator.GetInUseSampleCount() == 0);
+	}
+
+	DOCTEST_SUBCASE("Sampling interval")
+	{
+		// About one sample every 4096 bytes
+		Mallocator mallocator;
+		SamplingProfilerAllocator::Settings settings;
+		settings.samplingInterval = 4096;
+		SamplingProfilerAllocator allocator(mallocator, settings);
+
+		std::vector<void*> blocks;
+		for (std::size_t i = 0; i < 4096; ++i)
+		{
+			blocks.push_back(allocator.Allocate(64));
+		}
+		const std::size_t sampleCount = allocator.GetInUseSampleCount();
+		DOCTEST_CHECK(sampleCount > 64 / 2);
+		DOCTEST_CHECK(sampleCount < 64 * 2);
+		for (void* block : blocks)
+		{
+			allocator.Deallocate(block);
+		}
+		DOCTEST_CHECK(allocator.GetInUseSampleCount() == 0);
+	}
+
+	DOCTEST_SUBCASE("Threads")
+	{
+		Mallocator mallocator;
+		SamplingProfilerAllocator::Settings settings;
+		settings.samplingInterval = 1024;
+		SamplingProfilerAllocator allocator(mallocator, settings);
+
+		std::vector<std::thread> threads;
+		for (std::size_t t = 0; t < 8; ++t)
+		{
+			threads.emplace_back([&allocator]()
+			{
+				void* blocks[64];
+				for (std::size_t iteration = 0; iteration < 100; ++iteration)
+				{
+					for (std::size_t i = 0; i < 64; ++i)
+					{
+						blocks[i] = allocator.Allocate(32);
+					}
+					for (std::size_t i = 0; i < 64; ++i)
+					{
+						allocator.Deallocate(blocks[i]);
+					}
+				}
+			});
+		}
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+		DOCTEST_CHECK(allocator.GetInUseSampleCount() == 0);
+		DOCTEST_CHECK(allocator.GetStackCount() > 0);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,55 @@
+#include "../src/Dyma.hpp"
+#include "doctest.h"
+
+using namespace dyma;
+
+DOCTEST_TEST_CASE("ScopedArena")
+{
+	DOCTEST_SUBCASE("Markers")
+	{
+		StackMemory<256, 16> memory;
+		StackAllocator allocator(memory);
+
+		allocator.Allocate(16);
+		const StackAllocator::Marker marker = allocator.GetMarker();
+		allocator.Allocate(32);
+		allocator.Allocate(64);
+		DOCTEST_CHECK(allocator.GetUsedSize() == 112);
+		allocator.FreeToMarker(marker);
+		DOCTEST_CHECK(allocator.GetUsedSize() == 16);
+	}
+
+	DOCTEST_SUBCASE("Restore on scope exit")
+	{
+		StackMemory<256, 16> memory;
+		StackAllocator allocator(memory);
+		void* persistent = allocator.Allocate(16);
+		{
+			ScopedArena arena(allocator);
+			DOCTEST_CHECK(arena.Allocate(32) != nullptr);
+			DOCTEST_CHECK(arena.Allocate(64) != nullptr);
+			DOCTEST_CHECK(allocator.GetUsedSize() == 112);
+		}
+		DOCTEST_CHECK(allocator.GetUsedSize() == 16);
+		DOCTEST_CHECK(allocator.Owns(persistent));
+	}
+
+	DOCTEST_SUBCASE("Scratch arenas")
+	{
+		ScopedArena outer = GetScratchArena();
+		void* outerPtr = outer.Allocate(64);
+		DOCTEST_CHECK(outerPtr != nullptr);
+		{
+			// A nested scratch arena never reuses the arena of its caller
+			ScopedArena inner = GetScratchArena(&outer);
+			DOCTEST_CHECK(&inner.GetAllocator() != &outer.GetAllocator());
+			void* innerPtr = inner.Allocate(64);
+			DOCTEST_CHECK(innerPtr != nullptr);
+			DOCTEST_CHECK(!outer.Owns(innerPtr));
+
+			ScopedArena innerMost = GetScratchArena(&inner);
+			DOCTEST_CHECK(&innerMost.GetAllocator() == &outer.GetAllocator());
+		}
+		DOCTEST_CHECK(outer.GetAllocator().GetMarker() == reinterpret_cast<std::uintptr_t>(outerPtr) + 64);
+	}
+}
\ No newline at end of file
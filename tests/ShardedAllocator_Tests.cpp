@@ -0,0 +1,84 @@
+#include "../src/Dyma.hpp"
+#include "doctest.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace dyma;
+
+DOCTEST_TEST_CASE("ShardedAllocator")
+{
+	DOCTEST_SUBCASE("Allocate")
+	{
+		StackMemory<64, 16> memoryA;
+		StackMemory<64, 16> memoryB;
+		PoolAllocator poolA(memoryA, 16);
+		PoolAllocator poolB(memoryB, 16);
+		ShardedAllocator<2> allocator(poolA, poolB);
+		DOCTEST_CHECK(allocator.GetShardCount() == 2);
+		DOCTEST_CHECK(&allocator.GetShard(1) == &poolB);
+
+		// A full shard makes the allocation go to the other one
+		void* blocks[8];
+		for (std::size_t i = 0; i < 8; ++i)
+		{
+			blocks[i] = allocator.Allocate(16);
+			DOCTEST_CHECK(blocks[i] != nullptr);
+			DOCTEST_CHECK(allocator.Owns(blocks[i]));
+		}
+		DOCTEST_CHECK(allocator.Allocate(16) == nullptr);
+
+		// Blocks go back to their shard
+		void* blockB = memoryB.Owns(blocks[0]) ? blocks[0] : blocks[7];
+		void* blockBCopy = blockB;
+		DOCTEST_CHECK(memoryB.Owns(blockB));
+		DOCTEST_CHECK(allocator.Deallocate(blockB));
+		DOCTEST_CHECK(blockB == nullptr);
+		DOCTEST_CHECK(poolB.Allocate(16) == blockBCopy);
+
+		int a;
+		void* aPtr = (void*)&a;
+		DOCTEST_CHECK(!allocator.Deallocate(aPtr));
+		DOCTEST_CHECK(!allocator.Owns(aPtr));
+	}
+
+	DOCTEST_SUBCASE("Threads")
+	{
+		HeapMemory memories[4] = { HeapMemory(16 * 1024), HeapMemory(16 * 1024), HeapMemory(16 * 1024), HeapMemory(16 * 1024) };
+		PoolAllocator pools[4] = { PoolAllocator(memories[0], 64), PoolAllocator(memories[1], 64), PoolAllocator(memories[2], 64), PoolAllocator(memories[3], 64) };
+		ShardedAllocator<4> allocator(pools[0], pools[1], pools[2], pools[3]);
+		allocator.SetShardSelection(ShardedAllocator<4>::ShardSelection::Cpu);
+
+		std::atomic<std::size_t> errorCount(0);
+		std::vector<std::thread> threads;
+		for (std::size_t t = 0; t < 8; ++t)
+		{
+			threads.emplace_back([&allocator, &errorCount, t]()
+			{
+				void* blocks[64];
+				for (std::size_t iteration = 0; iteration < 200; ++iteration)
+				{
+					for (std::size_t i = 0; i < 64; ++i)
+					{
+						blocks[i] = allocator.Allocate(64);
+						*static_cast<std::size_t*>(blocks[i]) = t;
+					}
+					for (std::size_t i = 0; i < 64; ++i)
+					{
+						if (*static_cast<std::size_t*>(blocks[i]) != t)
+						{
+							errorCount++;
+						}
+						allocator.Deallocate(blocks[i]);
+					}
+				}
+			});
+		}
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+		DOCTEST_CHECK(errorCount == 0);
+	}
+}
\ No newline at end of file
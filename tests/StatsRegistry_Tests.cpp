@@ -0,0 +1,218 @@
+#include "../src/Dyma.hpp"
+#include "doctest.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+using namespace dyma;
+
+#if !defined(_WIN32)
+
+namespace
+{
+
+// Unique per process, so runs of the tests in parallel don't share their registries
+void GetRegistryName(char* name, std::size_t size, const char* suffix)
+{
+	std::snprintf(name, size, "/dyma-tests-%ld-%s", static_cast<long>(getpid()), suffix);
+}
+
+const StatsRegistry::Snapshot* FindSnapshot(const std::vector<StatsRegistry::Snapshot>& snapshots, const char* name)
+{
+	for (const StatsRegistry::Snapshot& snapshot : snapshots)
+	{
+		if (std::strcmp(snapshot.name, name) == 0)
+		{
+			return &snapshot;
+		}
+	}
+	return nullptr;
+}
+
+} // namespace
+
+DOCTEST_TEST_CASE("StatsRegistry")
+{
+	DOCTEST_SUBCASE("Publish")
+	{
+		char name[64];
+		GetRegistryName(name, sizeof(name), "publish");
+		StatsRegistry::Settings settings;
+		settings.name = name;
+		settings.capacity = 4;
+		settings.publishIntervalMs = 0;
+		StatsRegistry registry(settings);
+		DOCTEST_CHECK(registry.IsOpen());
+		DOCTEST_CHECK(std::strcmp(registry.GetName(), name) == 0);
+
+		StackMemory<256, 16> debugMemory;
+		StackAllocator debugStack(debugMemory);
+		DebugAllocator::Settings debugSettings;
+		debugSettings.blockHeaders = true;
+		debugSettings.peakGranularity = 0;
+		DebugAllocator debug(debugStack, debugSettings);
+		StackMemory<256, 16> stackMemory;
+		StackAllocator stack(stackMemory);
+		const std::size_t debugIndex = registry.Add("debug", debug);
+		const std::size_t stackIndex = registry.Add("stack", stack);
+		DOCTEST_CHECK(debugIndex == 0);
+		DOCTEST_CHECK(stackIndex == 1);
+
+		void* debugPtr = debug.Allocate(32);
+		void* otherPtr = debug.Allocate(16);
+		DOCTEST_CHECK(debug.Allocate(1024) == nullptr);
+		debug.Deallocate(otherPtr);
+		stack.Allocate(64);
+		registry.Publish();
+
+		std::vector<StatsRegistry::Snapshot> snapshots;
+		DOCTEST_CHECK(StatsRegistry::Read(name, snapshots));
+		DOCTEST_CHECK(snapshots.size() == 2);
+		const StatsRegistry::Snapshot* debugSnapshot = FindSnapshot(snapshots, "debug");
+		DOCTEST_REQUIRE(debugSnapshot != nullptr);
+		DOCTEST_CHECK(debugSnapshot->usedSize == 32);
+		DOCTEST_CHECK(debugSnapshot->peakSize == 48);
+		DOCTEST_CHECK(debugSnapshot->allocationCount == 2);
+		DOCTEST_CHECK(debugSnapshot->deallocationCount == 1);
+		DOCTEST_CHECK(debugSnapshot->failureCount == 1);
+		DOCTEST_CHECK(debugSnapshot->timestamp > 0);
+		const StatsRegistry::Snapshot* stackSnapshot = FindSnapshot(snapshots, "stack");
+		DOCTEST_REQUIRE(stackSnapshot != nullptr);
+		DOCTEST_CHECK(stackSnapshot->usedSize == 64);
+		DOCTEST_CHECK(stackSnapshot->allocationCount == 0);
+
+		// The peak of other allocators is the highest size published
+		stack.DeallocateAll();
+		registry.Publish();
+		DOCTEST_CHECK(StatsRegistry::Read(name, snapshots));
+		stackSnapshot = FindSnapshot(snapshots, "stack");
+		DOCTEST_REQUIRE(stackSnapshot != nullptr);
+		DOCTEST_CHECK(stackSnapshot->usedSize == 0);
+		DOCTEST_CHECK(stackSnapshot->peakSize == 64);
+
+		// Removed entries are hidden and not reused
+		registry.Remove(stackIndex);
+		DOCTEST_CHECK(StatsRegistry::Read(name, snapshots));
+		DOCTEST_CHECK(snapshots.size() == 1);
+		DOCTEST_CHECK(registry.Add("stack2", stack) == 2);
+		DOCTEST_CHECK(registry.Add("stack3", stack) == 3);
+		DOCTEST_CHECK(registry.Add("stack4", stack) == StatsRegistry::InvalidIndex);
+
+		debug.Deallocate(debugPtr);
+	}
+
+	DOCTEST_SUBCASE("Removed with the registry")
+	{
+		char name[64];
+		GetRegistryName(name, sizeof(name), "removed");
+		std::vector<StatsRegistry::Snapshot> snapshots;
+		{
+			StatsRegistry::Settings settings;
+			settings.name = name;
+			settings.publishIntervalMs = 0;
+			StatsRegistry registry(settings);
+			DOCTEST_CHECK(StatsRegistry::Read(name, snapshots));
+			DOCTEST_CHECK(snapshots.empty());
+
+			// The name is taken as long as the registry lives
+			StatsRegistry other(settings);
+			DOCTEST_CHECK(!other.IsOpen());
+			Mallocator mallocator;
+			DOCTEST_CHECK(other.Add("malloc", mallocator) == StatsRegistry::InvalidIndex);
+		}
+		DOCTEST_CHECK(!StatsRegistry::Read(name, snapshots));
+	}
+
+	DOCTEST_SUBCASE("Readers see consistent snapshots")
+	{
+		char name[64];
+		GetRegistryName(name, sizeof(name), "consistent");
+		StatsRegistry::Settings settings;
+		settings.name = name;
+		settings.publishIntervalMs = 1;
+		StatsRegistry registry(settings);
+		Mallocator mallocator;
+		DebugAllocator debug(mallocator);
+		registry.Add("debug", debug);
+
+		std::atomic<bool> stop(false);
+		std::thread allocating([&debug, &stop]()
+		{
+			while (!stop.load(std::memory_order_relaxed))
+			{
+				void* ptr = debug.Allocate(64);
+				debug.Deallocate(ptr);
+			}
+		});
+
+		// Allocations are published before their deallocations are read, never the other way around
+		bool consistent = true;
+		std::vector<StatsRegistry::Snapshot> snapshots;
+		for (std::size_t i = 0; i < 200; ++i)
+		{
+			if (StatsRegistry::Read(name, snapshots) && snapshots.size() == 1)
+			{
+				consistent = consistent && snapshots[0].deallocationCount <= snapshots[0].allocationCount;
+				consistent = consistent && snapshots[0].usedSize <= snapshots[0].peakSize;
+			}
+			std::this_thread::yield();
+		}
+		stop.store(true, std::memory_order_relaxed);
+		allocating.join();
+		DOCTEST_CHECK(consistent);
+	}
+
+	DOCTEST_SUBCASE("Background publisher")
+	{
+		char name[64];
+		GetRegistryName(name, sizeof(name), "background");
+		StatsRegistry::Settings settings;
+		settings.name = name;
+		settings.publishIntervalMs = 1;
+		StatsRegistry registry(settings);
+
+		// The publisher thread can't read the usage of allocators that aren't thread-safe
+		StackMemory<256, 16> stackMemory;
+		StackAllocator stack(stackMemory);
+		DOCTEST_CHECK(registry.Add("stack", stack) == StatsRegistry::InvalidIndex);
+		LockedAllocator locked(stack);
+		DOCTEST_CHECK(registry.Add("locked", locked) == 0);
+
+		// Only the counters of a DebugAllocator are read, so it can wrap them
+		StackMemory<256, 16> debugMemory;
+		StackAllocator debugStack(debugMemory);
+		DebugAllocator::Settings debugSettings;
+		debugSettings.blockHeaders = true;
+		debugSettings.peakGranularity = 0;
+		DebugAllocator debug(debugStack, debugSettings);
+		DOCTEST_CHECK(!debug.IsThreadSafe());
+		DOCTEST_CHECK(registry.Add("debug", debug) == 1);
+
+		// Published without calling Publish()
+		std::thread allocating([&locked, &debug]()
+		{
+			locked.Allocate(64);
+			debug.Allocate(32);
+		});
+		allocating.join();
+		bool published = false;
+		std::vector<StatsRegistry::Snapshot> snapshots;
+		for (std::size_t i = 0; i < 5000 && !published; ++i)
+		{
+			published = StatsRegistry::Read(name, snapshots) && snapshots.size() == 2 && snapshots[0].usedSize == 64 && snapshots[1].usedSize == 32;
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		DOCTEST_REQUIRE(published);
+		DOCTEST_CHECK(snapshots[0].peakSize == 64);
+		DOCTEST_CHECK(snapshots[1].allocationCount == 1);
+	}
+}
+
+#endif // _WIN32
\ No newline at end of file
@@ -0,0 +1,227 @@
+#include "../src/Dyma.hpp"
+#include "doctest.h"
+
+#include <cstring>
+#include <thread>
+#include <vector>
+
+using namespace dyma;
+
+namespace
+{
+
+struct BudgetCallbackData
+{
+	std::size_t callCount = 0;
+	MemoryTag tag = MemoryTagTree::InvalidTag;
+	bool allow = false;
+};
+
+bool OnBudgetExceeded(void* userData, MemoryTag tag, std::size_t, std::size_t)
+{
+	BudgetCallbackData* data = static_cast<BudgetCallbackData*>(userData);
+	data->callCount++;
+	data->tag = tag;
+	return data->allow;
+}
+
+// Owns() of a Mallocator is always false
+TaggedAllocator::Settings MallocatorSettings()
+{
+	TaggedAllocator::Settings settings;
+	settings.checkOwnership = false;
+	return settings;
+}
+
+} // namespace
+
+DOCTEST_TEST_CASE("TaggedAllocator")
+{
+	DOCTEST_SUBCASE("Register")
+	{
+		MemoryTagTree tree(8);
+		DOCTEST_CHECK(tree.GetTagCount() == 1);
+		const MemoryTag buffers = tree.Register("net/rx/buffers");
+		DOCTEST_CHECK(buffers != MemoryTagTree::InvalidTag);
+		DOCTEST_CHECK(tree.GetTagCount() == 4);
+		DOCTEST_CHECK(tree.Register("net/rx/buffers") == buffers);
+		DOCTEST_CHECK(tree.Find("net/rx/buffers") == buffers);
+		DOCTEST_CHECK(tree.Find("") == MemoryTagTree::RootTag);
+		DOCTEST_CHECK(tree.Find("net/tx") == MemoryTagTree::InvalidTag);
+
+		const MemoryTag rx = tree.GetParent(buffers);
+		DOCTEST_CHECK(std::strcmp(tree.GetName(rx), "rx") == 0);
+		DOCTEST_CHECK(tree.Find("net/rx") == rx);
+		DOCTEST_CHECK(tree.GetParent(tree.GetParent(rx)) == MemoryTagTree::RootTag);
+		DOCTEST_CHECK(tree.GetParent(MemoryTagTree::RootTag) == MemoryTagTree::InvalidTag);
+
+		// The names are limited, and so is the tree, the tags registered before it got full are kept
+		DOCTEST_CHECK(tree.Register("a_name_longer_than_thirty_one_characters") == MemoryTagTree::InvalidTag);
+		DOCTEST_CHECK(tree.Register("net/tx/buffers/small/large/huge") == MemoryTagTree::InvalidTag);
+		DOCTEST_CHECK(tree.Find("net/tx/buffers/small/large") != MemoryTagTree::InvalidTag);
+		DOCTEST_CHECK(tree.GetTagCount() == 8);
+	}
+
+	DOCTEST_SUBCASE("Charges go up the tree")
+	{
+		Mallocator mallocator;
+		MemoryTagTree tree;
+		const MemoryTag rx = tree.Register("net/rx");
+		const MemoryTag tx = tree.Register("net/tx");
+		const MemoryTag net = tree.Find("net");
+		TaggedAllocator allocator(mallocator, tree, MallocatorSettings());
+
+		void* untagged = allocator.Allocate(8);
+		void* rxPtr = nullptr;
+		{
+			MemoryTagScope scope(rx);
+			rxPtr = allocator.Allocate(64);
+			DOCTEST_CHECK(MemoryTagScope::GetCurrentTag() == rx);
+		}
+		DOCTEST_CHECK(MemoryTagScope::GetCurrentTag() == MemoryTagTree::RootTag);
+		void* txPtr = allocator.Allocate(32, tx);
+		DOCTEST_CHECK(allocator.GetTag(rxPtr) == rx);
+		DOCTEST_CHECK(allocator.GetTag(untagged) == MemoryTagTree::RootTag);
+		DOCTEST_CHECK(tree.GetUsedSize(rx) == 64);
+		DOCTEST_CHECK(tree.GetUsedSize(tx) == 32);
+		DOCTEST_CHECK(tree.GetUsedSize(net) == 96);
+		DOCTEST_CHECK(tree.GetUsedSize(MemoryTagTree::RootTag) == 104);
+
+		allocator.Deallocate(rxPtr);
+		DOCTEST_CHECK(tree.GetUsedSize(rx) == 0);
+		DOCTEST_CHECK(tree.GetPeakSize(rx) == 64);
+		DOCTEST_CHECK(tree.GetUsedSize(net) == 32);
+		allocator.Deallocate(txPtr);
+		allocator.Deallocate(untagged);
+		DOCTEST_CHECK(tree.GetUsedSize(MemoryTagTree::RootTag) == 0);
+	}
+
+	DOCTEST_SUBCASE("Budgets")
+	{
+		Mallocator mallocator;
+		MemoryTagTree tree;
+		const MemoryTag rx = tree.Register("net/rx");
+		const MemoryTag tx = tree.Register("net/tx");
+		const MemoryTag net = tree.Find("net");
+		tree.SetBudget(net, 100);
+		TaggedAllocator allocator(mallocator, tree, MallocatorSettings());
+
+		void* rxPtr = allocator.Allocate(60, rx);
+		DOCTEST_CHECK(rxPtr != nullptr);
+		DOCTEST_CHECK(allocator.Allocate(60, tx) == nullptr);
+		DOCTEST_CHECK(tree.GetUsedSize(tx) == 0);
+		DOCTEST_CHECK(tree.GetUsedSize(net) == 60);
+		void* txPtr = allocator.Allocate(40, tx);
+		DOCTEST_CHECK(txPtr != nullptr);
+
+		// The callback decides whether the budget can be exceeded
+		BudgetCallbackData data;
+		tree.SetBudgetCallback(&OnBudgetExceeded, &data);
+		DOCTEST_CHECK(allocator.Allocate(8, rx) == nullptr);
+		DOCTEST_CHECK(data.callCount == 1);
+		DOCTEST_CHECK(data.tag == net);
+		data.allow = true;
+		void* overPtr = allocator.Allocate(8, rx);
+		DOCTEST_CHECK(overPtr != nullptr);
+		DOCTEST_CHECK(tree.GetUsedSize(net) == 108);
+
+		allocator.Deallocate(overPtr);
+		allocator.Deallocate(txPtr);
+		allocator.Deallocate(rxPtr);
+		DOCTEST_CHECK(tree.GetUsedSize(MemoryTagTree::RootTag) == 0);
+	}
+
+	DOCTEST_SUBCASE("Threads never exceed a budget")
+	{
+		Mallocator mallocator;
+		MemoryTagTree tree;
+		const MemoryTag tag = tree.Register("workers");
+		tree.SetBudget(tag, 64 * 32);
+		TaggedAllocator allocator(mallocator, tree, MallocatorSettings());
+
+		std::vector<std::thread> threads;
+		for (std::size_t i = 0; i < 4; ++i)
+		{
+			threads.emplace_back([&allocator, tag]()
+			{
+				MemoryTagScope scope(tag);
+				for (std::size_t j = 0; j < 1000; ++j)
+				{
+					void* ptrs[32];
+					for (void*& ptr : ptrs)
+					{
+						ptr = allocator.Allocate(64);
+					}
+					for (void*& ptr : ptrs)
+					{
+						if (ptr != nullptr)
+						{
+							allocator.Deallocate(ptr);
+						}
+					}
+				}
+			});
+		}
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+		DOCTEST_CHECK(tree.GetPeakSize(tag) <= 64 * 32);
+		DOCTEST_CHECK(tree.GetUsedSize(tag) == 0);
+		DOCTEST_CHECK(tree.GetUsedSize(MemoryTagTree::RootTag) == 0);
+	}
+	DOCTEST_SUBCASE("Foreign blocks are rejected")
+	{
+		HeapMemory memory(1024);
+		StackAllocator stack(memory);
+		MemoryTagTree tree;
+		const MemoryTag tag = tree.Register("stack");
+		TaggedAllocator allocator(stack, tree);
+
+		void* ptr = allocator.Allocate(64, tag);
+		DOCTEST_CHECK(ptr != nullptr);
+		DOCTEST_CHECK(allocator.Owns(ptr));
+
+		Mallocator mallocator;
+		void* foreignPtr = mallocator.Allocate(64);
+		void* rejectedPtr = foreignPtr;
+		DOCTEST_CHECK(!allocator.Owns(foreignPtr));
+		DOCTEST_CHECK(!allocator.Deallocate(rejectedPtr));
+		DOCTEST_CHECK(rejectedPtr == foreignPtr);
+		DOCTEST_CHECK(tree.GetUsedSize(tag) == 64);
+		mallocator.Deallocate(foreignPtr);
+
+		DOCTEST_CHECK(allocator.Deallocate(ptr));
+		DOCTEST_CHECK(ptr == nullptr);
+		DOCTEST_CHECK(tree.GetUsedSize(tag) == 0);
+	}
+
+	DOCTEST_SUBCASE("Pools have room for the headers")
+	{
+		MemoryTagTree tree;
+		const MemoryTag tag = tree.Register("pool");
+		Mallocator mallocator;
+		TaggedAllocator probe(mallocator, tree, MallocatorSettings());
+		const std::size_t headerSize = probe.GetHeaderSize();
+
+		HeapMemory memory(16 * (64 + headerSize));
+		PoolAllocator pool(memory, 64 + headerSize);
+		TaggedAllocator allocator(pool, tree);
+
+		void* ptrs[16];
+		for (void*& ptr : ptrs)
+		{
+			ptr = allocator.Allocate(64, tag);
+			DOCTEST_CHECK(ptr != nullptr);
+			std::memset(ptr, 0xAB, 64);
+		}
+		DOCTEST_CHECK(allocator.Allocate(64, tag) == nullptr);
+		DOCTEST_CHECK(tree.GetUsedSize(tag) == 16 * 64);
+		for (void*& ptr : ptrs)
+		{
+			DOCTEST_CHECK(allocator.GetTag(ptr) == tag);
+			DOCTEST_CHECK(allocator.Deallocate(ptr));
+		}
+		DOCTEST_CHECK(tree.GetUsedSize(tag) == 0);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,69 @@
+#include "../src/Dyma.hpp"
+#include "doctest.h"
+
+#include <thread>
+#include <vector>
+
+using namespace dyma;
+
+DOCTEST_TEST_CASE("TaskArenaAllocator")
+{
+	DOCTEST_SUBCASE("Allocate")
+	{
+		StackMemory<256, 16> memory;
+		TaskArenaAllocator allocator(memory, 2);
+		DOCTEST_CHECK(allocator.GetArenaSize() == 128);
+
+		// Threads that aren't workers can't allocate
+		TaskArenaAllocator::SetCurrentWorker(TaskArenaAllocator::NoWorker);
+		DOCTEST_CHECK(allocator.Allocate(16) == nullptr);
+
+		TaskArenaAllocator::SetCurrentWorker(1);
+		void* ptr = allocator.Allocate(8);
+		DOCTEST_CHECK(reinterpret_cast<std::uintptr_t>(ptr) == reinterpret_cast<std::uintptr_t>(memory.GetPointer()) + 128);
+		DOCTEST_CHECK(allocator.Allocate(112) != nullptr);
+		DOCTEST_CHECK(allocator.Allocate(16) == nullptr);
+		DOCTEST_CHECK(allocator.GetUsedSize(0) == 0);
+		DOCTEST_CHECK(allocator.GetUsedSize(1) == 128);
+
+		DOCTEST_CHECK(allocator.Deallocate(ptr));
+		DOCTEST_CHECK(ptr == nullptr);
+		DOCTEST_CHECK(allocator.GetUsedSize() == 128);
+
+		allocator.DeallocateAll();
+		DOCTEST_CHECK(allocator.GetUsedSize() == 0);
+		TaskArenaAllocator::SetCurrentWorker(TaskArenaAllocator::NoWorker);
+	}
+
+	DOCTEST_SUBCASE("Workers")
+	{
+		HeapMemory memory(4 * 1024);
+		TaskArenaAllocator allocator(memory, 4);
+
+		std::vector<std::thread> workers;
+		for (std::size_t w = 0; w < 4; ++w)
+		{
+			workers.emplace_back([&allocator, w]()
+			{
+				TaskArenaAllocator::SetCurrentWorker(w);
+				for (std::size_t i = 0; i <= w; ++i)
+				{
+					allocator.Allocate(64);
+				}
+			});
+		}
+		for (std::thread& worker : workers)
+		{
+			worker.join();
+		}
+
+		for (std::size_t w = 0; w < 4; ++w)
+		{
+			DOCTEST_CHECK(allocator.GetUsedSize(w) == (w + 1) * 64);
+		}
+
+		// The task graph completed
+		allocator.DeallocateAll();
+		DOCTEST_CHECK(allocator.GetUsedSize() == 0);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,162 @@
+#include "../src/Dyma.hpp"
+#include "doctest.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace dyma;
+
+DOCTEST_TEST_CASE("ThreadCachingAllocator")
+{
+	DOCTEST_SUBCASE("Allocate")
+	{
+		Mallocator mallocator;
+		ThreadCachingAllocator allocator(mallocator);
+		DOCTEST_CHECK(allocator.GetSizeClassCount() == 5);
+		DOCTEST_CHECK(allocator.GetSizeClass(0) == 16);
+		DOCTEST_CHECK(allocator.GetSizeClass(4) == 256);
+		DOCTEST_CHECK(allocator.Allocate(0) == nullptr);
+
+		void* small = allocator.Allocate(24);
+		void* large = allocator.Allocate(1000);
+		DOCTEST_CHECK(small != nullptr);
+		DOCTEST_CHECK(large != nullptr);
+		DOCTEST_CHECK(allocator.Deallocate(small));
+		DOCTEST_CHECK(small == nullptr);
+		DOCTEST_CHECK(allocator.Deallocate(large));
+		DOCTEST_CHECK(large == nullptr);
+
+		void* iPtr = nullptr;
+		DOCTEST_CHECK(!allocator.Deallocate(iPtr));
+	}
+
+	DOCTEST_SUBCASE("Batches")
+	{
+		HeapMemory memory(64 * 1024);
+		StackAllocator stack(memory);
+		GrowablePoolAllocator upstream(stack, 32, 512);
+
+		ThreadCachingAllocator::Settings settings;
+		settings.maxCachedSize = 16;
+		settings.batchSize = 8;
+		settings.maxCachedBlocks = 16;
+		ThreadCachingAllocator allocator(upstream, settings);
+		DOCTEST_CHECK(allocator.GetSizeClassCount() == 1);
+
+		// The cache keeps the blocks of the batch and reuses the last freed block
+		void* first = allocator.Allocate(16);
+		DOCTEST_CHECK(allocator.Owns(first));
+		void* firstCopy = first;
+		DOCTEST_CHECK(allocator.Deallocate(first));
+		DOCTEST_CHECK(allocator.Allocate(16) == firstCopy);
+
+		void* blocks[40];
+		for (std::size_t i = 0; i < 40; ++i)
+		{
+			blocks[i] = allocator.Allocate(16);
+			DOCTEST_CHECK(blocks[i] != nullptr);
+		}
+		for (std::size_t i = 0; i < 40; ++i)
+		{
+			DOCTEST_CHECK(allocator.Deallocate(blocks[i]));
+		}
+		allocator.Deallocate(firstCopy);
+		allocator.Flush();
+		DOCTEST_CHECK(upstream.GetChunkCount() == 0);
+	}
+
+	DOCTEST_SUBCASE("Pools of the size classes")
+	{
+		// Each pool has blocks of its class plus the header
+		ThreadCachingAllocator::Settings settings;
+		settings.maxCachedSize = 32;
+		settings.batchSize = 4;
+		settings.maxCachedBlocks = 4;
+		HeapMemory smallMemory(16 * 32);
+		HeapMemory largeMemory(16 * 48);
+		PoolAllocator smallPool(smallMemory, 16 + 16);
+		PoolAllocator largePool(largeMemory, 32 + 16);
+		SegregatorAllocator upstream(32, smallPool, largePool);
+		ThreadCachingAllocator allocator(upstream, settings);
+		DOCTEST_CHECK(allocator.GetSizeClassCount() == 2);
+		DOCTEST_CHECK(allocator.GetHeaderSize() == 16);
+
+		void* small = allocator.Allocate(8);
+		void* large = allocator.Allocate(32);
+		DOCTEST_CHECK(smallPool.Owns(reinterpret_cast<void*>(reinterpret_cast<std::uintptr_t>(small) - allocator.GetHeaderSize())));
+		DOCTEST_CHECK(largePool.Owns(reinterpret_cast<void*>(reinterpret_cast<std::uintptr_t>(large) - allocator.GetHeaderSize())));
+		DOCTEST_CHECK(allocator.Deallocate(small));
+		DOCTEST_CHECK(allocator.Deallocate(large));
+		allocator.Flush();
+	}
+
+	DOCTEST_SUBCASE("Foreign blocks")
+	{
+		// Rejected by the source of the upstream allocator
+		HeapMemory memory(16 * 32);
+		PoolAllocator pool(memory, 16 + 16);
+		ThreadCachingAllocator::Settings settings;
+		settings.maxCachedSize = 16;
+		ThreadCachingAllocator allocator(pool, settings);
+		Mallocator mallocator;
+		void* foreign = mallocator.Allocate(64);
+		void* foreignCopy = foreign;
+		DOCTEST_CHECK(!allocator.Deallocate(foreign));
+		DOCTEST_CHECK(foreign == foreignCopy);
+		mallocator.Deallocate(foreign);
+
+		// Without a source, by the size class of their header
+		ThreadCachingAllocator mallocAllocator(mallocator);
+		std::size_t words[4] = { 1000, 1000, 1000, 1000 };
+		void* fake = &words[2];
+		DOCTEST_CHECK(mallocAllocator.GetHeaderSize() == 2 * sizeof(std::size_t));
+		DOCTEST_CHECK(!mallocAllocator.Deallocate(fake));
+		DOCTEST_CHECK(fake == &words[2]);
+	}
+
+	DOCTEST_SUBCASE("Threads")
+	{
+		Mallocator mallocator;
+		GrowablePoolAllocator upstream(mallocator, 80, 256);
+		std::atomic<std::size_t> errorCount(0);
+		{
+			ThreadCachingAllocator allocator(upstream);
+			std::vector<std::thread> threads;
+			for (std::size_t t = 0; t < 4; ++t)
+			{
+				threads.emplace_back([&allocator, &errorCount, t]()
+				{
+					void* blocks[64];
+					for (std::size_t iteration = 0; iteration < 500; ++iteration)
+					{
+						for (std::size_t i = 0; i < 64; ++i)
+						{
+							blocks[i] = allocator.Allocate(48);
+							*static_cast<std::size_t*>(blocks[i]) = t;
+						}
+						for (std::size_t i = 0; i < 64; ++i)
+						{
+							if (*static_cast<std::size_t*>(blocks[i]) != t)
+							{
+								errorCount++;
+							}
+							allocator.Deallocate(blocks[i]);
+						}
+					}
+				});
+			}
+			for (std::thread& thread : threads)
+			{
+				thread.join();
+			}
+
+			// The caches are drained when their threads exit
+			DOCTEST_CHECK(upstream.GetChunkCount() == 0);
+
+			// The cache of this thread is drained when the allocator is destroyed
+			DOCTEST_CHECK(allocator.Allocate(48) != nullptr);
+		}
+		DOCTEST_CHECK(errorCount == 0);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,137 @@
+#include "../src/Dyma.hpp"
+#include "doctest.h"
+
+#include <cstdio>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace dyma;
+
+DOCTEST_TEST_CASE("TraceRecorderAllocator")
+{
+	DOCTEST_SUBCASE("Record and read")
+	{
+		std::FILE* file = std::tmpfile();
+		DOCTEST_REQUIRE(file != nullptr);
+		Mallocator mallocator;
+		void* a = nullptr;
+		void* b = nullptr;
+		{
+			TraceRecorderAllocator recorder(mallocator, file);
+			a = recorder.Allocate(24);
+			b = recorder.Allocate(1000);
+			DOCTEST_CHECK(recorder.Deallocate(a));
+			DOCTEST_CHECK(recorder.Allocate(0) == nullptr);
+			DOCTEST_CHECK(recorder.GetEventCount() == 3);
+			recorder.Flush();
+			DOCTEST_CHECK(!recorder.HasFailed());
+		}
+
+		std::rewind(file);
+		std::vector<TraceRecorderAllocator::Event> events;
+		DOCTEST_CHECK(TraceRecorderAllocator::ReadTrace(file, events));
+		DOCTEST_REQUIRE(events.size() == 3);
+		DOCTEST_CHECK(events[0].type == TraceRecorderAllocator::Event::Type::Allocate);
+		DOCTEST_CHECK(events[0].size == 24);
+		DOCTEST_CHECK(events[1].address == reinterpret_cast<std::uintptr_t>(b));
+		DOCTEST_CHECK(events[1].size == 1000);
+		DOCTEST_CHECK(events[2].type == TraceRecorderAllocator::Event::Type::Deallocate);
+		DOCTEST_CHECK(events[2].address == events[0].address);
+		DOCTEST_CHECK(events[0].time <= events[2].time);
+		mallocator.Deallocate(b);
+		std::fclose(file);
+	}
+
+	DOCTEST_SUBCASE("Failed deallocations")
+	{
+		// They leave a gap in the sequence, but aren't events
+		std::FILE* file = std::tmpfile();
+		DOCTEST_REQUIRE(file != nullptr);
+		StackMemory<256, 16> memory;
+		PoolAllocator pool(memory, 16);
+		{
+			TraceRecorderAllocator recorder(pool, file);
+			void* ptr = recorder.Allocate(16);
+			int local = 0;
+			void* foreign = &local;
+			DOCTEST_CHECK(!recorder.Deallocate(foreign));
+			DOCTEST_CHECK(recorder.GetEventCount() == 1);
+			DOCTEST_CHECK(recorder.Deallocate(ptr));
+			DOCTEST_CHECK(recorder.GetEventCount() == 2);
+			recorder.Flush();
+		}
+
+		std::rewind(file);
+		std::vector<TraceRecorderAllocator::Event> events;
+		DOCTEST_CHECK(TraceRecorderAllocator::ReadTrace(file, events));
+		DOCTEST_REQUIRE(events.size() == 2);
+		DOCTEST_CHECK(events[0].sequence < events[1].sequence);
+		DOCTEST_CHECK(events[1].type == TraceRecorderAllocator::Event::Type::Deallocate);
+		std::fclose(file);
+	}
+
+	DOCTEST_SUBCASE("Invalid trace")
+	{
+		std::FILE* file = std::tmpfile();
+		DOCTEST_REQUIRE(file != nullptr);
+		std::fputs("NOTATRACE", file);
+		std::rewind(file);
+		std::vector<TraceRecorderAllocator::Event> events;
+		DOCTEST_CHECK(!TraceRecorderAllocator::ReadTrace(file, events));
+		std::fclose(file);
+	}
+
+	DOCTEST_SUBCASE("Threads")
+	{
+		// Addresses are reused between threads, the sequence should still give a valid order
+		std::FILE* file = std::tmpfile();
+		DOCTEST_REQUIRE(file != nullptr);
+		HeapMemory memory(64 * 256);
+		ConcurrentPoolAllocator pool(memory, 64);
+		{
+			TraceRecorderAllocator recorder(pool, file);
+			std::vector<std::thread> threads;
+			for (std::size_t t = 0; t < 8; ++t)
+			{
+				threads.emplace_back([&recorder]()
+				{
+					void* blocks[16];
+					for (std::size_t iteration = 0; iteration < 200; ++iteration)
+					{
+						for (std::size_t i = 0; i < 16; ++i)
+						{
+							blocks[i] = recorder.Allocate(64);
+						}
+						for (std::size_t i = 0; i < 16; ++i)
+						{
+							recorder.Deallocate(blocks[i]);
+						}
+					}
+				});
+			}
+			for (std::thread& thread : threads)
+			{
+				thread.join();
+			}
+		}
+
+		std::rewind(file);
+		std::vector<TraceRecorderAllocator::Event> events;
+		DOCTEST_CHECK(TraceRecorderAllocator::ReadTrace(file, events));
+		DOCTEST_CHECK(events.size() == 8 * 200 * 16 * 2);
+		std::unordered_map<std::uint64_t, bool> live;
+		std::size_t errorCount = 0;
+		for (const TraceRecorderAllocator::Event& event : events)
+		{
+			const bool allocation = event.type == TraceRecorderAllocator::Event::Type::Allocate;
+			if (live[event.address] == allocation)
+			{
+				errorCount++;
+			}
+			live[event.address] = allocation;
+		}
+		DOCTEST_CHECK(errorCount == 0);
+		std::fclose(file);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,294 @@
+#include "../src/Dyma.hpp"
+
+#include <chrono> // std::chrono::steady_clock
+#include <cstdio> // std::printf
+#include <cstdlib> // std::strtoull
+#include <cstring> // std::memset
+#include <vector> // std::vector
+
+#if defined(__linux__)
+#include <linux/perf_event.h> // perf_event_attr
+#include <sys/ioctl.h> // ioctl
+#include <sys/syscall.h> // SYS_perf_event_open
+#include <unistd.h> // syscall, read, close
+#endif
+
+// DymaBench : Runs workloads against allocators, measuring wall time and the hardware counters of the thread
+// The counters come from perf_event_open on Linux, only the wall time is measured when they aren't permitted (see /proc/sys/kernel/perf_event_paranoid)
+// Usage : DymaBench [block count] [rounds]
+
+using namespace dyma;
+
+namespace
+{
+
+// PerfCounters : Cycles, instructions, cache misses and dTLB misses of the user space of the current thread
+// Each event is opened on its own, so the ones the CPU doesn't support are the only ones missing
+class PerfCounters
+{
+public:
+	enum Counter
+	{
+		Cycles,
+		Instructions,
+		CacheMisses,
+		DtlbMisses,
+		CounterCount
+	};
+
+	PerfCounters()
+	{
+#if defined(__linux__)
+		const std::uint32_t types[CounterCount] = { PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE };
+		const std::uint64_t configs[CounterCount] = {
+			PERF_COUNT_HW_CPU_CYCLES,
+			PERF_COUNT_HW_INSTRUCTIONS,
+			PERF_COUNT_HW_CACHE_MISSES,
+			PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)
+		};
+		for (std::size_t i = 0; i < CounterCount; ++i)
+		{
+			perf_event_attr attr;
+			std::memset(&attr, 0, sizeof(attr));
+			attr.size = sizeof(attr);
+			attr.type = types[i];
+			attr.config = configs[i];
+			attr.disabled = 1;
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+			// Counters are multiplexed when there are more events than hardware counters, the times let us scale them
+			attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+			mFds[i] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+		}
+#else
+		for (std::size_t i = 0; i < CounterCount; ++i)
+		{
+			mFds[i] = -1;
+		}
+#endif
+	}
+
+	~PerfCounters()
+	{
+#if defined(__linux__)
+		for (std::size_t i = 0; i < CounterCount; ++i)
+		{
+			if (mFds[i] >= 0)
+			{
+				close(mFds[i]);
+			}
+		}
+#endif
+	}
+
+	// NonCopyable
+	PerfCounters(const PerfCounters& other) = delete;
+	PerfCounters& operator=(const PerfCounters& other) = delete;
+
+	bool IsAvailable(Counter counter) const { return mFds[counter] >= 0; }
+
+	bool IsAnyAvailable() const
+	{
+		for (std::size_t i = 0; i < CounterCount; ++i)
+		{
+			if (mFds[i] >= 0)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void Start()
+	{
+#if defined(__linux__)
+		for (std::size_t i = 0; i < CounterCount; ++i)
+		{
+			if (mFds[i] >= 0)
+			{
+				ioctl(mFds[i], PERF_EVENT_IOC_RESET, 0);
+				ioctl(mFds[i], PERF_EVENT_IOC_ENABLE, 0);
+			}
+		}
+#endif
+	}
+
+	void Stop()
+	{
+#if defined(__linux__)
+		for (std::size_t i = 0; i < CounterCount; ++i)
+		{
+			if (mFds[i] >= 0)
+			{
+				ioctl(mFds[i], PERF_EVENT_IOC_DISABLE, 0);
+			}
+		}
+#endif
+	}
+
+	// 0 when the counter isn't available
+	double Read(Counter counter) const
+	{
+#if defined(__linux__)
+		std::uint64_t values[3]; // value, time enabled, time running
+		if (mFds[counter] >= 0 && read(mFds[counter], values, sizeof(values)) == sizeof(values) && values[2] > 0)
+		{
+			return static_cast<double>(values[0]) * static_cast<double>(values[1]) / static_cast<double>(values[2]);
+		}
+#endif
+		return 0.0;
+	}
+
+private:
+	int mFds[CounterCount];
+};
+
+constexpr std::size_t BlockSize = 64;
+
+struct Node
+{
+	Node* next;
+	std::uint64_t value;
+};
+
+std::uint64_t gSink = 0; // Keeps the compiler from removing the reads of the workloads
+
+// Workloads allocate the blocks then deallocate them in reverse order, so the StackAllocator can run them too
+
+// Only the allocator
+void RunAllocateFree(Allocator& allocator, std::vector<void*>& blocks)
+{
+	for (void*& block : blocks)
+	{
+		block = allocator.Allocate(BlockSize);
+	}
+	for (std::size_t i = blocks.size(); i > 0; --i)
+	{
+		allocator.Deallocate(blocks[i - 1]);
+	}
+}
+
+// Writes then reads every block in allocation order, where the layout of the blocks shows in the cache and TLB misses
+void RunTouch(Allocator& allocator, std::vector<void*>& blocks)
+{
+	for (void*& block : blocks)
+	{
+		block = allocator.Allocate(BlockSize);
+		std::memset(block, 1, BlockSize);
+	}
+	std::uint64_t sum = 0;
+	for (void* block : blocks)
+	{
+		sum += *static_cast<const std::uint64_t*>(block);
+	}
+	gSink += sum;
+	for (std::size_t i = blocks.size(); i > 0; --i)
+	{
+		allocator.Deallocate(blocks[i - 1]);
+	}
+}
+
+// Links the blocks into a list and walks it, every step depending on the previous miss
+void RunLinkedList(Allocator& allocator, std::vector<void*>& blocks)
+{
+	Node* head = nullptr;
+	for (void*& block : blocks)
+	{
+		block = allocator.Allocate(BlockSize);
+		Node* node = static_cast<Node*>(block);
+		node->next = head;
+		node->value = 1;
+		head = node;
+	}
+	std::uint64_t sum = 0;
+	for (const Node* node = head; node != nullptr; node = node->next)
+	{
+		sum += node->value;
+	}
+	gSink += sum;
+	for (std::size_t i = blocks.size(); i > 0; --i)
+	{
+		allocator.Deallocate(blocks[i - 1]);
+	}
+}
+
+struct Workload
+{
+	const char* name;
+	void (*run)(Allocator& allocator, std::vector<void*>& blocks);
+};
+
+void Benchmark(const char* allocatorName, Allocator& allocator, const Workload& workload, std::size_t blockCount, std::size_t rounds, PerfCounters& counters)
+{
+	std::vector<void*> blocks(blockCount, nullptr);
+
+	// A first round warms up the allocator and the pages of its memory
+	workload.run(allocator, blocks);
+
+	counters.Start();
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (std::size_t i = 0; i < rounds; ++i)
+	{
+		workload.run(allocator, blocks);
+	}
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	counters.Stop();
+
+	// Every counter is given per block
+	const double blockTotal = static_cast<double>(blockCount * rounds);
+	std::printf("%-12s %-12s %10.2f", allocatorName, workload.name, seconds * 1e9 / blockTotal);
+	for (std::size_t i = 0; i < PerfCounters::CounterCount; ++i)
+	{
+		const PerfCounters::Counter counter = static_cast<PerfCounters::Counter>(i);
+		if (counters.IsAvailable(counter))
+		{
+			std::printf(" %12.3f", counters.Read(counter) / blockTotal);
+		}
+		else
+		{
+			std::printf(" %12s", "n/a");
+		}
+	}
+	std::printf("\n");
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	const std::size_t blockCount = (argc > 1) ? static_cast<std::size_t>(std::strtoull(argv[1], nullptr, 10)) : 64 * 1024;
+	const std::size_t rounds = (argc > 2) ? static_cast<std::size_t>(std::strtoull(argv[2], nullptr, 10)) : 20;
+	if (blockCount == 0 || rounds == 0)
+	{
+		std::printf("Usage : %s [block count] [rounds]\n", argv[0]);
+		return 1;
+	}
+
+	PerfCounters counters;
+	if (!counters.IsAnyAvailable())
+	{
+		std::printf("Hardware counters aren't available, only the wall time is measured\n");
+	}
+
+	const Workload workloads[] = {
+		{ "alloc-free", &RunAllocateFree },
+		{ "touch", &RunTouch },
+		{ "linked-list", &RunLinkedList }
+	};
+
+	Mallocator mallocator;
+	HeapMemory poolMemory(blockCount * BlockSize, BlockSize);
+	PoolAllocator pool(poolMemory, BlockSize);
+	HeapMemory stackMemory(blockCount * BlockSize, BlockSize);
+	StackAllocator stack(stackMemory);
+
+	std::printf("%zu blocks of %zu bytes, %zu rounds, counters per block\n", blockCount, BlockSize, rounds);
+	std::printf("%-12s %-12s %10s %12s %12s %12s %12s\n", "Allocator", "Workload", "ns", "cycles", "instructions", "cache-misses", "dtlb-misses");
+	for (const Workload& workload : workloads)
+	{
+		Benchmark("malloc", mallocator, workload, blockCount, rounds, counters);
+		Benchmark("pool", pool, workload, blockCount, rounds, counters);
+		Benchmark("stack", stack, workload, blockCount, rounds, counters);
+	}
+	return (gSink != 0) ? 0 : 1;
+}
@@ -0,0 +1,506 @@
+#include "../src/Dyma.hpp"
+
+#include <atomic> // std::atomic
+#include <cctype> // std::isalpha
+#include <chrono> // std::chrono::steady_clock
+#include <cstdio> // std::printf
+#include <cstdlib> // std::strtoull
+#include <cstring> // std::strncmp
+#include <memory> // std::shared_ptr, std::unique_ptr
+#include <thread> // std::thread
+#include <utility> // std::forward
+#include <vector> // std::vector
+
+// DymaReplay : Replays a trace of TraceRecorderAllocator against an allocator graph described on the command line
+// Each thread of the trace is replayed by its own thread, a deallocation waits for the allocation of its block when it comes from another thread
+// Graphs that aren't thread-safe are replayed by a single thread, in the order of the sequence
+// The footprint is measured by a second replay, single-threaded, with GetMemoryUsage() of the graph
+// Usage : DymaReplay <trace> [graph]
+
+using namespace dyma;
+
+namespace
+{
+
+const char* const GraphUsage =
+	"Graphs are built from :\n"
+	"  malloc\n"
+	"  stack(<MiB>)\n"
+	"  ring(<MiB>)\n"
+	"  pool(<block size>,<MiB>)\n"
+	"  concurrentpool(<block size>,<MiB>)\n"
+	"  growablepool(<block size>,<blocks per chunk>,<upstream>)\n"
+	"  segregator(<threshold>,<smaller>,<larger>) and concurrentsegregator\n"
+	"  fallback(<primary>,<secondary>) and concurrentfallback\n"
+	"  locked(<allocator>)\n"
+	"  threadcaching(<upstream>) and cpucaching\n"
+	"e.g. threadcaching(segregator(144,growablepool(144,256,malloc),malloc))\n";
+
+// Mallocator whose used size is known, so malloc shows in the footprint of the measured replay
+class MeasuredMallocator : public Allocator
+{
+public:
+	MeasuredMallocator()
+		: mMallocator()
+		, mDebug(mMallocator, GetSettings())
+	{
+	}
+
+	void* Allocate(std::size_t size) override { return mDebug.Allocate(size); }
+	bool Deallocate(void*& ptr) override { return mDebug.Deallocate(ptr); }
+	bool Owns(const void* ptr) const override { return mDebug.Owns(ptr); }
+	bool IsThreadSafe() const override { return true; }
+
+	MemoryUsage GetMemoryUsage() const override
+	{
+		MemoryUsage usage;
+		usage.usedSize = mDebug.GetUsedSize();
+		return usage;
+	}
+
+private:
+	static DebugAllocator::Settings GetSettings()
+	{
+		DebugAllocator::Settings settings;
+		settings.trackBlocks = true;
+		settings.peakGranularity = 0;
+		return settings;
+	}
+
+	Mallocator mMallocator;
+	DebugAllocator mDebug;
+};
+
+// Owns the allocators of a graph and their memory, built from a description like "segregator(64,pool(64,16),malloc)"
+class Graph
+{
+public:
+	Graph(bool measured)
+		: mCursor(nullptr)
+		, mMeasured(measured)
+		, mRoot(nullptr)
+	{
+		mError[0] = '\0';
+	}
+
+	~Graph()
+	{
+		// Allocators are destroyed before the allocators and the memory they use
+		while (!mObjects.empty())
+		{
+			mObjects.pop_back();
+		}
+	}
+
+	// NonCopyable
+	Graph(const Graph& other) = delete;
+	Graph& operator=(const Graph& other) = delete;
+
+	bool Build(const char* description)
+	{
+		mCursor = description;
+		mRoot = ParseAllocator();
+		if (mRoot != nullptr && *mCursor != '\0')
+		{
+			SetError("Unexpected characters");
+			mRoot = nullptr;
+		}
+		return mRoot != nullptr;
+	}
+
+	Allocator& GetRoot() const { return *mRoot; }
+	const char* GetError() const { return mError; }
+
+private:
+	template <typename T, typename... Args>
+	T* Add(Args&&... args)
+	{
+		// Allocators and memory sources don't have a virtual destructor, shared_ptr keeps the one of their type
+		std::shared_ptr<T> object = std::make_shared<T>(std::forward<Args>(args)...);
+		mObjects.push_back(object);
+		return object.get();
+	}
+
+	MemorySource& AddMemory(std::size_t size)
+	{
+		return *Add<VirtualMemory>(size);
+	}
+
+	void SetError(const char* message)
+	{
+		std::snprintf(mError, sizeof(mError), "%s at \"%s\"", message, mCursor);
+	}
+
+	bool Expect(char c)
+	{
+		if (*mCursor != c)
+		{
+			char message[32];
+			std::snprintf(message, sizeof(message), "Expected '%c'", c);
+			SetError(message);
+			return false;
+		}
+		mCursor++;
+		return true;
+	}
+
+	bool ParseNumber(std::size_t& value)
+	{
+		char* end = nullptr;
+		value = static_cast<std::size_t>(std::strtoull(mCursor, &end, 10));
+		if (end == mCursor || value == 0)
+		{
+			SetError("Expected a positive number");
+			return false;
+		}
+		mCursor = end;
+		return true;
+	}
+
+	// "<number>," or "<number>)"
+	bool ParseArgument(std::size_t& value, char separator)
+	{
+		return ParseNumber(value) && Expect(separator);
+	}
+
+	Allocator* ParseChild(char separator)
+	{
+		Allocator* child = ParseAllocator();
+		return (child != nullptr && Expect(separator)) ? child : nullptr;
+	}
+
+	Allocator* ParseAllocator()
+	{
+		const char* name = mCursor;
+		while (std::isalpha(static_cast<unsigned char>(*mCursor)))
+		{
+			mCursor++;
+		}
+		const std::size_t nameSize = static_cast<std::size_t>(mCursor - name);
+		const auto is = [name, nameSize](const char* candidate)
+		{
+			return std::strlen(candidate) == nameSize && std::strncmp(name, candidate, nameSize) == 0;
+		};
+
+		if (is("malloc"))
+		{
+			return mMeasured ? static_cast<Allocator*>(Add<MeasuredMallocator>()) : static_cast<Allocator*>(Add<Mallocator>());
+		}
+		if (!Expect('('))
+		{
+			return nullptr;
+		}
+		std::size_t size = 0;
+		std::size_t count = 0;
+		Allocator* first = nullptr;
+		Allocator* second = nullptr;
+		if (is("stack") && ParseArgument(size, ')'))
+		{
+			return Add<StackAllocator>(AddMemory(size * 1024 * 1024));
+		}
+		if (is("ring") && ParseArgument(size, ')'))
+		{
+			return Add<RingAllocator>(AddMemory(size * 1024 * 1024));
+		}
+		if ((is("pool") || is("concurrentpool")) && ParseArgument(size, ',') && ParseArgument(count, ')'))
+		{
+			MemorySource& memory = AddMemory(count * 1024 * 1024 / size * size);
+			return is("pool") ? static_cast<Allocator*>(Add<PoolAllocator>(memory, size)) : static_cast<Allocator*>(Add<ConcurrentPoolAllocator>(memory, size));
+		}
+		if (is("growablepool") && ParseArgument(size, ',') && ParseArgument(count, ',') && (first = ParseChild(')')) != nullptr)
+		{
+			return Add<GrowablePoolAllocator>(*first, size, count);
+		}
+		if (is("segregator") && ParseArgument(size, ',') && (first = ParseChild(',')) != nullptr && (second = ParseChild(')')) != nullptr)
+		{
+			return Add<SegregatorAllocator>(size, *first, *second);
+		}
+		if (is("concurrentsegregator") && ParseArgument(size, ',') && (first = ParseChild(',')) != nullptr && (second = ParseChild(')')) != nullptr)
+		{
+			return Add<ConcurrentSegregatorAllocator>(size, *first, *second);
+		}
+		if (is("fallback") && (first = ParseChild(',')) != nullptr && (second = ParseChild(')')) != nullptr)
+		{
+			return Add<FallbackAllocator>(*first, *second);
+		}
+		if (is("concurrentfallback") && (first = ParseChild(',')) != nullptr && (second = ParseChild(')')) != nullptr)
+		{
+			return Add<ConcurrentFallbackAllocator>(*first, *second);
+		}
+		if (is("locked") && (first = ParseChild(')')) != nullptr)
+		{
+			return Add<LockedAllocator>(*first);
+		}
+		if (is("threadcaching") && (first = ParseChild(')')) != nullptr)
+		{
+			return Add<ThreadCachingAllocator>(*first);
+		}
+		if (is("cpucaching") && (first = ParseChild(')')) != nullptr)
+		{
+			return Add<CpuCachingAllocator>(*first);
+		}
+		if (mError[0] == '\0')
+		{
+			mCursor = name;
+			SetError("Unknown allocator");
+		}
+		return nullptr;
+	}
+
+	std::vector<std::shared_ptr<void>> mObjects; // In the order they were created
+	const char* mCursor;
+	bool mMeasured;
+	Allocator* mRoot;
+	char mError[256];
+};
+
+// Events refer to their block by a slot, resolved from the addresses before the replay
+struct ReplayEvent
+{
+	std::size_t slot;
+	std::size_t size;
+	bool allocate;
+};
+
+struct ReplayTrace
+{
+	std::vector<ReplayEvent> events; // In sequence order
+	std::vector<std::vector<ReplayEvent>> threadEvents;
+	std::size_t slotCount = 0;
+};
+
+// Slots hold nullptr until their block is allocated
+char gFailedBlock;
+char gFreedBlock;
+
+ReplayTrace PrepareTrace(const std::vector<TraceRecorderAllocator::Event>& events)
+{
+	ReplayTrace trace;
+	Mallocator mallocator;
+	PointerMap<ReplayEvent> liveBlocks(mallocator);
+	std::vector<std::uint32_t> threads;
+	for (const TraceRecorderAllocator::Event& event : events)
+	{
+		const void* address = reinterpret_cast<const void*>(static_cast<std::uintptr_t>(event.address));
+		ReplayEvent replayEvent;
+		if (event.type == TraceRecorderAllocator::Event::Type::Allocate)
+		{
+			replayEvent = { trace.slotCount++, static_cast<std::size_t>(event.size), true };
+			liveBlocks.Insert(address, replayEvent);
+		}
+		else if (!liveBlocks.Remove(address, &replayEvent))
+		{
+			// Allocated before the recording started
+			continue;
+		}
+		replayEvent.allocate = (event.type == TraceRecorderAllocator::Event::Type::Allocate);
+
+		std::size_t threadIndex = 0;
+		while (threadIndex < threads.size() && threads[threadIndex] != event.thread)
+		{
+			threadIndex++;
+		}
+		if (threadIndex == threads.size())
+		{
+			threads.push_back(event.thread);
+			trace.threadEvents.emplace_back();
+		}
+		trace.events.push_back(replayEvent);
+		trace.threadEvents[threadIndex].push_back(replayEvent);
+	}
+	return trace;
+}
+
+struct ReplayResult
+{
+	std::size_t allocationCount = 0;
+	std::size_t deallocationCount = 0;
+	std::size_t failedCount = 0;
+	std::size_t peakRequestedSize = 0;
+	std::size_t peakUsedSize = 0;
+	std::size_t peakFootprint = 0;
+	double seconds = 0.0;
+
+	void Add(const ReplayResult& other)
+	{
+		allocationCount += other.allocationCount;
+		deallocationCount += other.deallocationCount;
+		failedCount += other.failedCount;
+	}
+};
+
+// GetMemoryUsage() can walk free lists, so the measured replay samples it at the peaks of the requested size and every MeasureInterval allocations
+constexpr std::size_t MeasureInterval = 256;
+
+void Measure(const Allocator& allocator, ReplayResult& result)
+{
+	const MemoryUsage usage = allocator.GetMemoryUsage();
+	const std::size_t footprint = usage.usedSize + usage.freeSize;
+	result.peakUsedSize = (usage.usedSize > result.peakUsedSize) ? usage.usedSize : result.peakUsedSize;
+	result.peakFootprint = (footprint > result.peakFootprint) ? footprint : result.peakFootprint;
+}
+
+void ReplayEvents(const std::vector<ReplayEvent>& events, Allocator& allocator, std::atomic<void*>* slots, bool measured, ReplayResult& result)
+{
+	std::size_t requestedSize = 0;
+	for (const ReplayEvent& event : events)
+	{
+		std::atomic<void*>& slot = slots[event.slot];
+		if (event.allocate)
+		{
+			void* ptr = allocator.Allocate(event.size);
+			result.allocationCount++;
+			if (ptr == nullptr)
+			{
+				result.failedCount++;
+				ptr = &gFailedBlock;
+			}
+			slot.store(ptr, std::memory_order_release);
+			if (measured && ptr != &gFailedBlock)
+			{
+				requestedSize += event.size;
+				const bool peak = requestedSize > result.peakRequestedSize;
+				result.peakRequestedSize = peak ? requestedSize : result.peakRequestedSize;
+				if (peak || result.allocationCount % MeasureInterval == 0)
+				{
+					Measure(allocator, result);
+				}
+			}
+		}
+		else
+		{
+			void* ptr = nullptr;
+			while ((ptr = slot.load(std::memory_order_acquire)) == nullptr)
+			{
+				std::this_thread::yield();
+			}
+			result.deallocationCount++;
+			if (ptr == &gFailedBlock)
+			{
+				continue;
+			}
+			if (!allocator.Deallocate(ptr))
+			{
+				result.failedCount++;
+				continue;
+			}
+			slot.store(&gFreedBlock, std::memory_order_relaxed);
+			requestedSize -= event.size;
+		}
+	}
+}
+
+// Replays the trace once, with a thread per thread of the trace unless measuring or the graph isn't thread-safe
+ReplayResult Replay(const ReplayTrace& trace, Allocator& allocator, bool measured)
+{
+	ReplayResult result;
+	std::unique_ptr<std::atomic<void*>[]> slots(new std::atomic<void*>[trace.slotCount]);
+	for (std::size_t i = 0; i < trace.slotCount; ++i)
+	{
+		slots[i].store(nullptr, std::memory_order_relaxed);
+	}
+
+	const bool threaded = !measured && trace.threadEvents.size() > 1 && allocator.IsThreadSafe();
+	if (threaded)
+	{
+		std::vector<ReplayResult> threadResults(trace.threadEvents.size());
+		std::vector<std::thread> threads;
+		std::atomic<bool> started(false);
+		for (std::size_t i = 0; i < trace.threadEvents.size(); ++i)
+		{
+			threads.emplace_back([&trace, &allocator, &slots, &threadResults, &started, i]()
+			{
+				while (!started.load(std::memory_order_acquire))
+				{
+					std::this_thread::yield();
+				}
+				ReplayEvents(trace.threadEvents[i], allocator, slots.get(), false, threadResults[i]);
+			});
+		}
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		started.store(true, std::memory_order_release);
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+		result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		for (const ReplayResult& threadResult : threadResults)
+		{
+			result.Add(threadResult);
+		}
+	}
+	else
+	{
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		ReplayEvents(trace.events, allocator, slots.get(), measured, result);
+		result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// Blocks the trace never deallocated
+	for (std::size_t i = 0; i < trace.slotCount; ++i)
+	{
+		void* ptr = slots[i].load(std::memory_order_relaxed);
+		if (ptr != nullptr && ptr != &gFailedBlock && ptr != &gFreedBlock)
+		{
+			allocator.Deallocate(ptr);
+		}
+	}
+	return result;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		std::printf("Usage : %s <trace> [graph, malloc by default]\n%s", argv[0], GraphUsage);
+		return 1;
+	}
+	const char* description = (argc > 2) ? argv[2] : "malloc";
+
+	std::FILE* file = std::fopen(argv[1], "rb");
+	std::vector<TraceRecorderAllocator::Event> events;
+	const bool validTrace = TraceRecorderAllocator::ReadTrace(file, events);
+	if (file != nullptr)
+	{
+		std::fclose(file);
+	}
+	if (!validTrace)
+	{
+		std::printf("Can't read the trace %s\n", argv[1]);
+		return 1;
+	}
+	const ReplayTrace trace = PrepareTrace(events);
+
+	// The timed graph uses malloc directly, only the measured one counts its bytes
+	Graph timedGraph(false);
+	Graph measuredGraph(true);
+	if (!timedGraph.Build(description) || !measuredGraph.Build(description))
+	{
+		std::printf("Invalid allocator graph : %s\n%s", timedGraph.GetError(), GraphUsage);
+		return 1;
+	}
+	const bool threaded = trace.threadEvents.size() > 1 && timedGraph.GetRoot().IsThreadSafe();
+	const ReplayResult timed = Replay(trace, timedGraph.GetRoot(), false);
+	const ReplayResult measured = Replay(trace, measuredGraph.GetRoot(), true);
+
+	const double operationCount = static_cast<double>(timed.allocationCount + timed.deallocationCount);
+	const double fragmentation = (measured.peakFootprint > 0) ? 1.0 - static_cast<double>(measured.peakRequestedSize) / static_cast<double>(measured.peakFootprint) : 0.0;
+	std::printf("Graph          : %s\n", description);
+	if (threaded)
+	{
+		std::printf("Replay         : %zu threads\n", trace.threadEvents.size());
+	}
+	else
+	{
+		std::printf("Replay         : 1 thread%s\n", (trace.threadEvents.size() > 1) ? ", the graph isn't thread-safe" : "");
+	}
+	std::printf("Events         : %zu allocations, %zu deallocations, %zu failed\n", timed.allocationCount, timed.deallocationCount, timed.failedCount);
+	std::printf("Throughput     : %.3f ms, %.2f Mops/s\n", timed.seconds * 1000.0, (timed.seconds > 0.0) ? operationCount / timed.seconds / 1e6 : 0.0);
+	std::printf("Peak requested : %zu bytes\n", measured.peakRequestedSize);
+	std::printf("Peak used      : %zu bytes\n", measured.peakUsedSize);
+	std::printf("Peak footprint : %zu bytes, used and free\n", measured.peakFootprint);
+	std::printf("Fragmentation  : %.2f %%\n", fragmentation * 100.0);
+	return 0;
+}
@@ -0,0 +1,101 @@
+#include "../src/Dyma.hpp"
+
+#include <chrono> // std::chrono::milliseconds
+#include <cstdio> // std::printf
+#include <cstdlib> // std::strtoull
+#include <thread> // std::this_thread::sleep_for
+#include <vector> // std::vector
+
+// DymaTop : Watches the allocators a process publishes with a StatsRegistry, refreshing their counters like top
+// The process is given by its pid, for the default name of the registry, or by the name of the registry
+// Usage : DymaTop <pid|/name> [interval in ms] [refresh count, 0 for ever]
+
+using namespace dyma;
+
+namespace
+{
+
+// Sizes are shown with a binary unit, keeping 4 significant digits at most
+void FormatSize(char* buffer, std::size_t bufferSize, std::uint64_t size)
+{
+	const char* const units[] = { "B", "KiB", "MiB", "GiB", "TiB" };
+	double value = static_cast<double>(size);
+	std::size_t unit = 0;
+	while (value >= 1024.0 && unit + 1 < sizeof(units) / sizeof(units[0]))
+	{
+		value /= 1024.0;
+		unit++;
+	}
+	if (unit == 0)
+	{
+		std::snprintf(buffer, bufferSize, "%llu %s", static_cast<unsigned long long>(size), units[unit]);
+	}
+	else
+	{
+		std::snprintf(buffer, bufferSize, "%.1f %s", value, units[unit]);
+	}
+}
+
+void PrintSnapshots(const char* name, const std::vector<StatsRegistry::Snapshot>& snapshots)
+{
+	// Clears the terminal and moves the cursor home
+	std::printf("\033[H\033[2J");
+	std::printf("%s : %zu allocators\n\n", name, snapshots.size());
+	std::printf("%-24s %12s %12s %14s %14s %10s %12s\n", "Name", "Used", "Peak", "Allocations", "Deallocations", "Failures", "Allocs/s");
+	for (const StatsRegistry::Snapshot& snapshot : snapshots)
+	{
+		char usedSize[32];
+		char peakSize[32];
+		FormatSize(usedSize, sizeof(usedSize), snapshot.usedSize);
+		FormatSize(peakSize, sizeof(peakSize), snapshot.peakSize);
+		std::printf("%-24s %12s %12s %14llu %14llu %10llu %12llu\n",
+			snapshot.name,
+			usedSize,
+			peakSize,
+			static_cast<unsigned long long>(snapshot.allocationCount),
+			static_cast<unsigned long long>(snapshot.deallocationCount),
+			static_cast<unsigned long long>(snapshot.failureCount),
+			static_cast<unsigned long long>(snapshot.allocationRate));
+	}
+	std::fflush(stdout);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		std::printf("Usage : %s <pid|/name> [interval in ms] [refresh count, 0 for ever]\n", argv[0]);
+		return 1;
+	}
+
+	// Same default name as the StatsRegistry of the process
+	char name[64];
+	if (argv[1][0] == '/')
+	{
+		std::snprintf(name, sizeof(name), "%s", argv[1]);
+	}
+	else
+	{
+		std::snprintf(name, sizeof(name), "/dyma-%s", argv[1]);
+	}
+	const std::uint64_t interval = (argc > 2) ? std::strtoull(argv[2], nullptr, 10) : 1000;
+	const std::uint64_t refreshCount = (argc > 3) ? std::strtoull(argv[3], nullptr, 10) : 0;
+
+	std::vector<StatsRegistry::Snapshot> snapshots;
+	for (std::uint64_t i = 0; refreshCount == 0 || i < refreshCount; ++i)
+	{
+		if (i > 0)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(interval));
+		}
+		if (!StatsRegistry::Read(name, snapshots))
+		{
+			std::printf("No registry named %s, the process may have exited\n", name);
+			return 1;
+		}
+		PrintSnapshots(name, snapshots);
+	}
+	return 0;
+}